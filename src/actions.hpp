@@ -10,6 +10,9 @@ enum class ActionType {
     // Tell client that a whole tick has been done
     WORLD_TICK,
 
+    // All the actions done on a tick, sent together
+    TICK_FRAME,
+
     // Self-explanaitory
     SELECT_NATION,
 
@@ -23,23 +26,31 @@ enum class ActionType {
     PING,
     PONG,
 
+    // Area of the map the client is looking at
+    CLIENT_VIEWPORT,
+
     PROVINCE_UPDATE,
+    PROVINCE_DELTA,
     PROVINCE_ADD,
     PROVINCE_REMOVE,
     PROVINCE_COLONIZE,
 
     NATION_UPDATE,
+    NATION_DELTA,
     NATION_ADD,
     NATION_REMOVE,
     NATION_ENACT_POLICY,
     NATION_TAKE_DESCISION,
 
     UNIT_UPDATE,
+    // New target or position of an unit, which can't be predicted by the clients
+    UNIT_MOVE,
     UNIT_ADD,
     UNIT_REMOVE,
     UNIT_CHANGE_TARGET,
 
     BOAT_UPDATE,
+    BOAT_MOVE,
     BOAT_ADD,
     BOAT_REMOVE,
     BOAT_CHANGE_TARGET,
@@ -53,6 +64,7 @@ enum class ActionType {
     TILE_UPDATE,
 
     PRODUCT_UPDATE,
+    PRODUCT_DELTA,
 
     CHANGE_TREATY_APPROVAL,
     DRAFT_TREATY,
@@ -0,0 +1,296 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#ifdef unix
+#	include <libintl.h>
+#	include <locale.h>
+#	include <sys/resource.h>
+#endif
+#include <dirent.h>
+
+#include "../world.hpp"
+#include "../path.hpp"
+#include "../print.hpp"
+#include "../profiler.hpp"
+#include "../server/server_network.hpp"
+
+#ifdef windows
+const char* gettext(const char* str) {
+    return str;
+}
+#endif
+
+/**
+ * Headless benchmark of the simulation, loads the mods, optionally scales the world
+ * synthetically and runs a number of ticks as fast as possible without any networking;
+ * afterwards the latency of the ticks (and of each part of the tick) is reported
+ */
+class BenchOptions {
+public:
+    size_t n_ticks = 480;
+    unsigned seed = 0;
+    size_t scale = 1;
+};
+
+static void print_usage(const char* name) {
+    printf("Usage: %s [--ticks N] [--seed N] [--scale N]\n", name);
+    printf("  --ticks N: Number of ticks to run (default 480, 10 days)\n");
+    printf("  --seed N: Seed for the random number generator (default 0)\n");
+    printf("  --scale N: Duplicate the map (with it's provinces, pops, buildings and units) N times (default 1)\n");
+}
+
+// Duplicates the map scale - 1 times (stacked below the original one) and clones the
+// provinces (with their pops) into each copy, so every clone owns it's own tiles. Returns
+// the number of copies of the map there are afterwards
+static size_t scale_provinces(World& world, size_t scale) {
+    const size_t n_provinces = world.provinces.size();
+    const size_t max_provinces = (Province::Id)-1 - 1;
+    if(n_provinces && n_provinces * scale > max_provinces) {
+        scale = std::max<size_t>(1, max_provinces / n_provinces);
+        print_error("Cannot scale past %zu provinces, scaling by %zu", max_provinces, scale);
+    }
+    if(scale == 1)
+        return scale;
+
+    const size_t map_height = world.height;
+    const size_t map_size = world.width * map_height;
+    Tile* tiles = new Tile[map_size * scale];
+    for(size_t i = 0; i < scale; i++) {
+        std::copy(world.tiles, world.tiles + map_size, tiles + i * map_size);
+    }
+    delete[] world.tiles;
+    world.tiles = tiles;
+    world.height = map_height * scale;
+    world.nation_changed_tiles.clear();
+    world.elevation_changed_tiles.clear();
+    world.changed_tile_coords.clear();
+
+    for(size_t i = 1; i < scale; i++) {
+        // Clone the provinces into this copy of the map
+        std::vector<Province*> clones;
+        clones.reserve(n_provinces);
+        for(size_t j = 0; j < n_provinces; j++) {
+            const Province* original = world.provinces[j];
+            Province* province = new Province(*original);
+            province->ref_name += "_" + std::to_string(i);
+            province->min_y += i * map_height;
+            province->max_y += i * map_height;
+
+            // The products of the clone are made by the copies of the factories on it
+            province->products.clear();
+            world.insert(province);
+            clones.push_back(province);
+
+            if(province->owner != nullptr) {
+                province->owner->owned_provinces.insert(province);
+            }
+            for(const auto& company: world.companies) {
+                if(company->in_range(world.get_id(original))) {
+                    company->operate_on(world, province);
+                }
+            }
+        }
+
+        // Clones neighbour the clones of the neighbours of the original
+        for(size_t j = 0; j < n_provinces; j++) {
+            clones[j]->neighbours.clear();
+            for(const auto& neighbour: world.provinces[j]->neighbours) {
+                clones[j]->neighbours.insert(clones[world.get_id(neighbour)]);
+            }
+        }
+
+        // Tiles of this copy belong to the clones
+        for(size_t j = i * map_size; j < (i + 1) * map_size; j++) {
+            Tile& tile = world.tiles[j];
+            if(tile.province_id != (Province::Id)-1) {
+                tile.province_id = world.get_id(clones[tile.province_id]);
+            }
+        }
+    }
+    world.publish_tiles();
+    return scale;
+}
+
+// Builds a copy of each building on each copy of the map, on the same spot as the original one
+static void scale_buildings(World& world, size_t scale) {
+    const size_t n_buildings = world.buildings.size();
+    const size_t map_height = world.height / scale;
+    for(size_t i = 1; i < scale; i++) {
+        for(size_t j = 0; j < n_buildings; j++) {
+            const Building* original = world.buildings[j];
+            Building* building = new Building();
+            building->x = original->x;
+            building->y = original->y + i * map_height;
+            building->owner = original->owner;
+            building->type = original->type;
+            building->working_unit_type = nullptr;
+            building->working_boat_type = nullptr;
+            building->budget = original->budget;
+            building->corporate_owner = original->corporate_owner;
+            if(building->type->is_factory == true && building->corporate_owner != nullptr) {
+                building->create_factory(world);
+            }
+            world.insert(building);
+        }
+    }
+}
+
+// Copies the units into each copy of the map, when there are no units each nation gets
+// some on their provinces so combat and movement are measured too
+static void scale_units(World& world, size_t scale) {
+    if(world.unit_types.empty())
+        return;
+
+    const size_t n_units = world.units.size();
+    if(!n_units) {
+        for(const auto& nation: world.nations) {
+            if(nation->owned_provinces.empty())
+                continue;
+            
+            const Province* province = *nation->owned_provinces.begin();
+            for(size_t i = 0; i < scale; i++) {
+                Unit* unit = new Unit();
+                unit->type = world.unit_types[std::rand() % world.unit_types.size()];
+                unit->x = province->min_x + std::rand() % (province->max_x - province->min_x + 1);
+                unit->y = province->min_y + std::rand() % (province->max_y - province->min_y + 1);
+                unit->tx = province->min_x + std::rand() % (province->max_x - province->min_x + 1);
+                unit->ty = province->min_y + std::rand() % (province->max_y - province->min_y + 1);
+                unit->owner = nation;
+                unit->budget = 5000.f;
+                unit->experience = 1.f;
+                unit->morale = 1.f;
+                unit->supply = 1.f;
+                unit->defensive_ticks = 0;
+                unit->size = unit->type->max_health;
+                unit->base = unit->size;
+                world.insert(unit);
+            }
+        }
+        return;
+    }
+
+    const size_t map_height = world.height / scale;
+    for(size_t i = 1; i < scale; i++) {
+        for(size_t j = 0; j < n_units; j++) {
+            Unit* unit = new Unit(*world.units[j]);
+            unit->y += i * map_height;
+            unit->ty += i * map_height;
+            world.insert(unit);
+        }
+    }
+}
+
+static uint64_t get_percentile(const std::vector<uint64_t>& sorted_samples, float percentile) {
+    if(sorted_samples.empty())
+        return 0;
+    const size_t idx = std::min<size_t>(sorted_samples.size() - 1, (size_t)(percentile / 100.f * sorted_samples.size()));
+    return sorted_samples[idx];
+}
+
+static void print_latencies(const std::string& name, std::vector<uint64_t> samples) {
+    std::sort(samples.begin(), samples.end());
+    printf("%-32s %8zu %10.3f %10.3f %10.3f %10.3f\n",
+        name.c_str(),
+        samples.size(),
+        get_percentile(samples, 50.f) / 1000.f,
+        get_percentile(samples, 90.f) / 1000.f,
+        get_percentile(samples, 99.f) / 1000.f,
+        samples.empty() ? 0.f : samples.back() / 1000.f);
+}
+
+int main(int argc, char** argv) {
+#ifdef unix
+    setlocale(LC_ALL, "");
+    bindtextdomain("main", Path::get("locale").c_str());
+    textdomain("main");
+#endif
+    BenchOptions options;
+    for(int i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "--ticks") && i + 1 < argc) {
+            options.n_ticks = std::strtoul(argv[++i], nullptr, 10);
+        } else if(!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            options.seed = std::strtoul(argv[++i], nullptr, 10);
+        } else if(!strcmp(argv[i], "--scale") && i + 1 < argc) {
+            options.scale = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+        } else {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    DIR *dir = opendir(Path::get_full().c_str());
+    if(dir != NULL) {
+        struct dirent *de;
+        while((de = readdir(dir)) != NULL) {
+            if(de->d_name[0] == '.')
+                continue;
+            
+            if(de->d_type == DT_DIR) {
+                Path::add_path(de->d_name);
+            }
+        }
+        closedir(dir);
+    }
+
+    std::srand(options.seed);
+    Server* server = new Server(Server::NullSink());
+    World* world = new World();
+    world->load_mod();
+
+    std::srand(options.seed);
+    options.scale = scale_provinces(*world, options.scale);
+    scale_buildings(*world, options.scale);
+    scale_units(*world, options.scale);
+
+    size_t n_pops = 0;
+    for(const auto& province: world->provinces) {
+        n_pops += province->pops.size();
+    }
+    printf("World: %zu provinces, %zu pops, %zu buildings, %zu units, %zu boats, %zu products\n",
+        world->provinces.size(), n_pops, world->buildings.size(), world->units.size(), world->boats.size(), world->products.size());
+
+    Profiler& profiler = Profiler::get_instance();
+    profiler.set_keep_samples(true);
+    profiler.enable();
+
+    std::vector<uint64_t> tick_samples;
+    tick_samples.reserve(options.n_ticks);
+    const auto start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < options.n_ticks; i++) {
+        const auto tick_start = std::chrono::steady_clock::now();
+        world->do_tick();
+        profiler.tick_done();
+        tick_samples.push_back(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tick_start).count());
+    }
+    const float total_ms = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1000.f;
+
+    printf("Ran %zu ticks in %.3f ms (%.1f ticks/s)\n", options.n_ticks, total_ms, options.n_ticks / (total_ms / 1000.f));
+    printf("%-32s %8s %10s %10s %10s %10s\n", "Scope", "Calls", "p50 (ms)", "p90 (ms)", "p99 (ms)", "max (ms)");
+    print_latencies("Tick", tick_samples);
+
+    auto samples = profiler.get_samples();
+    std::vector<std::string> names;
+    for(const auto& scope: samples) {
+        names.push_back(scope.first);
+    }
+    std::sort(names.begin(), names.end());
+    for(const auto& name: names) {
+        print_latencies(name, samples[name]);
+    }
+
+#ifdef unix
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) == 0) {
+        // Linux reports the maximum resident set size in kilobytes
+        printf("Peak RSS: %.1f MB\n", usage.ru_maxrss / 1024.f);
+    }
+#endif
+
+    delete world;
+    delete server;
+    return 0;
+}
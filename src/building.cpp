@@ -23,7 +23,7 @@ Province* Building::get_province(const World& world) {
 }
 
 void Building::create_factory(World& world) {
-    corporate_owner->operating_provinces.insert(get_province(world));
+    corporate_owner->operate_on(world, get_province(world));
     
     // Add a product for each output
     for(const auto& output: type->outputs) {
@@ -34,7 +34,7 @@ void Building::create_factory(World& world) {
         new_product->origin = get_province(world);
 
         output_products.push_back(new_product);
-        world.products.push_back(new_product);
+        world.insert(new_product);
 
         employees_needed_per_output.push_back(500);
 
@@ -59,7 +59,7 @@ void Building::delete_factory(World& world) {
             province->stockpile.erase(province->stockpile.begin() + product_id);
         }
 
+        world.remove(product);
         delete product;
-        world.products.erase(world.products.begin() + product_id);
     }
 }
\ No newline at end of file
@@ -1,13 +1,12 @@
 #ifndef BUILDING_HPP
 #define BUILDING_HPP
+#include "entity.hpp"
 #include "unit.hpp"
 #include "company.hpp"
 
 // Type for military outposts
-class BuildingType {
+class BuildingType : public IdEntity<uint8_t> {
 public:
-    using Id = uint8_t;
-
     std::string name;
     std::string ref_name;
 
@@ -32,10 +31,8 @@ public:
 
 // A military outpost, on land serves as a "spawn" place for units
 // When adjacent to a water tile this serves as a shipyard for spawning naval units
-class Building {
+class Building : public IdEntity<uint16_t> {
 public:
-    using Id = uint16_t;
-
     // Position of outpost
     size_t x;
     size_t y;
@@ -8,6 +8,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <mutex>
+#include <algorithm>
 /* Visual Studio does not know about UNISTD.H, Mingw does through */
 #ifndef _MSC_VER
 #	include <unistd.h>
@@ -44,12 +45,13 @@ WINSOCK_API_LINKAGE int WSAAPI WSAPoll(LPWSAPOLLFD fdArray, ULONG fds, INT timeo
 #include "../diplomacy.hpp"
 #include "../world.hpp"
 #include "../io_impl.hpp"
+#include "../delta.hpp"
 
 #include <chrono>
 #include <thread>
 
 Client* g_client = nullptr;
-Client::Client(std::string host, const unsigned port) {
+Client::Client(std::string host, const unsigned port, std::string _username) : username(_username) {
     g_client = this;
 
     // Initialize WSA
@@ -85,9 +87,9 @@ Client::Client(std::string host, const unsigned port) {
         throw SocketException("Cannot connect to server");
     }
     
-    // Launch the receive and send thread
-    net_thread = std::thread(&Client::net_loop, this);
+    // Launch the receive and send thread, everything it uses must be set before this
     has_snapshot = false;
+    net_thread = std::thread(&Client::net_loop, this);
 }
 
 // The server assumes all clients are able to handle all events regardless of anything
@@ -95,39 +97,50 @@ Client::Client(std::string host, const unsigned port) {
 // to establish a new connection; since the server won't hand out snapshots - wait...
 // if you need snapshots for any reason (like desyncs) you can request with ActionType::SNAPSHOT
 void Client::net_loop(void) {
-    // Receive the first snapshot of the world
-    {
-        g_world->world_mutex.lock();
-        Packet packet = Packet(fd);
-        packet.recv();
-        Archive ar = Archive();
-        ar.set_buffer(packet.data(), packet.size());
-        ::deserialize(ar, g_world);
-        g_world->world_mutex.unlock();
-    }
+    // Packets are parsed out of big reads
+    PacketReader reader = PacketReader();
 
+    // Tell the server who we are and what we support, it answers with the snapshot
     {
         Archive ar = Archive();
 
         ActionType action = ActionType::CONNECT;
         ::serialize(ar, &action);
         ::serialize(ar, &username);
+        uint32_t features = NET_FEATURE_DEFLATE;
+        ::serialize(ar, &features);
 
         Packet packet = Packet(fd);
         packet.data(ar.get_buffer(), ar.size());
         packet.send();
     }
+
+    // Receive the first snapshot of the world
+    {
+        g_world->world_mutex.lock();
+        Packet packet = Packet(fd);
+        while(!reader.next(packet)) {
+            const int r = reader.fill(fd);
+            if(r <= 0)
+                throw SocketException("Cannot receive the snapshot of the world");
+            bytes_received += r;
+        }
+        Archive ar = Archive();
+        ar.set_view(packet.buffer.data(), packet.size());
+        ::deserialize(ar, g_world);
+        g_world->world_mutex.unlock();
+    }
     
     has_snapshot = true;
     
     try {
-        ActionType action;
-        
 #ifdef unix
         struct pollfd pfd;
         pfd.fd = fd;
         pfd.events = POLLIN;
 #endif
+        // Reused for every packet, so it's buffer is not allocated each time
+        Packet packet = Packet(fd);
         while(1) {
             // Check if we need to read packets
 #ifdef unix
@@ -143,143 +156,19 @@ void Client::net_loop(void) {
 #elif defined windows
             if(has_pending) {
 #endif
-                Packet packet = Packet(fd);
-                Archive ar = Archive();
-
-                // Obtain the action from the server
-                packet.recv();
-                ar.set_buffer(packet.data(), packet.size());
-                ar.rewind();
-                ::deserialize(ar, &action);
+                const int r = reader.fill(fd);
+                if(r <= 0)
+                    throw ClientException("Connection closed by the server");
+                bytes_received += r;
 
-                // Ping from server, we should answer with a pong!
-                std::lock_guard<std::recursive_mutex> lock(g_world->world_mutex);
-                switch(action) {
-                case ActionType::PONG: {
-                    packet.send(&action);
-                    print_info("Received ping, responding with pong!");
-                } break;
-                // Update/Remove/Add Actions
-                // These actions all follow the same format they give a specialized ID for the index
-                // where the operated object is or should be; this allows for extreme-level fuckery
-                // like ref-name changes in the middle of a game in the case of updates.
-                //
-                // After the ID the object in question is given in a serialized form, in which the
-                // deserializer will deserialize onto the final object; after this the operation
-                // desired is done.
-                case ActionType::NATION_UPDATE: {
-                    Nation* nation;
-                    ::deserialize(ar, &nation);
-                    if(nation == nullptr)
-                        throw ClientException("Unknown nation");
-                    ::deserialize(ar, nation);
-                } break;
-                case ActionType::NATION_ENACT_POLICY: {
-                    Nation* nation;
-                    ::deserialize(ar, &nation);
-                    if(nation == nullptr)
-                        throw ClientException("Unknown nation");
-                    Policies policy;
-                    ::deserialize(ar, &policy);
-                    nation->current_policy = policy;
-                } break;
-                // TODO: There is a problem with this
-                // TODO: It throws serializer errors but idk where, maybe the server?
-                case ActionType::PROVINCE_UPDATE: {
-                    Province* province;
-                    ::deserialize(ar, &province);
-                    if(province == nullptr)
-                        throw ClientException("Unknown province");
-                    ::deserialize(ar, province);
-                } break;
-                case ActionType::PRODUCT_UPDATE: {
-                    Product* product;
-                    ::deserialize(ar, &product);
-                    if(product == nullptr)
-                        throw ClientException("Unknown product");
-                    ::deserialize(ar, product);
-                } break;
-                case ActionType::UNIT_UPDATE: {
-                    Unit* unit;
-                    ::deserialize(ar, &unit);
-                    if(unit == nullptr)
-                        throw ClientException("Unknown unit");
-                    ::deserialize(ar, unit);
-                } break;
-                case ActionType::UNIT_ADD: {
-                    Unit* unit = new Unit();
-                    ::deserialize(ar, unit);
-                    g_world->units.push_back(unit);
-                    print_info("New unit of %s", unit->owner->name.c_str());
-                } break;
-                case ActionType::BOAT_UPDATE: {
-                    Boat* boat;
-                    ::deserialize(ar, &boat);
-                    if(boat == nullptr)
-                        throw ClientException("Unknown boat");
-                    ::deserialize(ar, boat);
-                } break;
-                case ActionType::BOAT_ADD: {
-                    Boat* boat = new Boat();
-                    ::deserialize(ar, boat);
-                    g_world->boats.push_back(boat);
-                    print_info("New boat of %s", boat->owner->name.c_str());
-                } break;
-                case ActionType::BUILDING_UPDATE: {
-                    Building* building;
-                    ::deserialize(ar, &building);
-                    if(building == nullptr)
-                        throw ClientException("Unknown building");
-                    ::deserialize(ar, building);
-                } break;
-                case ActionType::BUILDING_ADD: {
-                    Building* building = new Building();
-                    ::deserialize(ar, building);
-                    g_world->buildings.push_back(building);
-                    print_info("New building property of %s", building->owner->name.c_str());
-                } break;
-                case ActionType::BUILDING_REMOVE: {
-                    Building* building;
-                    ::deserialize(ar, &building);
-                    print_info("Remove building property of %s", building->owner->name.c_str());
+                // Handle all the actions that were completely received, they are read
+                // directly from the packet
+                while(reader.next(packet)) {
+                    Archive ar = Archive();
+                    ar.set_view(packet.buffer.data(), packet.size());
 
-                    if(building->type->is_factory == true) {
-                        building->delete_factory(*g_world);
-                    }
-                    delete building;
-                    g_world->buildings.erase(g_world->buildings.begin() + g_world->get_id(building));
-                } break;
-                case ActionType::TREATY_ADD: {
-                    Treaty* treaty = new Treaty();
-                    ::deserialize(ar, treaty);
-                    g_world->treaties.push_back(treaty);
-                    print_info("New treaty from %s", treaty->sender->name.c_str());
-                    for(const auto& status: treaty->approval_status) {
-                        print_info("- %s", status.first->name.c_str());
-                    }
-                } break;
-                case ActionType::WORLD_TICK: {
-                    g_world->time++;
-                } break;
-                case ActionType::TILE_UPDATE: {
-                    // get_tile is already mutexed
-                    std::pair<size_t, size_t> coord;
-                    ::deserialize(ar, &coord.first);
-                    ::deserialize(ar, &coord.second);
-                    ::deserialize(ar, &g_world->get_tile(coord.first, coord.second));
-
-                    std::lock_guard<std::recursive_mutex> lock(g_world->changed_tiles_coords_mutex);
-                    g_world->nation_changed_tiles.push_back(&g_world->get_tile(coord.first, coord.second));
-                } break;
-                case ActionType::PROVINCE_COLONIZE: {
-                    Province* province;
-                    ::deserialize(ar, &province);
-                    if(province == nullptr)
-                        throw ClientException("Unknown province");
-                    ::deserialize(ar, province);
-                } break;
-                default:
-                    break;
+                    std::lock_guard<std::recursive_mutex> lock(g_world->world_mutex);
+                    handle_action(ar, packet);
                 }
             }
 
@@ -300,6 +189,260 @@ void Client::net_loop(void) {
     }
 }
 
+/**
+ * Reads the position and target of an unit (or boat) at the given tick, and moves it to
+ * the current tick (in case the client is already past it)
+ */
+template<typename T>
+static void deserialize_move(Archive& ar, T& obj, bool (World::*step)(float&, float&, size_t, size_t) const) {
+    ::deserialize(ar, &obj.x);
+    ::deserialize(ar, &obj.y);
+    ::deserialize(ar, &obj.tx);
+    ::deserialize(ar, &obj.ty);
+    uint64_t start_tick;
+    ::deserialize(ar, &start_tick);
+    for(uint64_t tick = start_tick; tick < g_world->time; tick++) {
+        (g_world->*step)(obj.x, obj.y, obj.tx, obj.ty);
+    }
+}
+
+/**
+ * Handles an action received from the server, the world must be locked by the caller
+ */
+void Client::handle_action(Archive& ar, Packet& packet) {
+    ActionType action;
+    ::deserialize(ar, &action);
+
+    if(on_action) {
+        const size_t ptr = ar.ptr;
+        on_action(action, ar);
+        ar.ptr = ptr;
+    }
+
+    // Ping from server, we should answer with a pong!
+    switch(action) {
+    case ActionType::PONG: {
+        // The packet is still being read (i.e it's a frame), so answer with another
+        Packet pong = Packet(fd);
+        pong.send(&action);
+        print_info("Received ping, responding with pong!");
+    } break;
+    // Update/Remove/Add Actions
+    // These actions all follow the same format they give a specialized ID for the index
+    // where the operated object is or should be; this allows for extreme-level fuckery
+    // like ref-name changes in the middle of a game in the case of updates.
+    //
+    // After the ID the object in question is given in a serialized form, in which the
+    // deserializer will deserialize onto the final object; after this the operation
+    // desired is done.
+    case ActionType::NATION_UPDATE: {
+        Nation* nation;
+        ::deserialize(ar, &nation);
+        if(nation == nullptr)
+            throw ClientException("Unknown nation");
+        ::deserialize(ar, nation);
+    } break;
+    case ActionType::NATION_DELTA: {
+        Nation* nation;
+        ::deserialize(ar, &nation);
+        if(nation == nullptr)
+            throw ClientException("Unknown nation");
+        deserialize_delta(ar, nation);
+    } break;
+    case ActionType::NATION_ENACT_POLICY: {
+        Nation* nation;
+        ::deserialize(ar, &nation);
+        if(nation == nullptr)
+            throw ClientException("Unknown nation");
+        Policies policy;
+        ::deserialize(ar, &policy);
+        nation->current_policy = policy;
+    } break;
+    // TODO: There is a problem with this
+    // TODO: It throws serializer errors but idk where, maybe the server?
+    case ActionType::PROVINCE_UPDATE: {
+        Province* province;
+        ::deserialize(ar, &province);
+        if(province == nullptr)
+            throw ClientException("Unknown province");
+        ::deserialize(ar, province);
+    } break;
+    case ActionType::PROVINCE_DELTA: {
+        Province* province;
+        ::deserialize(ar, &province);
+        if(province == nullptr)
+            throw ClientException("Unknown province");
+        deserialize_delta(ar, province);
+    } break;
+    case ActionType::PRODUCT_UPDATE: {
+        Product* product;
+        ::deserialize(ar, &product);
+        if(product == nullptr)
+            throw ClientException("Unknown product");
+        ::deserialize(ar, product);
+    } break;
+    case ActionType::PRODUCT_DELTA: {
+        Product* product;
+        ::deserialize(ar, &product);
+        if(product == nullptr)
+            throw ClientException("Unknown product");
+        deserialize_delta(ar, product);
+    } break;
+    case ActionType::UNIT_UPDATE: {
+        Unit* unit;
+        ::deserialize(ar, &unit);
+        if(unit == nullptr)
+            throw ClientException("Unknown unit");
+        ::deserialize(ar, unit);
+    } break;
+    case ActionType::UNIT_MOVE: {
+        Unit* unit;
+        ::deserialize(ar, &unit);
+        if(unit == nullptr)
+            throw ClientException("Unknown unit");
+        deserialize_move(ar, *unit, &World::step_unit);
+    } break;
+    case ActionType::UNIT_ADD: {
+        Unit* unit = new Unit();
+        ::deserialize(ar, unit);
+        g_world->insert(unit);
+        print_info("New unit of %s", unit->owner->name.c_str());
+    } break;
+    case ActionType::UNIT_REMOVE: {
+        Unit* unit;
+        ::deserialize(ar, &unit);
+        if(unit == nullptr)
+            throw ClientException("Unknown unit");
+        if(on_unit_remove)
+            on_unit_remove(unit);
+        g_world->remove(unit);
+        delete unit;
+    } break;
+    case ActionType::BOAT_UPDATE: {
+        Boat* boat;
+        ::deserialize(ar, &boat);
+        if(boat == nullptr)
+            throw ClientException("Unknown boat");
+        ::deserialize(ar, boat);
+    } break;
+    case ActionType::BOAT_MOVE: {
+        Boat* boat;
+        ::deserialize(ar, &boat);
+        if(boat == nullptr)
+            throw ClientException("Unknown boat");
+        deserialize_move(ar, *boat, &World::step_boat);
+    } break;
+    case ActionType::BOAT_ADD: {
+        Boat* boat = new Boat();
+        ::deserialize(ar, boat);
+        g_world->insert(boat);
+        print_info("New boat of %s", boat->owner->name.c_str());
+    } break;
+    case ActionType::BOAT_REMOVE: {
+        Boat* boat;
+        ::deserialize(ar, &boat);
+        if(boat == nullptr)
+            throw ClientException("Unknown boat");
+        if(on_boat_remove)
+            on_boat_remove(boat);
+        g_world->remove(boat);
+        delete boat;
+    } break;
+    case ActionType::BUILDING_UPDATE: {
+        Building* building;
+        ::deserialize(ar, &building);
+        if(building == nullptr)
+            throw ClientException("Unknown building");
+        ::deserialize(ar, building);
+    } break;
+    case ActionType::BUILDING_ADD: {
+        Building* building = new Building();
+        ::deserialize(ar, building);
+        g_world->insert(building);
+        print_info("New building property of %s", building->owner->name.c_str());
+    } break;
+    case ActionType::BUILDING_REMOVE: {
+        Building* building;
+        ::deserialize(ar, &building);
+        print_info("Remove building property of %s", building->owner->name.c_str());
+
+        if(building->type->is_factory == true) {
+            building->delete_factory(*g_world);
+        }
+        g_world->remove(building);
+        delete building;
+    } break;
+    case ActionType::TREATY_ADD: {
+        Treaty* treaty = new Treaty();
+        ::deserialize(ar, treaty);
+        g_world->insert(treaty);
+        print_info("New treaty from %s", treaty->sender->name.c_str());
+        for(const auto& status: treaty->approval_status) {
+            print_info("- %s", status.first->name.c_str());
+        }
+    } break;
+    // Frames group all the actions the server did on a tick, the size of each action
+    // is given so actions this client does not read fully do not break the next one
+    case ActionType::TICK_FRAME: {
+        uint32_t n_actions;
+        ::deserialize(ar, &n_actions);
+        for(size_t i = 0; i < n_actions; i++) {
+            uint32_t size;
+            ::deserialize(ar, &size);
+            const size_t end = ar.ptr + size;
+            if(end > ar.size())
+                throw ClientException("Action past the end of the frame");
+
+            handle_action(ar, packet);
+            ar.ptr = end;
+        }
+    } break;
+    // The units are moved as the server does, the server tells when it does not
+    // move them as predicted
+    case ActionType::WORLD_TICK: {
+        g_world->time++;
+        for(auto& unit: g_world->units) {
+            g_world->step_unit(unit->x, unit->y, unit->tx, unit->ty);
+        }
+        for(auto& boat: g_world->boats) {
+            g_world->step_boat(boat->x, boat->y, boat->tx, boat->ty);
+        }
+
+        const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        if(last_tick_ns)
+            tick_ns = now - last_tick_ns;
+        last_tick_ns = now;
+    } break;
+    case ActionType::TILE_UPDATE: {
+        // get_tile is already mutexed
+        std::pair<size_t, size_t> coord;
+        ::deserialize(ar, &coord.first);
+        ::deserialize(ar, &coord.second);
+        ::deserialize(ar, &g_world->get_tile(coord.first, coord.second));
+
+        std::lock_guard<std::recursive_mutex> lock(g_world->changed_tiles_coords_mutex);
+        g_world->nation_changed_tiles.push_back(&g_world->get_tile(coord.first, coord.second));
+    } break;
+    case ActionType::PROVINCE_COLONIZE: {
+        Province* province;
+        ::deserialize(ar, &province);
+        if(province == nullptr)
+            throw ClientException("Unknown province");
+        ::deserialize(ar, province);
+    } break;
+    default:
+        break;
+    }
+}
+
+float Client::get_tick_fraction(void) const {
+    if(!tick_ns)
+        return 0.f;
+    
+    const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    return std::max(0.f, std::min(1.f, (float)(now - last_tick_ns) / (float)tick_ns));
+}
+
 // Waits to receive the server initial world snapshot
 void Client::wait_for_snapshot(void) {
     while(!has_snapshot) {
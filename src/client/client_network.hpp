@@ -5,7 +5,14 @@
 #include <deque>
 #include <thread>
 #include <atomic>
+#include <chrono>
+#include <functional>
 #include "../network.hpp"
+#include "../serializer.hpp"
+#include "../actions.hpp"
+
+class Unit;
+class Boat;
 
 class Client {
     struct sockaddr_in addr;
@@ -17,10 +24,18 @@ class Client {
     
     std::thread net_thread;
     std::atomic<bool> has_snapshot;
+
+    // When the last tick was received and how long the one before it lasted
+    std::atomic<int64_t> last_tick_ns{0};
+    std::atomic<int64_t> tick_ns{0};
+
+    void handle_action(Archive& ar, Packet& packet);
 public:
-    std::string username;
+    // Told to the server when connecting, the network thread reads it as soon as it starts
+    // so it's given to the constructor and can't be changed afterwards
+    const std::string username;
 
-    Client(std::string host, const unsigned port);
+    Client(std::string host, const unsigned port, std::string username);
     ~Client();
     int get_fd(void) {
         return fd;
@@ -28,9 +43,25 @@ public:
     
     void net_loop(void);
     void wait_for_snapshot(void);
+
+    // Fraction (from 0 to 1) of the current tick that has passed, assuming it lasts as
+    // long as the last one. Used to draw the movement of units between ticks
+    float get_tick_fraction(void) const;
     
     std::mutex packet_mutex;
     std::deque<Packet> packet_queue;
+
+    // Called (with the world locked) with each action received before it's handled, the
+    // archive is past the type of the action. Used by tools like the load test
+    std::function<void(ActionType, Archive&)> on_action;
+
+    // Called (with the world locked) with each unit and boat removed by the server, right
+    // before it's deleted, so nothing of the client keeps pointing to it (i.e the selection)
+    std::function<void(Unit*)> on_unit_remove;
+    std::function<void(Boat*)> on_boat_remove;
+
+    // Total bytes received from the server
+    std::atomic<uint64_t> bytes_received{0};
 };
 extern Client* g_client;
 
@@ -2,6 +2,7 @@
 
 #include <GL/glew.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdio>
 #include <string>
@@ -277,14 +278,45 @@ void GameState::send_command(Archive& archive) {
     client->packet_mutex.unlock();
 }
 
+void GameState::send_viewport(void) {
+    // The corners of the screen, the top ones may be far away since the camera is tilted
+    const std::pair<int, int> corners[] = {
+        std::make_pair(0, 0), std::make_pair(width, 0),
+        std::make_pair(0, height), std::make_pair(width, height)
+    };
+    float min_x = world->width, min_y = world->height, max_x = 0.f, max_y = 0.f;
+    for(const auto& corner: corners) {
+        const std::pair<float, float> pos = cam.get_map_pos(corner);
+        min_x = std::min(min_x, pos.first);
+        min_y = std::min(min_y, pos.second);
+        max_x = std::max(max_x, pos.first);
+        max_y = std::max(max_y, pos.second);
+    }
+    min_x = std::max(0.f, min_x);
+    min_y = std::max(0.f, min_y);
+    max_x = std::min((float)world->width, max_x);
+    max_y = std::min((float)world->height, max_y);
+
+    const int viewport[4] = { (int)min_x, (int)min_y, (int)max_x, (int)max_y };
+    if(std::equal(viewport, viewport + 4, sent_viewport))
+        return;
+    std::copy(viewport, viewport + 4, sent_viewport);
+
+    Archive ar = Archive();
+    ActionType action = ActionType::CLIENT_VIEWPORT;
+    ::serialize(ar, &action);
+    ::serialize(ar, &min_x);
+    ::serialize(ar, &min_y);
+    ::serialize(ar, &max_x);
+    ::serialize(ar, &max_y);
+    send_command(ar);
+}
+
 void render(GameState& gs, Input& input, SDL_Window* window) {
     int& width = gs.width;
     int& height = gs.height;
 
     std::pair<float, float>& select_pos = input.select_pos;
-    Boat* selected_boat = input.selected_boat;
-    Unit* selected_unit = input.selected_unit;
-    Building* selected_building = input.selected_building;
 
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -299,9 +331,16 @@ void render(GameState& gs, Input& input, SDL_Window* window) {
         glMatrixMode(GL_MODELVIEW);
         glLoadMatrixf(glm::value_ptr(cam.get_view()));
 
+        if(gs.client != nullptr)
+            map->tick_fraction = gs.client->get_tick_fraction();
         map->draw(cam, width, height);
 
+        // The selection is read with the world locked, the client clears it when the
+        // selected unit or boat is removed
         gs.world->world_mutex.lock();
+        Boat* selected_boat = input.selected_boat;
+        Unit* selected_unit = input.selected_unit;
+        Building* selected_building = input.selected_building;
         if (selected_boat != nullptr) {
             glBegin(GL_LINE_STRIP);
             glColor3f(1.f, 0.f, 0.f);
@@ -448,6 +487,19 @@ void main_loop(GameState& gs, Client* client, SDL_Window* window) {
     Input& input = gs.input;
     uint64_t last_time = 0;
 
+    // Units and boats removed by the server must not stay selected
+    if(client != nullptr) {
+        std::lock_guard<std::recursive_mutex> lock(gs.world->world_mutex);
+        client->on_unit_remove = [&input](Unit* unit) {
+            if(input.selected_unit == unit)
+                input.selected_unit = nullptr;
+        };
+        client->on_boat_remove = [&input](Boat* boat) {
+            if(input.selected_boat == boat)
+                input.selected_boat = nullptr;
+        };
+    }
+
     init_client(gs);
 
     std::mutex render_lock;
@@ -459,6 +511,9 @@ void main_loop(GameState& gs, Client* client, SDL_Window* window) {
                 client_update_fn(gs);
             }
             last_time = gs.world->time;
+
+            if(gs.current_mode != MapMode::NO_MAP)
+                gs.send_viewport();
         }
 
         std::unique_lock<std::mutex> lock(render_lock);
@@ -470,6 +525,12 @@ void main_loop(GameState& gs, Client* client, SDL_Window* window) {
 
         render(gs, input, window);
     }
+
+    if(client != nullptr) {
+        std::lock_guard<std::recursive_mutex> lock(gs.world->world_mutex);
+        client->on_unit_remove = nullptr;
+        client->on_boat_remove = nullptr;
+    }
 }
 
 #include "interface/main_menu.hpp"
@@ -80,7 +80,13 @@ class GameState {
 
     void send_command(Archive& archive);
 
+    // Tells the server the area of the map seen by the camera (if it changed), the server
+    // sends right away only what happens there
+    void send_viewport(void);
+
    private:
+    // Last area told to the server, in tiles
+    int sent_viewport[4] = { -1, -1, -1, -1 };
 };
 
 // Run world tick and pending commands
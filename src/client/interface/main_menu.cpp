@@ -27,8 +27,7 @@ MainMenuConnectServer::MainMenuConnectServer(GameState& _gs)
 
         GameState& gs = state->gs;
         gs.world = new World();
-        gs.client = new Client(server_addr, 1836);
-        gs.client->username = state->username_inp->buffer;
+        gs.client = new Client(server_addr, 1836, state->username_inp->buffer);
         gs.client->wait_for_snapshot();
         gs.map = new Map(*gs.world);
         state->in_game = true;
@@ -3,6 +3,7 @@
 #include <GL/glu.h>
 
 #include <algorithm>
+#include <cmath>
 #include <cstdlib>
 #include <cstring>
 #include <functional>
@@ -160,6 +161,9 @@ void Map::handle_click(GameState& gs, SDL_Event event) {
         input.select_pos.second >= gs.world->height) {
         return;
     }
+
+    // Units and boats can be removed (and deleted) by the network thread at any time
+    std::lock_guard<std::recursive_mutex> lock(gs.world->world_mutex);
     Boat* selected_boat = input.selected_boat;
     Unit* selected_unit = input.selected_unit;
     Building* selected_building = input.selected_building;
@@ -327,6 +331,18 @@ void Map::update(World& world) {
     }
 }
 
+// Gives the position between the current one and the next one (on next_x, next_y) at
+// the given fraction of the tick, unless it wraps around the world
+static void interpolate_position(float x, float y, float& next_x, float& next_y, float fraction) {
+    if (std::abs(next_x - x) > 1.f || std::abs(next_y - y) > 1.f) {
+        next_x = x;
+        next_y = y;
+        return;
+    }
+    next_x = x + (next_x - x) * fraction;
+    next_y = y + (next_y - y) * fraction;
+}
+
 void Map::draw(Camera& cam, const int width, const int height) {
     glm::mat4 view, projection;
 
@@ -387,8 +403,12 @@ void Map::draw(Camera& cam, const int width, const int height) {
     }
 
     for (const auto& unit : world.units) {
+        float x = unit->x, y = unit->y;
+        world.step_unit(x, y, unit->tx, unit->ty);
+        interpolate_position(unit->x, unit->y, x, y, tick_fraction);
+
         glm::mat4 model(1.f);
-        model = glm::translate(model, glm::vec3(unit->x, unit->y, 0.f));
+        model = glm::translate(model, glm::vec3(x, y, 0.f));
         model = glm::rotate(model, glm::radians(270.f), glm::vec3(1.f, 0.f, 0.f));
         obj_shader->set_uniform("model", model);
 
@@ -401,8 +421,12 @@ void Map::draw(Camera& cam, const int width, const int height) {
     }
 
     for (const auto& boat : world.boats) {
+        float x = boat->x, y = boat->y;
+        world.step_boat(x, y, boat->tx, boat->ty);
+        interpolate_position(boat->x, boat->y, x, y, tick_fraction);
+
         glm::mat4 model(1.f);
-        model = glm::translate(model, glm::vec3(boat->x, boat->y, 0.f));
+        model = glm::translate(model, glm::vec3(x, y, 0.f));
         model = glm::rotate(model, glm::radians(270.f), glm::vec3(1.f, 0.f, 0.f));
         obj_shader->set_uniform("model", model);
 
@@ -32,6 +32,10 @@ public:
     // Wind oscillator (for flags)
     float wind_osc = 0.f;
 
+    // Fraction of the current tick that has passed, units are drawn between their
+    // position and the next one
+    float tick_fraction = 0.f;
+
     const World& world;
     
     UnifiedRender::Texture* div_topo_tex;
@@ -21,6 +21,10 @@ static std::vector<Tile *> generate_neighbors(const World& world, const Nation&
     std::vector<Tile *> result;
 
     const Nation::Id nation_id = world.get_id(&nation);
+
+    const size_t t_idx = world.get_id(tile);
+    const int t_x = t_idx % world.width;
+    const int t_y = t_idx / world.width;
     
     for(int i = -1; i <= 1; i++) {
         for(int j = -1; j <= 1; j++) {
@@ -28,11 +32,12 @@ static std::vector<Tile *> generate_neighbors(const World& world, const Nation&
             if(i == 0 && j == 0)
                 continue;
             
-            const size_t t_idx = world.get_id(tile);
-            const size_t t_x = t_idx % world.width;
-            const size_t t_y = t_idx / world.width;
+            // North and south do not wrap, west and east do
+            if(!coord_in_bounds(world, t_x + i, t_y + j))
+                continue;
+            const size_t n_x = (t_x + i + world.width) % world.width;
 
-            Tile* neighbour = &(world.get_tile(t_x + i, t_y + j));
+            Tile* neighbour = &(world.get_tile_unchecked(n_x, t_y + j));
 
             // Check that neighbour is above sea level
             if(neighbour->elevation > world.sea_level) {
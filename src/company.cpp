@@ -0,0 +1,59 @@
+#include "company.hpp"
+#include "world.hpp"
+
+void Company::operate_on(World& world, Province* province) {
+    const Province::Id province_id = world.get_id(province);
+    if(province_id == (Province::Id)-1)
+        return;
+
+    operating_provinces.insert(province);
+    if(province_id / 64 >= province_bits.size()) {
+        province_bits.resize(province_id / 64 + 1, 0);
+    }
+    province_bits[province_id / 64] |= (uint64_t)1 << (province_id % 64);
+
+    if(is_transport) {
+        world.transport_network.add(province_id, world.get_id(this));
+    }
+}
+
+void Company::update_operating_provinces(World& world) {
+    const Company::Id company_id = world.get_id(this);
+    if(company_id != (Company::Id)-1) {
+        world.transport_network.remove_all(company_id);
+    }
+
+    province_bits.clear();
+    const std::set<Province*> provinces = std::move(operating_provinces);
+    operating_provinces.clear();
+    for(const auto& province: provinces) {
+        operate_on(world, province);
+    }
+}
+
+void TransportNetwork::add(Province::Id province_id, Company::Id company_id) {
+    // Grow the table (keeping the bits of each province) when a company or a province
+    // does not fit, this only happens while the world is being loaded
+    const size_t new_n_words = std::max<size_t>(n_words, company_id / 64 + 1);
+    const size_t new_n_provinces = std::max<size_t>(n_provinces, province_id + 1);
+    if(new_n_words != n_words || new_n_provinces != n_provinces) {
+        std::vector<uint64_t> new_bits(new_n_words * new_n_provinces, 0);
+        for(size_t i = 0; i < n_provinces; i++) {
+            std::copy(bits.begin() + i * n_words, bits.begin() + (i + 1) * n_words, new_bits.begin() + i * new_n_words);
+        }
+        bits = std::move(new_bits);
+        n_words = new_n_words;
+        n_provinces = new_n_provinces;
+    }
+
+    bits[province_id * n_words + company_id / 64] |= (uint64_t)1 << (company_id % 64);
+}
+
+void TransportNetwork::remove_all(Company::Id company_id) {
+    if(company_id / 64 >= n_words)
+        return;
+
+    for(size_t i = 0; i < n_provinces; i++) {
+        bits[i * n_words + company_id / 64] &= ~((uint64_t)1 << (company_id % 64));
+    }
+}
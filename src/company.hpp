@@ -1,16 +1,21 @@
 #ifndef COMPANY_HPP
 #define COMPANY_HPP
+#include "entity.hpp"
 #include <string>
 #include <set>
+#include <vector>
+#include <cstdint>
 #include <algorithm>
 #include "nation.hpp"
 #include "province.hpp"
 
+class World;
+
 // A company that operates one or more factories and is able to build even more factories
-class Company {
+class Company : public IdEntity<uint16_t> {
+    // Bitset over the IDs of the provinces in operating_provinces
+    std::vector<uint64_t> province_bits;
 public:
-    using Id = uint16_t;
-    
     // Name of this company
     std::string name;
     
@@ -27,11 +32,19 @@ public:
     // List of province IDs where this company operates (mostly used for transport companies)
     std::set<Province *> operating_provinces;
 
-    inline bool in_range(Province* province) {
-        return (std::find(operating_provinces.begin(), operating_provinces.end(), province)
-            != operating_provinces.end());
+    inline bool in_range(Province::Id province_id) const {
+        return (province_id / 64 < province_bits.size())
+            && ((province_bits[province_id / 64] >> (province_id % 64)) & 1);
     }
 
+    // Adds a province to the operating provinces of this company, this keeps the bitset
+    // and the transport network of the world updated
+    void operate_on(World& world, Province* province);
+
+    // Recomputes the bitset (and the transport network of the world) from the operating
+    // provinces, used when they have been modified directly (i.e deserialization)
+    void update_operating_provinces(World& world);
+
     void name_gen() {
         size_t r = (rand() % 12) + 1;
         for(size_t i = 0; i < r; i++) {
@@ -40,4 +53,28 @@ public:
     }
 };
 
+// For each province, a bitset of the transport companies that operate on it. Two
+// provinces are connected when they share a transport company
+class TransportNetwork {
+    std::vector<uint64_t> bits;
+
+    // Number of words (of 64 companies) per province
+    size_t n_words = 0;
+    size_t n_provinces = 0;
+public:
+    void add(Province::Id province_id, Company::Id company_id);
+    void remove_all(Company::Id company_id);
+
+    inline bool is_connected(Province::Id from, Province::Id to) const {
+        if(from >= n_provinces || to >= n_provinces)
+            return false;
+
+        for(size_t i = 0; i < n_words; i++) {
+            if(bits[from * n_words + i] & bits[to * n_words + i])
+                return true;
+        }
+        return false;
+    }
+};
+
 #endif
\ No newline at end of file
@@ -1,11 +1,10 @@
 #ifndef CULTURE_HPP
 #define CULTURE_HPP
+#include "entity.hpp"
 #include <string>
 
-class Culture {
+class Culture : public IdEntity<uint16_t> {
 public:
-    using Id = uint16_t;
-
     std::string name;
     std::string ref_name;
 };
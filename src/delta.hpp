@@ -0,0 +1,109 @@
+#ifndef DELTA_HPP
+#define DELTA_HPP
+
+#include <cstdint>
+#include <vector>
+#include <cstring>
+#include "io_impl.hpp"
+
+// Lists the fields of an object that are replicated field by field, these are the serialized
+// fields (see SerializerFields) so each field is given to func in the same order on the
+// server and the client, the index of the field on the list is the bit that represents
+// it on a delta
+template<typename T>
+class DeltaFields {
+public:
+    template<typename O, typename F>
+    static inline void for_each(O* obj, F func) {
+        ::for_each_field<T>(obj, func);
+    }
+};
+
+/**
+ * Encodes objects as deltas against the state they had the last time they were encoded,
+ * only the fields whose serialized form changed are written. A delta is a mask of the
+ * fields (one bit per field, as listed by DeltaFields) followed by the fields themselves.
+ * Since the packets are sent over TCP, the last encoded state is what every client has
+ */
+template<typename T>
+class DeltaEncoder {
+    class Baseline {
+    public:
+        // Object the baseline was taken from, if another object takes it's ID (because
+        // of a removal) the whole object is sent
+        const T* obj = nullptr;
+        std::vector<std::vector<uint8_t>> fields;
+    };
+    std::vector<Baseline> baselines;
+public:
+    // Writes the delta of obj (at the given ID) onto ar, returns false (and writes nothing)
+    // when nothing has changed. When full is set all the fields are written
+    bool encode(Archive& ar, size_t id, const T* obj, bool full) {
+        if(id >= baselines.size())
+            baselines.resize(id + 1);
+
+        Baseline& baseline = baselines[id];
+        if(baseline.obj != obj) {
+            baseline.obj = obj;
+            baseline.fields.clear();
+            full = true;
+        }
+
+        // The fields are serialized directly after the mask (which is filled at the end)
+        // and the ones that did not change are dropped from the archive
+        const size_t start = ar.ptr;
+        uint32_t mask = 0;
+        ::serialize(ar, &mask);
+
+        size_t field = 0;
+        DeltaFields<T>::for_each(obj, [&](const auto* value) {
+            const size_t field_start = ar.ptr;
+            ::serialize(ar, value);
+
+            if(field >= baseline.fields.size())
+                baseline.fields.resize(field + 1);
+
+            std::vector<uint8_t>& base = baseline.fields[field];
+            const uint8_t* data = &ar.buffer[field_start];
+            const size_t size = ar.ptr - field_start;
+            if(full || base.size() != size || std::memcmp(base.data(), data, size)) {
+                mask |= (uint32_t)1 << field;
+                base.assign(data, data + size);
+            } else {
+                ar.buffer.resize(field_start);
+                ar.ptr = field_start;
+            }
+            field++;
+        });
+
+        if(!mask) {
+            ar.buffer.resize(start);
+            ar.ptr = start;
+            return false;
+        }
+        std::memcpy(&ar.buffer[start], &mask, sizeof(mask));
+        return true;
+    }
+
+    // Drops the baselines of objects past the given count (i.e they were removed)
+    void truncate(size_t count) {
+        if(baselines.size() > count)
+            baselines.resize(count);
+    }
+};
+
+// Applies a delta written by DeltaEncoder onto the object
+template<typename T>
+inline void deserialize_delta(Archive& ar, T* obj) {
+    uint32_t mask;
+    ::deserialize(ar, &mask);
+
+    size_t field = 0;
+    DeltaFields<T>::for_each(obj, [&](auto* value) {
+        if(mask & ((uint32_t)1 << field))
+            ::deserialize(ar, value);
+        field++;
+    });
+}
+
+#endif
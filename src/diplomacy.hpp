@@ -1,6 +1,7 @@
 #ifndef DIPLOMACY_H
 #define DIPLOMACY_H
 
+#include "entity.hpp"
 #include "nation.hpp"
 
 namespace Diplomacy {
@@ -159,10 +160,8 @@ enum class TreatyApproval {
 };
 
 typedef uint32_t TreatyId;
-class Treaty {
+class Treaty : public IdEntity<TreatyId> {
 public:
-    using Id = TreatyId;
-    
     std::string name;
     std::vector<TreatyClause::BaseClause*> clauses;
 
@@ -0,0 +1,19 @@
+#ifndef ENTITY_HPP
+#define ENTITY_HPP
+
+/**
+ * Base for the objects that are stored on a list of the world, the object carries the
+ * index it has on said list so obtaining the ID of an object is a O(1) operation instead
+ * of a search on the list
+ */
+template<typename IdType>
+class IdEntity {
+public:
+    using Id = IdType;
+
+    // Index of this object on the list of the world, kept updated by World::insert
+    // and World::remove (and fixed up by World::get_id when it's stale)
+    mutable Id cached_id = (Id)-1;
+};
+
+#endif
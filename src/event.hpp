@@ -1,6 +1,7 @@
 #ifndef EVENT_H
 #define EVENT_H
 
+#include "entity.hpp"
 #include <string>
 #include <vector>
 
@@ -13,10 +14,8 @@ public:
 };
 
 class Nation;
-class Event {
+class Event : public IdEntity<uint16_t> {
 public:
-    using Id = uint16_t;
-    
     std::string ref_name;
     std::string conditions_function;
     std::string do_event_function;
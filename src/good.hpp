@@ -1,12 +1,11 @@
 #ifndef GOOD_HPP
 #define GOOD_HPP
+#include "entity.hpp"
 #include <string>
 
 // A good, mostly serves as a "product type"
-class Good {
+class Good : public IdEntity<uint16_t> {
 public:
-    using Id = uint16_t;
-
     std::string name;
     std::string ref_name;
 
@@ -1,12 +1,11 @@
 #ifndef IDEOLOGY_HPP
 #define IDEOLOGY_HPP
 
+#include "entity.hpp"
 #include <string>
 
-class Ideology {
+class Ideology : public IdEntity<uint8_t> {
 public:
-    using Id = uint8_t;
-
     std::string name;
     std::string ref_name;
 
@@ -1,8 +1,10 @@
 #ifndef IO_IMPL_HPP
 #define IO_IMPL_HPP
 
+#include <algorithm>
 #include <cstdint>
 #include <string>
+#include <vector>
 #include "actions.hpp"
 #include "world.hpp"
 #include "province.hpp"
@@ -15,6 +17,7 @@
 #include "actions.hpp"
 #include "diplomacy.hpp"
 #include "print.hpp"
+#include "tile_codec.hpp"
 
 // TODO: Endianess compatibility
 template<>
@@ -85,102 +88,75 @@ class Serializer<Technology*> : public SerializerReference<World, Technology> {}
 template<>
 class Serializer<NationModifier*> : public SerializerReference<World, NationModifier> {};
 
-template<>
-class Serializer<NationModifier> {
+// Sets of references are ordered by the addresses of the objects, which are not the same
+// on each run, so they are written in the order of the IDs instead. This way the same
+// world always gives the same bytes (i.e a saved game that is loaded and saved again)
+template<typename W, typename T>
+class SerializerReferenceSet : public SerializerContainer<T*, std::set<T*>> {
 public:
-    static inline void serialize(Archive& stream, const NationModifier* obj) {
-        ::serialize(stream, &obj->name);
-        ::serialize(stream, &obj->ref_name);
-        ::serialize(stream, &obj->consciousness_mod);
-        ::serialize(stream, &obj->death_mod);
-        ::serialize(stream, &obj->delivery_cost_mod);
-        ::serialize(stream, &obj->everyday_needs_met_mod);
-        ::serialize(stream, &obj->life_needs_met_mod);
-        ::serialize(stream, &obj->literacy_learn_mod);
-        ::serialize(stream, &obj->luxury_needs_met_mod);
-        ::serialize(stream, &obj->militancy_mod);
-        ::serialize(stream, &obj->reproduction_mod);
-        ::serialize(stream, &obj->salary_paid_mod);
-        ::serialize(stream, &obj->workers_needed_mod);
-    }
-    static inline void deserialize(Archive& stream, NationModifier* obj) {
-        ::deserialize(stream, &obj->name);
-        ::deserialize(stream, &obj->ref_name);
-        ::deserialize(stream, &obj->consciousness_mod);
-        ::deserialize(stream, &obj->death_mod);
-        ::deserialize(stream, &obj->delivery_cost_mod);
-        ::deserialize(stream, &obj->everyday_needs_met_mod);
-        ::deserialize(stream, &obj->life_needs_met_mod);
-        ::deserialize(stream, &obj->literacy_learn_mod);
-        ::deserialize(stream, &obj->luxury_needs_met_mod);
-        ::deserialize(stream, &obj->militancy_mod);
-        ::deserialize(stream, &obj->reproduction_mod);
-        ::deserialize(stream, &obj->salary_paid_mod);
-        ::deserialize(stream, &obj->workers_needed_mod);
-    }
-    static inline size_t size(const NationModifier* obj) {
-        return
-            serialized_size(&obj->name)
-            + serialized_size(&obj->ref_name)
-            + serialized_size(&obj->consciousness_mod)
-            + serialized_size(&obj->death_mod)
-            + serialized_size(&obj->delivery_cost_mod)
-            + serialized_size(&obj->everyday_needs_met_mod)
-            + serialized_size(&obj->life_needs_met_mod)
-            + serialized_size(&obj->literacy_learn_mod)
-            + serialized_size(&obj->luxury_needs_met_mod)
-            + serialized_size(&obj->militancy_mod)
-            + serialized_size(&obj->reproduction_mod)
-            + serialized_size(&obj->salary_paid_mod)
-            + serialized_size(&obj->workers_needed_mod)
-        ;
+    static inline void serialize(Archive& stream, const std::set<T*>* obj_group) {
+        std::vector<typename T::Id> ids;
+        ids.reserve(obj_group->size());
+        for(const auto& obj: *obj_group) {
+            ids.push_back((obj == nullptr) ? (typename T::Id)-1 : W::get_instance().get_id(obj));
+        }
+        std::sort(ids.begin(), ids.end());
+
+        uint32_t len = ids.size();
+        stream.write(&len, sizeof(len));
+        for(const auto& id: ids) {
+            ::serialize(stream, &id);
+        }
     }
 };
+template<>
+class Serializer<std::set<Province*>> : public SerializerReferenceSet<World, Province> {};
+template<>
+class Serializer<std::set<Nation*>> : public SerializerReferenceSet<World, Nation> {};
+template<>
+class Serializer<std::set<Culture*>> : public SerializerReferenceSet<World, Culture> {};
 
 template<>
-class Serializer<NationRelation> : public SerializerMemcpy<NationRelation> {
+class SerializerFields<NationModifier> {
 public:
-    static inline void serialize(Archive& stream, const NationRelation* obj) {
-        ::serialize(stream, &obj->free_supplies);
-        ::serialize(stream, &obj->has_alliance);
-        ::serialize(stream, &obj->has_defensive_pact);
-        ::serialize(stream, &obj->has_embargo);
-        ::serialize(stream, &obj->has_embassy);
-        ::serialize(stream, &obj->has_market_access);
-        ::serialize(stream, &obj->has_military_access);
-        ::serialize(stream, &obj->has_truce);
-        ::serialize(stream, &obj->has_war);
-        ::serialize(stream, &obj->interest);
-        ::serialize(stream, &obj->relation);
-    }
-    static inline void deserialize(Archive& stream, NationRelation* obj) {
-        ::deserialize(stream, &obj->free_supplies);
-        ::deserialize(stream, &obj->has_alliance);
-        ::deserialize(stream, &obj->has_defensive_pact);
-        ::deserialize(stream, &obj->has_embargo);
-        ::deserialize(stream, &obj->has_embassy);
-        ::deserialize(stream, &obj->has_market_access);
-        ::deserialize(stream, &obj->has_military_access);
-        ::deserialize(stream, &obj->has_truce);
-        ::deserialize(stream, &obj->has_war);
-        ::deserialize(stream, &obj->interest);
-        ::deserialize(stream, &obj->relation);
-    }
-    static inline size_t size(const NationRelation* obj) {
-        return serialized_size(&obj->free_supplies)
-            + serialized_size(&obj->has_alliance)
-            + serialized_size(&obj->has_defensive_pact)
-            + serialized_size(&obj->has_embargo)
-            + serialized_size(&obj->has_embassy)
-            + serialized_size(&obj->has_market_access)
-            + serialized_size(&obj->has_military_access)
-            + serialized_size(&obj->has_truce)
-            + serialized_size(&obj->has_war)
-            + serialized_size(&obj->interest)
-            + serialized_size(&obj->relation)
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &NationModifier::name,
+        &NationModifier::ref_name,
+        &NationModifier::consciousness_mod,
+        &NationModifier::death_mod,
+        &NationModifier::delivery_cost_mod,
+        &NationModifier::everyday_needs_met_mod,
+        &NationModifier::life_needs_met_mod,
+        &NationModifier::literacy_learn_mod,
+        &NationModifier::luxury_needs_met_mod,
+        &NationModifier::militancy_mod,
+        &NationModifier::reproduction_mod,
+        &NationModifier::salary_paid_mod,
+        &NationModifier::workers_needed_mod
+    );
 };
+template<>
+class Serializer<NationModifier> : public SerializerReflected<NationModifier> {};
+
+template<>
+class SerializerFields<NationRelation> {
+public:
+    static constexpr auto fields = std::make_tuple(
+        &NationRelation::free_supplies,
+        &NationRelation::has_alliance,
+        &NationRelation::has_defensive_pact,
+        &NationRelation::has_embargo,
+        &NationRelation::has_embassy,
+        &NationRelation::has_market_access,
+        &NationRelation::has_military_access,
+        &NationRelation::has_truce,
+        &NationRelation::has_war,
+        &NationRelation::interest,
+        &NationRelation::relation
+    );
+};
+template<>
+class Serializer<NationRelation> : public SerializerReflected<NationRelation> {};
 
 template<>
 class Serializer<enum AllowancePolicy> : public SerializerMemcpy<enum AllowancePolicy> {};
@@ -192,551 +168,253 @@ template<>
 class Serializer<enum TreatmentPolicy> : public SerializerMemcpy<enum TreatmentPolicy> {};
 
 template<>
-class Serializer<Policies> {
+class SerializerFields<Policies> {
 public:
-    static inline void serialize(Archive& stream, const Policies* obj) {
-        ::serialize(stream, &obj->free_supplies);
-        ::serialize(stream, &obj->immigration);
-        ::serialize(stream, &obj->import_tax);
-        ::serialize(stream, &obj->industry_tax);
-        ::serialize(stream, &obj->legislative_parliament);
-        ::serialize(stream, &obj->med_flat_tax);
-        ::serialize(stream, &obj->men_labour);
-        ::serialize(stream, &obj->men_suffrage);
-        ::serialize(stream, &obj->migration);
-        ::serialize(stream, &obj->military_spending);
-        ::serialize(stream, &obj->national_id);
-        ::serialize(stream, &obj->poor_flat_tax);
-        ::serialize(stream, &obj->private_property);
-        ::serialize(stream, &obj->public_education);
-        ::serialize(stream, &obj->public_healthcare);
-        ::serialize(stream, &obj->rich_flat_tax);
-        ::serialize(stream, &obj->secular_education);
-        ::serialize(stream, &obj->slavery);
-        ::serialize(stream, &obj->social_security);
-        ::serialize(stream, &obj->treatment);
-        ::serialize(stream, &obj->women_labour);
-        ::serialize(stream, &obj->women_suffrage);
-        ::serialize(stream, &obj->minimum_wage);
-    }
-    static inline void deserialize(Archive& stream, Policies* obj) {
-        ::deserialize(stream, &obj->free_supplies);
-        ::deserialize(stream, &obj->immigration);
-        ::deserialize(stream, &obj->import_tax);
-        ::deserialize(stream, &obj->industry_tax);
-        ::deserialize(stream, &obj->legislative_parliament);
-        ::deserialize(stream, &obj->med_flat_tax);
-        ::deserialize(stream, &obj->men_labour);
-        ::deserialize(stream, &obj->men_suffrage);
-        ::deserialize(stream, &obj->migration);
-        ::deserialize(stream, &obj->military_spending);
-        ::deserialize(stream, &obj->national_id);
-        ::deserialize(stream, &obj->poor_flat_tax);
-        ::deserialize(stream, &obj->private_property);
-        ::deserialize(stream, &obj->public_education);
-        ::deserialize(stream, &obj->public_healthcare);
-        ::deserialize(stream, &obj->rich_flat_tax);
-        ::deserialize(stream, &obj->secular_education);
-        ::deserialize(stream, &obj->slavery);
-        ::deserialize(stream, &obj->social_security);
-        ::deserialize(stream, &obj->treatment);
-        ::deserialize(stream, &obj->women_labour);
-        ::deserialize(stream, &obj->women_suffrage);
-        ::deserialize(stream, &obj->minimum_wage);
-    }
-    static inline size_t size(const Policies* obj) {
-        return serialized_size(&obj->free_supplies)
-            + serialized_size(&obj->immigration)
-            + serialized_size(&obj->import_tax)
-            + serialized_size(&obj->industry_tax)
-            + serialized_size(&obj->legislative_parliament)
-            + serialized_size(&obj->med_flat_tax)
-            + serialized_size(&obj->men_labour)
-            + serialized_size(&obj->men_suffrage)
-            + serialized_size(&obj->migration)
-            + serialized_size(&obj->military_spending)
-            + serialized_size(&obj->national_id)
-            + serialized_size(&obj->poor_flat_tax)
-            + serialized_size(&obj->private_property)
-            + serialized_size(&obj->public_education)
-            + serialized_size(&obj->public_healthcare)
-            + serialized_size(&obj->rich_flat_tax)
-            + serialized_size(&obj->secular_education)
-            + serialized_size(&obj->slavery)
-            + serialized_size(&obj->social_security)
-            + serialized_size(&obj->treatment)
-            + serialized_size(&obj->women_labour)
-            + serialized_size(&obj->women_suffrage)
-            + serialized_size(&obj->minimum_wage);
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &Policies::free_supplies,
+        &Policies::immigration,
+        &Policies::import_tax,
+        &Policies::industry_tax,
+        &Policies::legislative_parliament,
+        &Policies::med_flat_tax,
+        &Policies::men_labour,
+        &Policies::men_suffrage,
+        &Policies::migration,
+        &Policies::military_spending,
+        &Policies::national_id,
+        &Policies::poor_flat_tax,
+        &Policies::private_property,
+        &Policies::public_education,
+        &Policies::public_healthcare,
+        &Policies::rich_flat_tax,
+        &Policies::secular_education,
+        &Policies::slavery,
+        &Policies::social_security,
+        &Policies::treatment,
+        &Policies::women_labour,
+        &Policies::women_suffrage,
+        &Policies::minimum_wage
+    );
 };
+template<>
+class Serializer<Policies> : public SerializerReflected<Policies> {};
 
 template<>
-class Serializer<PopType> {
+class SerializerFields<PopType> {
 public:
-    static inline void serialize(Archive& stream, const PopType* obj) {
-        ::serialize(stream, &obj->name);
-        ::serialize(stream, &obj->ref_name);
-        ::serialize(stream, &obj->average_budget);
-    }
-    static inline void deserialize(Archive& stream, PopType* obj) {
-        ::deserialize(stream, &obj->name);
-        ::deserialize(stream, &obj->ref_name);
-        ::deserialize(stream, &obj->average_budget);
-    }
-    static inline size_t size(const PopType* obj) {
-        return serialized_size(&obj->name)
-            + serialized_size(&obj->ref_name)
-            + serialized_size(&obj->average_budget)
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &PopType::name,
+        &PopType::ref_name,
+        &PopType::average_budget
+    );
 };
+template<>
+class Serializer<PopType> : public SerializerReflected<PopType> {};
 
 template<>
-class Serializer<Culture> {
+class SerializerFields<Culture> {
 public:
-    static inline void serialize(Archive& stream, const Culture* obj) {
-        ::serialize(stream, &obj->name);
-        ::serialize(stream, &obj->ref_name);
-    }
-    static inline void deserialize(Archive& stream, Culture* obj) {
-        ::deserialize(stream, &obj->name);
-        ::deserialize(stream, &obj->ref_name);
-    }
-    static inline size_t size(const Culture* obj) {
-        return serialized_size(&obj->name)
-            + serialized_size(&obj->ref_name)
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &Culture::name,
+        &Culture::ref_name
+    );
 };
+template<>
+class Serializer<Culture> : public SerializerReflected<Culture> {};
 
 template<>
-class Serializer<Religion> {
+class SerializerFields<Religion> {
 public:
-    static inline void serialize(Archive& stream, const Religion* obj) {
-        ::serialize(stream, &obj->name);
-        ::serialize(stream, &obj->ref_name);
-    }
-    static inline void deserialize(Archive& stream, Religion* obj) {
-        ::deserialize(stream, &obj->name);
-        ::deserialize(stream, &obj->ref_name);
-    }
-    static inline size_t size(const Religion* obj) {
-        return serialized_size(&obj->name)
-            + serialized_size(&obj->ref_name)
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &Religion::name,
+        &Religion::ref_name
+    );
 };
+template<>
+class Serializer<Religion> : public SerializerReflected<Religion> {};
 
 template<>
-class Serializer<UnitTrait> {
+class SerializerFields<UnitTrait> {
 public:
-    static inline void serialize(Archive& stream, const UnitTrait* obj) {
-        ::serialize(stream, &obj->ref_name);
-        ::serialize(stream, &obj->defense_mod);
-        ::serialize(stream, &obj->attack_mod);
-        ::serialize(stream, &obj->supply_consumption_mod);
-        ::serialize(stream, &obj->speed_mod);
-    }
-    static inline void deserialize(Archive& stream, UnitTrait* obj) {
-        ::deserialize(stream, &obj->ref_name);
-        ::deserialize(stream, &obj->defense_mod);
-        ::deserialize(stream, &obj->attack_mod);
-        ::deserialize(stream, &obj->supply_consumption_mod);
-        ::deserialize(stream, &obj->speed_mod);
-    }
-    static inline size_t size(const UnitTrait* obj) {
-        return serialized_size(&obj->ref_name)
-            + serialized_size(&obj->defense_mod)
-            + serialized_size(&obj->attack_mod)
-            + serialized_size(&obj->supply_consumption_mod)
-            + serialized_size(&obj->speed_mod)
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &UnitTrait::ref_name,
+        &UnitTrait::defense_mod,
+        &UnitTrait::attack_mod,
+        &UnitTrait::supply_consumption_mod,
+        &UnitTrait::speed_mod
+    );
 };
+template<>
+class Serializer<UnitTrait> : public SerializerReflected<UnitTrait> {};
 
 template<>
-class Serializer<Unit> {
+class SerializerFields<Unit> {
 public:
-    static inline void serialize(Archive& stream, const Unit* obj) {
-        ::serialize(stream, &obj->type);
-        ::serialize(stream, &obj->size);
-        ::serialize(stream, &obj->tx);
-        ::serialize(stream, &obj->ty);
-        ::serialize(stream, &obj->x);
-        ::serialize(stream, &obj->y);
-        ::serialize(stream, &obj->owner);
-        ::serialize(stream, &obj->traits);
-    }
-    static inline void deserialize(Archive& stream, Unit* obj) {
-        ::deserialize(stream, &obj->type);
-        ::deserialize(stream, &obj->size);
-        ::deserialize(stream, &obj->tx);
-        ::deserialize(stream, &obj->ty);
-        ::deserialize(stream, &obj->x);
-        ::deserialize(stream, &obj->y);
-        ::deserialize(stream, &obj->owner);
-        ::deserialize(stream, &obj->traits);
-    }
-    static inline size_t size(const Unit* obj) {
-        return serialized_size(&obj->type)
-            + serialized_size(&obj->size)
-            + serialized_size(&obj->tx)
-            + serialized_size(&obj->ty)
-            + serialized_size(&obj->x)
-            + serialized_size(&obj->y)
-            + serialized_size(&obj->owner)
-            + serialized_size(&obj->traits)
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &Unit::type,
+        &Unit::size,
+        &Unit::tx,
+        &Unit::ty,
+        &Unit::x,
+        &Unit::y,
+        &Unit::owner,
+        &Unit::traits
+    );
 };
+template<>
+class Serializer<Unit> : public SerializerReflected<Unit> {};
 
 template<>
-class Serializer<Boat> {
+class SerializerFields<Boat> {
 public:
-    static inline void serialize(Archive& stream, const Boat* obj) {
-        ::serialize(stream, &obj->type);
-        ::serialize(stream, &obj->size);
-        ::serialize(stream, &obj->tx);
-        ::serialize(stream, &obj->ty);
-        ::serialize(stream, &obj->x);
-        ::serialize(stream, &obj->y);
-        ::serialize(stream, &obj->owner);
-        ::serialize(stream, &obj->traits);
-    }
-    static inline void deserialize(Archive& stream, Boat* obj) {
-        ::deserialize(stream, &obj->type);
-        ::deserialize(stream, &obj->size);
-        ::deserialize(stream, &obj->tx);
-        ::deserialize(stream, &obj->ty);
-        ::deserialize(stream, &obj->x);
-        ::deserialize(stream, &obj->y);
-        ::deserialize(stream, &obj->owner);
-        ::deserialize(stream, &obj->traits);
-    }
-    static inline size_t size(const Boat* obj) {
-        return serialized_size(&obj->type)
-            + serialized_size(&obj->size)
-            + serialized_size(&obj->tx)
-            + serialized_size(&obj->ty)
-            + serialized_size(&obj->x)
-            + serialized_size(&obj->y)
-            + serialized_size(&obj->owner)
-            + serialized_size(&obj->traits)
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &Boat::type,
+        &Boat::size,
+        &Boat::tx,
+        &Boat::ty,
+        &Boat::x,
+        &Boat::y,
+        &Boat::owner,
+        &Boat::traits
+    );
 };
+template<>
+class Serializer<Boat> : public SerializerReflected<Boat> {};
 
 template<>
-class Serializer<Pop> {
+class SerializerFields<Pop> {
 public:
-    static inline void serialize(Archive& stream, const Pop* obj) {
-        ::serialize(stream, &obj->size);
-        ::serialize(stream, &obj->unemployed);
-
-        ::serialize(stream, &obj->literacy);
-        ::serialize(stream, &obj->militancy);
-        ::serialize(stream, &obj->consciousness);
-        ::serialize(stream, &obj->budget);
-
-        ::serialize(stream, &obj->life_needs_met);
-        ::serialize(stream, &obj->everyday_needs_met);
-        ::serialize(stream, &obj->luxury_needs_met);
-
-        ::serialize(stream, &obj->type_id);
-        ::serialize(stream, &obj->culture_id);
-        ::serialize(stream, &obj->religion_id);
-    }
-    static inline void deserialize(Archive& stream, Pop* obj) {
-        ::deserialize(stream, &obj->size);
-        ::deserialize(stream, &obj->unemployed);
-        
-        ::deserialize(stream, &obj->literacy);
-        ::deserialize(stream, &obj->militancy);
-        ::deserialize(stream, &obj->consciousness);
-        ::deserialize(stream, &obj->budget);
-
-        ::deserialize(stream, &obj->life_needs_met);
-        ::deserialize(stream, &obj->everyday_needs_met);
-        ::deserialize(stream, &obj->luxury_needs_met);
-
-        ::deserialize(stream, &obj->type_id);
-        ::deserialize(stream, &obj->culture_id);
-        ::deserialize(stream, &obj->religion_id);
-    }
-    static inline size_t size(const Pop* obj) {
-        return serialized_size(&obj->size)
-            + serialized_size(&obj->unemployed)
-            + serialized_size(&obj->literacy)
-            + serialized_size(&obj->militancy)
-            + serialized_size(&obj->consciousness)
-            + serialized_size(&obj->budget)
-            + serialized_size(&obj->life_needs_met)
-            + serialized_size(&obj->everyday_needs_met)
-            + serialized_size(&obj->luxury_needs_met)
-            + serialized_size(&obj->type_id)
-            + serialized_size(&obj->culture_id)
-            + serialized_size(&obj->religion_id)
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &Pop::size,
+        &Pop::unemployed,
+        &Pop::literacy,
+        &Pop::militancy,
+        &Pop::consciousness,
+        &Pop::budget,
+        &Pop::life_needs_met,
+        &Pop::everyday_needs_met,
+        &Pop::luxury_needs_met,
+        &Pop::type_id,
+        &Pop::culture_id,
+        &Pop::religion_id
+    );
 };
+template<>
+class Serializer<Pop> : public SerializerReflected<Pop> {};
 
 template<>
-class Serializer<Descision> {
+class SerializerFields<Descision> {
 public:
-    static inline void serialize(Archive& stream, const Descision* obj) {
-        ::serialize(stream, &obj->name);
-        ::serialize(stream, &obj->ref_name);
-        ::serialize(stream, &obj->do_descision_function);
-        ::serialize(stream, &obj->effects);
-    }
-    static inline void deserialize(Archive& stream, Descision* obj) {
-        ::deserialize(stream, &obj->name);
-        ::deserialize(stream, &obj->ref_name);
-        ::deserialize(stream, &obj->do_descision_function);
-        ::deserialize(stream, &obj->effects);
-    }
-    static inline size_t size(const Descision* obj) {
-        return
-            serialized_size(&obj->name)
-            + serialized_size(&obj->ref_name)
-            + serialized_size(&obj->do_descision_function)
-            + serialized_size(&obj->effects)
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &Descision::name,
+        &Descision::ref_name,
+        &Descision::do_descision_function,
+        &Descision::effects
+    );
 };
+template<>
+class Serializer<Descision> : public SerializerReflected<Descision> {};
 
 template<>
-class Serializer<Event> {
+class SerializerFields<Event> {
 public:
-    static inline void serialize(Archive& stream, const Event* obj) {
-        ::serialize(stream, &obj->ref_name);
-        ::serialize(stream, &obj->conditions_function);
-        ::serialize(stream, &obj->do_event_function);
-        ::serialize(stream, &obj->receivers);
-        ::serialize(stream, &obj->descisions);
-        ::serialize(stream, &obj->title);
-        ::serialize(stream, &obj->text);
-    }
-    static inline void deserialize(Archive& stream, Event* obj) {
-        ::deserialize(stream, &obj->ref_name);
-        ::deserialize(stream, &obj->conditions_function);
-        ::deserialize(stream, &obj->do_event_function);
-        ::deserialize(stream, &obj->receivers);
-        ::deserialize(stream, &obj->descisions);
-        ::deserialize(stream, &obj->title);
-        ::deserialize(stream, &obj->text);
-    }
-    static inline size_t size(const Event* obj) {
-        return
-            serialized_size(&obj->ref_name)
-            + serialized_size(&obj->conditions_function)
-            + serialized_size(&obj->do_event_function)
-            + serialized_size(&obj->receivers)
-            + serialized_size(&obj->descisions)
-            + serialized_size(&obj->title)
-            + serialized_size(&obj->text)
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &Event::ref_name,
+        &Event::conditions_function,
+        &Event::do_event_function,
+        &Event::receivers,
+        &Event::descisions,
+        &Event::title,
+        &Event::text
+    );
 };
+template<>
+class Serializer<Event> : public SerializerReflected<Event> {};
 
 template<>
-class Serializer<Tile> {
+class SerializerFields<Tile> {
 public:
-    static inline void serialize(Archive& stream, const Tile* obj) {
-        ::serialize(stream, &obj->elevation);
-        ::serialize(stream, &obj->infra_level);
-        ::serialize(stream, &obj->owner_id);
-        ::serialize(stream, &obj->province_id);
-    }
-    static inline void deserialize(Archive& stream, Tile* obj) {
-        ::deserialize(stream, &obj->elevation);
-        ::deserialize(stream, &obj->infra_level);
-        ::deserialize(stream, &obj->owner_id);
-        ::deserialize(stream, &obj->province_id);
-    }
-    static inline size_t size(const Tile* obj) {
-        return
-            serialized_size(&obj->elevation)
-            + serialized_size(&obj->infra_level)
-            + serialized_size(&obj->owner_id)
-            + serialized_size(&obj->province_id)
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &Tile::elevation,
+        &Tile::infra_level,
+        &Tile::owner_id,
+        &Tile::province_id
+    );
 };
 template<>
-class Serializer<OrderGoods> {
+class Serializer<Tile> : public SerializerReflected<Tile> {};
+template<>
+class SerializerFields<OrderGoods> {
 public:
-    static inline void serialize(Archive& stream, const OrderGoods* obj) {
-        ::serialize(stream, &obj->good);
-        ::serialize(stream, &obj->building);
-        ::serialize(stream, &obj->payment);
-        ::serialize(stream, &obj->province);
-        ::serialize(stream, &obj->quantity);
-        ::serialize(stream, &obj->type);
-    }
-    static inline void deserialize(Archive& stream, OrderGoods* obj) {
-        ::deserialize(stream, &obj->good);
-        ::deserialize(stream, &obj->building);
-        ::deserialize(stream, &obj->payment);
-        ::deserialize(stream, &obj->province);
-        ::deserialize(stream, &obj->quantity);
-        ::deserialize(stream, &obj->type);
-    }
-    static inline size_t size(const OrderGoods* obj) {
-        return
-            serialized_size(&obj->good)
-            + serialized_size(&obj->building)
-            + serialized_size(&obj->payment)
-            + serialized_size(&obj->province)
-            + serialized_size(&obj->quantity)
-            + serialized_size(&obj->type)
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &OrderGoods::good,
+        &OrderGoods::building,
+        &OrderGoods::payment,
+        &OrderGoods::province,
+        &OrderGoods::quantity,
+        &OrderGoods::type
+    );
 };
+template<>
+class Serializer<OrderGoods> : public SerializerReflected<OrderGoods> {};
 
 template<>
-class Serializer<DeliverGoods> {
+class SerializerFields<DeliverGoods> {
 public:
-    static inline void serialize(Archive& stream, const DeliverGoods* obj) {
-        ::serialize(stream, &obj->good);
-        ::serialize(stream, &obj->building);
-        ::serialize(stream, &obj->payment);
-        ::serialize(stream, &obj->product);
-        ::serialize(stream, &obj->province);
-        ::serialize(stream, &obj->quantity);
-    }
-    static inline void deserialize(Archive& stream, DeliverGoods* obj) {
-        ::deserialize(stream, &obj->good);
-        ::deserialize(stream, &obj->building);
-        ::deserialize(stream, &obj->payment);
-        ::deserialize(stream, &obj->product);
-        ::deserialize(stream, &obj->province);
-        ::deserialize(stream, &obj->quantity);
-    }
-    static inline size_t size(const DeliverGoods* obj) {
-        return
-            serialized_size(&obj->good)
-            + serialized_size(&obj->building)
-            + serialized_size(&obj->payment)
-            + serialized_size(&obj->product)
-            + serialized_size(&obj->province)
-            + serialized_size(&obj->quantity)
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &DeliverGoods::good,
+        &DeliverGoods::building,
+        &DeliverGoods::payment,
+        &DeliverGoods::product,
+        &DeliverGoods::province,
+        &DeliverGoods::quantity
+    );
 };
+template<>
+class Serializer<DeliverGoods> : public SerializerReflected<DeliverGoods> {};
 
 template<>
-class Serializer<NationClientHint> {
+class SerializerFields<NationClientHint> {
 public:
-    static inline void serialize(Archive& stream, const NationClientHint* obj) {
-        ::serialize(stream, &obj->colour);
-        ::serialize(stream, &obj->alt_name);
-        ::serialize(stream, &obj->ideology);
-    }
-    static inline void deserialize(Archive& stream, NationClientHint* obj) {
-        ::deserialize(stream, &obj->colour);
-        ::deserialize(stream, &obj->alt_name);
-        ::deserialize(stream, &obj->ideology);
-    }
-    static inline size_t size(const NationClientHint* obj) {
-        return
-            serialized_size(&obj->colour)
-            + serialized_size(&obj->alt_name)
-            + serialized_size(&obj->ideology)
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &NationClientHint::colour,
+        &NationClientHint::alt_name,
+        &NationClientHint::ideology
+    );
 };
+template<>
+class Serializer<NationClientHint> : public SerializerReflected<NationClientHint> {};
 
 template<>
-class Serializer<Nation> {
+class SerializerFields<Nation> {
 public:
-    static inline void serialize(Archive& stream, const Nation* obj) {
-        ::serialize(stream, &obj->name);
-        ::serialize(stream, &obj->ref_name);
-        ::serialize(stream, &obj->controlled_by_ai);
-        ::serialize(stream, &obj->relations);
-        ::serialize(stream, &obj->spherer_id);
-        ::serialize(stream, &obj->diplomacy_points);
-        ::serialize(stream, &obj->prestige);
-
-        ::serialize(stream, &obj->base_literacy);
-        ::serialize(stream, &obj->is_civilized);
-
-        ::serialize(stream, &obj->infamy);
-        ::serialize(stream, &obj->military_score);
-        ::serialize(stream, &obj->naval_score);
-        ::serialize(stream, &obj->economy_score);
-
-        ::serialize(stream, &obj->budget);
-
-        ::serialize(stream, &obj->capital);
-        ::serialize(stream, &obj->accepted_cultures);
-        ::serialize(stream, &obj->owned_provinces);
-        ::serialize(stream, &obj->current_policy);
-        ::serialize(stream, &obj->diplomatic_timer);
-
-        ::serialize(stream, &obj->inbox);
-        ::serialize(stream, &obj->client_hints);
-        ::serialize(stream, &obj->ideology);
-    }
-    static inline void deserialize(Archive& stream, Nation* obj) {
-        ::deserialize(stream, &obj->name);
-        ::deserialize(stream, &obj->ref_name);
-        ::deserialize(stream, &obj->controlled_by_ai);
-        ::deserialize(stream, &obj->relations);
-        ::deserialize(stream, &obj->spherer_id);
-        ::deserialize(stream, &obj->diplomacy_points);
-        ::deserialize(stream, &obj->prestige);
-
-        ::deserialize(stream, &obj->base_literacy);
-        ::deserialize(stream, &obj->is_civilized);
-
-        ::deserialize(stream, &obj->infamy);
-        ::deserialize(stream, &obj->military_score);
-        ::deserialize(stream, &obj->naval_score);
-        ::deserialize(stream, &obj->economy_score);
-
-        ::deserialize(stream, &obj->budget);
-
-        ::deserialize(stream, &obj->capital);
-        ::deserialize(stream, &obj->accepted_cultures);
-        ::deserialize(stream, &obj->owned_provinces);
-        ::deserialize(stream, &obj->current_policy);
-        ::deserialize(stream, &obj->diplomatic_timer);
-
-        ::deserialize(stream, &obj->inbox);
-        ::deserialize(stream, &obj->client_hints);
-        ::deserialize(stream, &obj->ideology);
-    }
-    static inline size_t size(const Nation* obj) {
-        return
-            serialized_size(&obj->name)
-            + serialized_size(&obj->ref_name)
-            + serialized_size(&obj->controlled_by_ai)
-            + serialized_size(&obj->relations)
-            + serialized_size(&obj->spherer_id)
-            + serialized_size(&obj->diplomacy_points)
-            + serialized_size(&obj->prestige)
-            + serialized_size(&obj->base_literacy)
-            + serialized_size(&obj->is_civilized)
-            + serialized_size(&obj->infamy)
-            + serialized_size(&obj->military_score)
-            + serialized_size(&obj->naval_score)
-            + serialized_size(&obj->economy_score)
-            + serialized_size(&obj->budget)
-            + serialized_size(&obj->capital)
-            + serialized_size(&obj->accepted_cultures)
-            + serialized_size(&obj->owned_provinces)
-            + serialized_size(&obj->current_policy)
-            + serialized_size(&obj->diplomatic_timer)
-            + serialized_size(&obj->inbox)
-            + serialized_size(&obj->client_hints)
-            + serialized_size(&obj->ideology)
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &Nation::name,
+        &Nation::ref_name,
+        &Nation::controlled_by_ai,
+        &Nation::relations,
+        &Nation::spherer_id,
+        &Nation::diplomacy_points,
+        &Nation::prestige,
+        &Nation::base_literacy,
+        &Nation::is_civilized,
+        &Nation::infamy,
+        &Nation::military_score,
+        &Nation::naval_score,
+        &Nation::economy_score,
+        &Nation::budget,
+        &Nation::capital,
+        &Nation::accepted_cultures,
+        &Nation::owned_provinces,
+        &Nation::current_policy,
+        &Nation::diplomatic_timer,
+        &Nation::inbox,
+        &Nation::client_hints,
+        &Nation::ideology
+    );
 };
+template<>
+class Serializer<Nation> : public SerializerReflected<Nation> {};
 
 template<>
 class Serializer<TreatyClauseType> : public SerializerMemcpy<TreatyClauseType> {};
@@ -745,398 +423,186 @@ template<>
 class Serializer<enum TreatyApproval> : public SerializerMemcpy<enum TreatyApproval> {};
 
 template<>
-class Serializer<BoatType> {
+class SerializerFields<BoatType> {
 public:
-    static inline void serialize(Archive& stream, const BoatType* obj) {
-        ::serialize(stream, &obj->name);
-        ::serialize(stream, &obj->ref_name);
-        ::serialize(stream, &obj->speed);
-        ::serialize(stream, &obj->max_health);
-        ::serialize(stream, &obj->defense);
-        ::serialize(stream, &obj->attack);
-        ::serialize(stream, &obj->capacity);
-        ::serialize(stream, &obj->build_time);
-    }
-    static inline void deserialize(Archive& stream, BoatType* obj) {
-        ::deserialize(stream, &obj->name);
-        ::deserialize(stream, &obj->ref_name);
-        ::deserialize(stream, &obj->speed);
-        ::deserialize(stream, &obj->max_health);
-        ::deserialize(stream, &obj->defense);
-        ::deserialize(stream, &obj->attack);
-        ::deserialize(stream, &obj->capacity);
-        ::deserialize(stream, &obj->build_time);
-    }
-    static inline size_t size(const BoatType* obj) {
-        return
-            serialized_size(&obj->name)
-            + serialized_size(&obj->ref_name)
-            + serialized_size(&obj->speed)
-            + serialized_size(&obj->max_health)
-            + serialized_size(&obj->defense)
-            + serialized_size(&obj->attack)
-            + serialized_size(&obj->capacity)
-            + serialized_size(&obj->build_time)
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &BoatType::name,
+        &BoatType::ref_name,
+        &BoatType::speed,
+        &BoatType::max_health,
+        &BoatType::defense,
+        &BoatType::attack,
+        &BoatType::capacity,
+        &BoatType::build_time
+    );
 };
+template<>
+class Serializer<BoatType> : public SerializerReflected<BoatType> {};
 
 template<>
-class Serializer<UnitType> {
+class SerializerFields<UnitType> {
 public:
-    static inline void serialize(Archive& stream, const UnitType* obj) {
-        ::serialize(stream, &obj->name);
-        ::serialize(stream, &obj->ref_name);
-        ::serialize(stream, &obj->supply_consumption);
-        ::serialize(stream, &obj->speed);
-        ::serialize(stream, &obj->max_health);
-        ::serialize(stream, &obj->defense);
-        ::serialize(stream, &obj->attack);
-        ::serialize(stream, &obj->build_time);
-    }
-    static inline void deserialize(Archive& stream, UnitType* obj) {
-        ::deserialize(stream, &obj->name);
-        ::deserialize(stream, &obj->ref_name);
-        ::deserialize(stream, &obj->supply_consumption);
-        ::deserialize(stream, &obj->speed);
-        ::deserialize(stream, &obj->max_health);
-        ::deserialize(stream, &obj->defense);
-        ::deserialize(stream, &obj->attack);
-        ::deserialize(stream, &obj->build_time);
-    }
-    static inline size_t size(const UnitType* obj) {
-        return
-            serialized_size(&obj->name)
-            + serialized_size(&obj->ref_name)
-            + serialized_size(&obj->supply_consumption)
-            + serialized_size(&obj->speed)
-            + serialized_size(&obj->max_health)
-            + serialized_size(&obj->defense)
-            + serialized_size(&obj->attack)
-            + serialized_size(&obj->req_goods)
-            + serialized_size(&obj->build_time)
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &UnitType::name,
+        &UnitType::ref_name,
+        &UnitType::supply_consumption,
+        &UnitType::speed,
+        &UnitType::max_health,
+        &UnitType::defense,
+        &UnitType::attack,
+        &UnitType::build_time
+    );
 };
+template<>
+class Serializer<UnitType> : public SerializerReflected<UnitType> {};
 
 template<>
-class Serializer<Province> {
+class SerializerFields<Province> {
 public:
-    static inline void serialize(Archive& stream, const Province* obj) {
-        ::serialize(stream, &obj->name);
-        ::serialize(stream, &obj->ref_name);
-        ::serialize(stream, &obj->color);
-        ::serialize(stream, &obj->budget);
-        ::serialize(stream, &obj->n_tiles);
-        ::serialize(stream, &obj->max_x);
-        ::serialize(stream, &obj->max_y);
-        ::serialize(stream, &obj->min_x);
-        ::serialize(stream, &obj->min_y);
-        ::serialize(stream, &obj->supply_limit);
-        ::serialize(stream, &obj->supply_rem);
-        ::serialize(stream, &obj->worker_pool);
-        ::serialize(stream, &obj->owner);
-        ::serialize(stream, &obj->nucleuses);
-        ::serialize(stream, &obj->neighbours);
-        ::serialize(stream, &obj->stockpile);
-        ::serialize(stream, &obj->products);
-        ::serialize(stream, &obj->pops);
-    }
-    static inline void deserialize(Archive& stream, Province* obj) {
-        ::deserialize(stream, &obj->name);
-        ::deserialize(stream, &obj->ref_name);
-        ::deserialize(stream, &obj->color);
-        ::deserialize(stream, &obj->budget);
-        ::deserialize(stream, &obj->n_tiles);
-        ::deserialize(stream, &obj->max_x);
-        ::deserialize(stream, &obj->max_y);
-        ::deserialize(stream, &obj->min_x);
-        ::deserialize(stream, &obj->min_y);
-        ::deserialize(stream, &obj->supply_limit);
-        ::deserialize(stream, &obj->supply_rem);
-        ::deserialize(stream, &obj->worker_pool);
-        ::deserialize(stream, &obj->owner);
-        ::deserialize(stream, &obj->nucleuses);
-        ::deserialize(stream, &obj->neighbours);
-        ::deserialize(stream, &obj->stockpile);
-        ::deserialize(stream, &obj->products);
-        ::deserialize(stream, &obj->pops);
-    }
-    static inline size_t size(const Province* obj) {
-        return
-            serialized_size(&obj->name)
-            + serialized_size(&obj->ref_name)
-            + serialized_size(&obj->color)
-            + serialized_size(&obj->budget)
-            + serialized_size(&obj->n_tiles)
-            + serialized_size(&obj->max_x)
-            + serialized_size(&obj->max_y)
-            + serialized_size(&obj->min_x)
-            + serialized_size(&obj->min_y)
-            + serialized_size(&obj->supply_limit)
-            + serialized_size(&obj->supply_rem)
-            + serialized_size(&obj->worker_pool)
-            + serialized_size(&obj->owner)
-            + serialized_size(&obj->nucleuses)
-            + serialized_size(&obj->neighbours)
-            + serialized_size(&obj->stockpile)
-            + serialized_size(&obj->products)
-            + serialized_size(&obj->pops)
-        ;
-        // TODO: Rest of fields
-    }
+    static constexpr auto fields = std::make_tuple(
+        &Province::name,
+        &Province::ref_name,
+        &Province::color,
+        &Province::budget,
+        &Province::n_tiles,
+        &Province::max_x,
+        &Province::max_y,
+        &Province::min_x,
+        &Province::min_y,
+        &Province::supply_limit,
+        &Province::supply_rem,
+        &Province::worker_pool,
+        &Province::owner,
+        &Province::nucleuses,
+        &Province::neighbours,
+        &Province::stockpile,
+        &Province::products,
+        &Province::pops
+    );
 };
+template<>
+class Serializer<Province> : public SerializerReflected<Province> {};
 
 template<>
-class Serializer<BuildingType> {
+class SerializerFields<BuildingType> {
 public:
-    static inline void serialize(Archive& stream, const BuildingType* obj) {
-        ::serialize(stream, &obj->ref_name);
-        ::serialize(stream, &obj->is_plot_on_land);
-        ::serialize(stream, &obj->is_plot_on_sea);
-        ::serialize(stream, &obj->is_build_land_units);
-        ::serialize(stream, &obj->is_build_naval_units);
-        ::serialize(stream, &obj->defense_bonus);
-        ::serialize(stream, &obj->req_goods);
-    }
-    static inline void deserialize(Archive& stream, BuildingType* obj) {
-        ::deserialize(stream, &obj->ref_name);
-        ::deserialize(stream, &obj->is_plot_on_land);
-        ::deserialize(stream, &obj->is_plot_on_sea);
-        ::deserialize(stream, &obj->is_build_land_units);
-        ::deserialize(stream, &obj->is_build_naval_units);
-        ::deserialize(stream, &obj->defense_bonus);
-        ::deserialize(stream, &obj->req_goods);
-    }
-    static inline size_t size(const BuildingType* obj) {
-        return
-            serialized_size(&obj->ref_name)
-            + serialized_size(&obj->is_plot_on_land)
-            + serialized_size(&obj->is_plot_on_sea)
-            + serialized_size(&obj->is_build_land_units)
-            + serialized_size(&obj->is_build_naval_units)
-            + serialized_size(&obj->defense_bonus)
-            + serialized_size(&obj->req_goods)
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &BuildingType::ref_name,
+        &BuildingType::is_plot_on_land,
+        &BuildingType::is_plot_on_sea,
+        &BuildingType::is_build_land_units,
+        &BuildingType::is_build_naval_units,
+        &BuildingType::defense_bonus,
+        &BuildingType::req_goods
+    );
 };
+template<>
+class Serializer<BuildingType> : public SerializerReflected<BuildingType> {};
 
 template<>
-class Serializer<Building> {
+class SerializerFields<Building> {
 public:
-    static inline void serialize(Archive& stream, const Building* obj) {
-        ::serialize(stream, &obj->x);
-        ::serialize(stream, &obj->y);
-        ::serialize(stream, &obj->type);
-        ::serialize(stream, &obj->owner);
-        ::serialize(stream, &obj->working_unit_type);
-        ::serialize(stream, &obj->working_boat_type);
-        ::serialize(stream, &obj->build_time);
-        ::serialize(stream, &obj->corporate_owner);
-        ::serialize(stream, &obj->budget);
-        ::serialize(stream, &obj->days_unoperational);
-        ::serialize(stream, &obj->production_cost);
-        ::serialize(stream, &obj->stockpile);
-        ::serialize(stream, &obj->output_products);
-        ::serialize(stream, &obj->min_quality);
-        ::serialize(stream, &obj->willing_payment);
-        ::serialize(stream, &obj->workers);
-        ::serialize(stream, &obj->req_goods);
-    }
-    static inline void deserialize(Archive& stream, Building* obj) {
-        ::deserialize(stream, &obj->x);
-        ::deserialize(stream, &obj->y);
-        ::deserialize(stream, &obj->type);
-        ::deserialize(stream, &obj->owner);
-        ::deserialize(stream, &obj->working_unit_type);
-        ::deserialize(stream, &obj->working_boat_type);
-        ::deserialize(stream, &obj->build_time);
-        ::deserialize(stream, &obj->corporate_owner);
-        ::deserialize(stream, &obj->budget);
-        ::deserialize(stream, &obj->days_unoperational);
-        ::deserialize(stream, &obj->production_cost);
-        ::deserialize(stream, &obj->stockpile);
-        ::deserialize(stream, &obj->output_products);
-        ::deserialize(stream, &obj->min_quality);
-        ::deserialize(stream, &obj->willing_payment);
-        ::deserialize(stream, &obj->workers);
-        ::deserialize(stream, &obj->req_goods);
-    }
-    static inline size_t size(const Building* obj) {
-        return
-            serialized_size(&obj->x)
-            + serialized_size(&obj->y)
-            + serialized_size(&obj->type)
-            + serialized_size(&obj->owner)
-            + serialized_size(&obj->working_unit_type)
-            + serialized_size(&obj->working_boat_type)
-            + serialized_size(&obj->build_time)
-            + serialized_size(&obj->corporate_owner)
-            + serialized_size(&obj->budget)
-            + serialized_size(&obj->days_unoperational)
-            + serialized_size(&obj->production_cost)
-            + serialized_size(&obj->stockpile)
-            + serialized_size(&obj->output_products)
-            + serialized_size(&obj->min_quality)
-            + serialized_size(&obj->willing_payment)
-            + serialized_size(&obj->workers)
-            + serialized_size(&obj->req_goods)
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &Building::x,
+        &Building::y,
+        &Building::type,
+        &Building::owner,
+        &Building::working_unit_type,
+        &Building::working_boat_type,
+        &Building::build_time,
+        &Building::corporate_owner,
+        &Building::budget,
+        &Building::days_unoperational,
+        &Building::production_cost,
+        &Building::stockpile,
+        &Building::output_products,
+        &Building::min_quality,
+        &Building::willing_payment,
+        &Building::workers,
+        &Building::req_goods
+    );
 };
+template<>
+class Serializer<Building> : public SerializerReflected<Building> {};
 
 template<>
-class Serializer<Company> {
+class SerializerFields<Company> {
+public:
+    static constexpr auto fields = std::make_tuple(
+        &Company::name,
+        &Company::money,
+        &Company::is_transport,
+        &Company::is_retailer,
+        &Company::is_industry,
+        &Company::operating_provinces
+    );
+};
+template<>
+class Serializer<Company> : public SerializerReflected<Company> {
 public:
-    static inline void serialize(Archive& stream, const Company* obj) {
-        ::serialize(stream, &obj->name);
-        
-        ::serialize(stream, &obj->money);
-        ::serialize(stream, &obj->is_transport);
-        ::serialize(stream, &obj->is_retailer);
-        ::serialize(stream, &obj->is_industry);
-        
-        ::serialize(stream, &obj->operating_provinces);
-    }
     static inline void deserialize(Archive& stream, Company* obj) {
-        ::deserialize(stream, &obj->name);
-        
-        ::deserialize(stream, &obj->money);
-        ::deserialize(stream, &obj->is_transport);
-        ::deserialize(stream, &obj->is_retailer);
-        ::deserialize(stream, &obj->is_industry);
-        
-        ::deserialize(stream, &obj->operating_provinces);
-    }
-    static inline size_t size(const Company* obj) {
-        return
-            serialized_size(&obj->name)
-            + serialized_size(&obj->money)
-            + serialized_size(&obj->is_transport)
-            + serialized_size(&obj->is_retailer)
-            + serialized_size(&obj->is_industry)
-            + serialized_size(&obj->operating_provinces)
-        ;
+        SerializerReflected<Company>::deserialize(stream, obj);
+        obj->update_operating_provinces(World::get_instance());
     }
 };
 
 template<>
-class Serializer<Product> {
+class SerializerFields<Product> {
 public:
-    static inline void serialize(Archive& stream, const Product* obj) {
-        ::serialize(stream, &obj->owner);
-        ::serialize(stream, &obj->origin);
-        ::serialize(stream, &obj->building);
-        ::serialize(stream, &obj->good);
-        ::serialize(stream, &obj->price);
-        ::serialize(stream, &obj->price_vel);
-        ::serialize(stream, &obj->quality);
-        ::serialize(stream, &obj->supply);
-        ::serialize(stream, &obj->demand);
-    }
-    static inline void deserialize(Archive& stream, Product* obj) {
-        ::deserialize(stream, &obj->owner);
-        ::deserialize(stream, &obj->origin);
-        ::deserialize(stream, &obj->building);
-        ::deserialize(stream, &obj->good);
-        ::deserialize(stream, &obj->price);
-        ::deserialize(stream, &obj->price_vel);
-        ::deserialize(stream, &obj->quality);
-        ::deserialize(stream, &obj->supply);
-        ::deserialize(stream, &obj->demand);
-    }
-    static inline size_t size(const Product* obj) {
-        return
-            serialized_size(&obj->owner)
-            + serialized_size(&obj->origin)
-            + serialized_size(&obj->building)
-            + serialized_size(&obj->good)
-            + serialized_size(&obj->price)
-            + serialized_size(&obj->price_vel)
-            + serialized_size(&obj->quality)
-            + serialized_size(&obj->supply)
-            + serialized_size(&obj->demand)
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &Product::owner,
+        &Product::origin,
+        &Product::building,
+        &Product::good,
+        &Product::price,
+        &Product::price_vel,
+        &Product::quality,
+        &Product::supply,
+        &Product::demand
+    );
 };
+template<>
+class Serializer<Product> : public SerializerReflected<Product> {};
 
 template<>
-class Serializer<Invention> {
+class SerializerFields<Invention> {
 public:
-    static inline void serialize(Archive& stream, const Invention* obj) {
-        ::serialize(stream, &obj->name);
-        ::serialize(stream, &obj->ref_name);
-        ::serialize(stream, &obj->description);
-        ::serialize(stream, &obj->mod);
-    }
-    static inline void deserialize(Archive& stream, Invention* obj) {
-        ::deserialize(stream, &obj->name);
-        ::deserialize(stream, &obj->ref_name);
-        ::deserialize(stream, &obj->description);
-        ::deserialize(stream, &obj->mod);
-    }
-    static inline size_t size(const Invention* obj) {
-        return
-            serialized_size(&obj->name)
-            + serialized_size(&obj->ref_name)
-            + serialized_size(&obj->description)
-            + serialized_size(&obj->mod)
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &Invention::name,
+        &Invention::ref_name,
+        &Invention::description,
+        &Invention::mod
+    );
 };
+template<>
+class Serializer<Invention> : public SerializerReflected<Invention> {};
 
 template<>
-class Serializer<Technology> {
+class SerializerFields<Technology> {
 public:
-    static inline void serialize(Archive& stream, const Technology* obj) {
-        ::serialize(stream, &obj->name);
-        ::serialize(stream, &obj->ref_name);
-        ::serialize(stream, &obj->description);
-        ::serialize(stream, &obj->cost);
-        ::serialize(stream, &obj->req_technologies);
-        ::serialize(stream, &obj->inventions);
-    }
-    static inline void deserialize(Archive& stream, Technology* obj) {
-        ::deserialize(stream, &obj->name);
-        ::deserialize(stream, &obj->ref_name);
-        ::deserialize(stream, &obj->description);
-        ::deserialize(stream, &obj->cost);
-        ::deserialize(stream, &obj->req_technologies);
-        ::deserialize(stream, &obj->inventions);
-    }
-    static inline size_t size(const Technology* obj) {
-        return
-            serialized_size(&obj->name)
-            + serialized_size(&obj->ref_name)
-            + serialized_size(&obj->description)
-            + serialized_size(&obj->cost)
-            + serialized_size(&obj->req_technologies)
-            + serialized_size(&obj->inventions)
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &Technology::name,
+        &Technology::ref_name,
+        &Technology::description,
+        &Technology::cost,
+        &Technology::req_technologies,
+        &Technology::inventions
+    );
 };
+template<>
+class Serializer<Technology> : public SerializerReflected<Technology> {};
 
 template<>
-class Serializer<Good> {
+class SerializerFields<Good> {
 public:
-    static inline void serialize(Archive& stream, const Good* obj) {
-        ::serialize(stream, &obj->name);
-        ::serialize(stream, &obj->ref_name);
-        ::serialize(stream, &obj->is_edible);
-    }
-    static inline void deserialize(Archive& stream, Good* obj) {
-        ::deserialize(stream, &obj->name);
-        ::deserialize(stream, &obj->ref_name);
-        ::deserialize(stream, &obj->is_edible);
-    }
-    static inline size_t size(const Good* obj) {
-        return
-            serialized_size(&obj->name)
-            + serialized_size(&obj->ref_name)
-            + serialized_size(&obj->is_edible)
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &Good::name,
+        &Good::ref_name,
+        &Good::is_edible
+    );
 };
+template<>
+class Serializer<Good> : public SerializerReflected<Good> {};
 
 template<>
 class Serializer<TreatyClause::BaseClause*> {
@@ -1309,54 +775,30 @@ public:
 };
 
 template<>
-class Serializer<Treaty> {
+class SerializerFields<Treaty> {
 public:
-    static inline void serialize(Archive& stream, const Treaty* obj) {
-        ::serialize(stream, &obj->name);
-        ::serialize(stream, &obj->receiver);
-        ::serialize(stream, &obj->sender);
-        ::serialize(stream, &obj->approval_status);
-        ::serialize(stream, &obj->clauses);
-    }
-    static inline void deserialize(Archive& stream, Treaty* obj) {
-        ::deserialize(stream, &obj->name);
-        ::deserialize(stream, &obj->receiver);
-        ::deserialize(stream, &obj->sender);
-        ::deserialize(stream, &obj->approval_status);
-        ::deserialize(stream, &obj->clauses);
-    }
-    static inline size_t size(const Treaty* obj) {
-        return
-            serialized_size(&obj->name)
-            + serialized_size(&obj->receiver)
-            + serialized_size(&obj->sender)
-            + serialized_size(&obj->approval_status)
-            + serialized_size(&obj->clauses)
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &Treaty::name,
+        &Treaty::receiver,
+        &Treaty::sender,
+        &Treaty::approval_status,
+        &Treaty::clauses
+    );
 };
+template<>
+class Serializer<Treaty> : public SerializerReflected<Treaty> {};
 
 template<>
-class Serializer<Ideology> {
+class SerializerFields<Ideology> {
 public:
-    static inline void serialize(Archive& stream, const Ideology* obj) {
-        ::serialize(stream, &obj->ref_name);
-        ::serialize(stream, &obj->name);
-        ::serialize(stream, &obj->check_policies_fn);
-    }
-    static inline void deserialize(Archive& stream, Ideology* obj) {
-        ::deserialize(stream, &obj->ref_name);
-        ::deserialize(stream, &obj->name);
-        ::deserialize(stream, &obj->check_policies_fn);
-    }
-    static inline size_t size(const Ideology* obj) {
-        return
-            serialized_size(&obj->ref_name)
-            + serialized_size(&obj->name)
-            + serialized_size(&obj->check_policies_fn)
-        ;
-    }
+    static constexpr auto fields = std::make_tuple(
+        &Ideology::ref_name,
+        &Ideology::name,
+        &Ideology::check_policies_fn
+    );
 };
+template<>
+class Serializer<Ideology> : public SerializerReflected<Ideology> {};
 
 template<>
 class Serializer<World> {
@@ -1367,20 +809,52 @@ public:
         ::deserialize(stream, &n_elems);
         for(size_t i = 0; i < n_elems; i++) {
             T* sub_obj = new T();
-            obj->get_list(sub_obj).push_back(sub_obj);
+            obj->insert(sub_obj);
         }
         return n_elems;
     }
 
+    // Use the published tiles when there are, so we do not read the tiles while they are
+    // being written
+    static inline const Tile* get_tiles(const World* obj, std::shared_ptr<const std::vector<Tile>>& snapshot) {
+        snapshot = obj->get_tiles_snapshot();
+        if(snapshot != nullptr && snapshot->size() == obj->width * obj->height)
+            return snapshot->data();
+        return obj->tiles;
+    }
+
     static inline void serialize(Archive& stream, const World* obj) {
+        print_info("(SERIALIZER) World");
+        print_info("  n_goods %zu", obj->goods.size());
+        print_info("  n_unit_types %zu", obj->unit_types.size());
+        print_info("  n_religions %zu", obj->religions.size());
+        print_info("  n_cultures %zu", obj->cultures.size());
+        print_info("  n_pop_types %zu", obj->pop_types.size());
+        print_info("  n_nations %zu", obj->nations.size());
+        print_info("  n_provinces %zu", obj->provinces.size());
+        print_info("  n_companies %zu", obj->companies.size());
+        print_info("  n_products %zu", obj->products.size());
+        print_info("  n_events %zu", obj->events.size());
+        print_info("  n_unit_traits %zu", obj->unit_traits.size());
+        print_info("  n_outpost_types %zu", obj->building_types.size());
+        print_info("  n_outposts %zu", obj->buildings.size());
+        print_info("  n_treaties %zu", obj->treaties.size());
+        print_info("  n_boats %zu", obj->boats.size());
+        print_info("  n_ideologies %zu", obj->ideologies.size());
+
+        std::shared_ptr<const std::vector<Tile>> snapshot;
+        serialize(stream, obj, get_tiles(obj, snapshot));
+    }
+
+    // Serializes the world with the given tiles (see get_tiles), nothing here takes a
+    // lock so it can be used on a forked process
+    static inline void serialize(Archive& stream, const World* obj, const Tile* tiles) {
         ::serialize(stream, &obj->width);
         ::serialize(stream, &obj->height);
         ::serialize(stream, &obj->sea_level);
         ::serialize(stream, &obj->time);
         
-        for(size_t i = 0; i < obj->width * obj->height; i++) {
-            ::serialize(stream, &obj->tiles[i]);
-        }
+        TileCodec::encode(stream, tiles, obj->width * obj->height);
         
         const Good::Id n_goods = obj->goods.size();
         ::serialize(stream, &n_goods);
@@ -1423,24 +897,6 @@ public:
         const NationModifier::Id n_nation_modifiers = obj->nation_modifiers.size();
         ::serialize(stream, &n_nation_modifiers);
         
-        print_info("(SERIALIZER) World");
-        print_info("  n_goods %zu", obj->goods.size());
-        print_info("  n_unit_types %zu", obj->unit_types.size());
-        print_info("  n_religions %zu", obj->religions.size());
-        print_info("  n_cultures %zu", obj->cultures.size());
-        print_info("  n_pop_types %zu", obj->pop_types.size());
-        print_info("  n_nations %zu", obj->nations.size());
-        print_info("  n_provinces %zu", obj->provinces.size());
-        print_info("  n_companies %zu", obj->companies.size());
-        print_info("  n_products %zu", obj->products.size());
-        print_info("  n_events %zu", obj->events.size());
-        print_info("  n_unit_traits %zu", obj->unit_traits.size());
-        print_info("  n_outpost_types %zu", obj->building_types.size());
-        print_info("  n_outposts %zu", obj->buildings.size());
-        print_info("  n_treaties %zu", obj->treaties.size());
-        print_info("  n_boats %zu", obj->boats.size());
-        print_info("  n_ideologies %zu", obj->ideologies.size());
-        
         for(auto& sub_obj: obj->goods) {
             ::serialize(stream, sub_obj);
         }
@@ -1532,9 +988,7 @@ public:
         ::deserialize(stream, &obj->time);
         
         obj->tiles = new Tile[obj->width * obj->height];
-        for(size_t i = 0; i < obj->width * obj->height; i++) {
-            ::deserialize(stream, &obj->tiles[i]);
-        }
+        TileCodec::decode(stream, obj->tiles, obj->width * obj->height);
         
         // In order to avoid post-deserialization relational patcher,
         // we will simply allocate everything with "empty" objects,
@@ -1675,7 +1129,7 @@ public:
             ::deserialize(stream, sub_obj);
         }
 
-        for(size_t i = 0; i < n_inventions; i++) {
+        for(size_t i = 0; i < n_nation_modifiers; i++) {
             NationModifier* sub_obj = obj->nation_modifiers.at(i);
             ::deserialize(stream, sub_obj);
         }
@@ -1684,35 +1138,49 @@ public:
         ::deserialize(stream, &obj->orders);
     }
 
+    template<typename T>
+    static inline size_t list_size(const std::vector<T*>& list) {
+        size_t total = sizeof(typename T::Id);
+        for(const auto& sub_obj: list) {
+            total += ::serialized_size(sub_obj);
+        }
+        return total;
+    }
+
     static inline size_t size(const World* obj) {
+        std::shared_ptr<const std::vector<Tile>> snapshot;
+        return size(obj, get_tiles(obj, snapshot));
+    }
+
+    static inline size_t size(const World* obj, const Tile* tiles) {
         return
             serialized_size(&obj->width)
             + serialized_size(&obj->height)
             + serialized_size(&obj->sea_level)
             + serialized_size(&obj->time)
+            + TileCodec::encoded_size(tiles, obj->width * obj->height)
+            + list_size(obj->goods)
+            + list_size(obj->unit_types)
+            + list_size(obj->boat_types)
+            + list_size(obj->religions)
+            + list_size(obj->cultures)
+            + list_size(obj->pop_types)
+            + list_size(obj->nations)
+            + list_size(obj->provinces)
+            + list_size(obj->companies)
+            + list_size(obj->products)
+            + list_size(obj->events)
+            + list_size(obj->unit_traits)
+            + list_size(obj->building_types)
+            + list_size(obj->buildings)
+            + list_size(obj->treaties)
+            + list_size(obj->boats)
+            + list_size(obj->ideologies)
+            + list_size(obj->inventions)
+            + list_size(obj->technologies)
+            + list_size(obj->nation_modifiers)
             + serialized_size(&obj->delivers)
             + serialized_size(&obj->orders)
-            + (sizeof(Tile) * (obj->width* obj->height))
-            + (obj->goods.size() * sizeof(Good))
-            + (obj->unit_types.size() * sizeof(UnitType))
-            + (obj->boat_types.size() * sizeof(BoatType))
-            + (obj->religions.size() * sizeof(Religion))
-            + (obj->cultures.size() * sizeof(Culture))
-            + (obj->pop_types.size() * sizeof(PopType))
-            + (obj->nations.size() * sizeof(Nation))
-            + (obj->provinces.size() * sizeof(Province))
-            + (obj->companies.size() * sizeof(Company))
-            + (obj->products.size() * sizeof(Product))
-            + (obj->events.size() * sizeof(Event))
-            + (obj->unit_traits.size() * sizeof(UnitTrait))
-            + (obj->building_types.size() * sizeof(BuildingType))
-            + (obj->buildings.size() * sizeof(Building))
-            + (obj->treaties.size() * sizeof(Treaty))
-            + (obj->boats.size() * sizeof(Boat))
-            + (obj->ideologies.size() * sizeof(Ideology))
-            + (obj->inventions.size() * sizeof(Invention))
-            + (obj->technologies.size() * sizeof(Technology))
-            + (obj->nation_modifiers.size() * sizeof(NationModifier))
         ;
     }
 };
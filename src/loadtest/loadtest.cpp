@@ -0,0 +1,528 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#ifdef unix
+#	include <unistd.h>
+#	include <sys/wait.h>
+#endif
+
+#include "../world.hpp"
+#include "../print.hpp"
+#include "../serializer.hpp"
+#include "../io_impl.hpp"
+#include "../delta.hpp"
+#include "../actions.hpp"
+#include "../client/client_network.hpp"
+
+#ifdef windows
+const char* gettext(const char* str) {
+    return str;
+}
+#endif
+
+World::World(void) {
+    g_world = this;
+};
+World::~World(){};
+
+/**
+ * Network load test, opens several connections to a server with headless bots that select
+ * a nation and do a mix of actions like players would (in the same way as simple_ai, thru
+ * the queue of the client). Each bot runs on it's own process since the client keeps the
+ * world on a global. Measured: the time to receive the snapshot, the round-trip latency
+ * of each kind of action (until the server tells about it's effects), the bytes received
+ * per tick and the queue the server has for each bot (the bytes received between a ping
+ * and it's answer, which were queued before the answer)
+ */
+class LoadTestOptions {
+public:
+    std::string host = "127.0.0.1";
+    unsigned port = 1836;
+    size_t n_clients = 8;
+    size_t seconds = 60;
+    size_t actions_per_second = 5;
+    unsigned seed = 0;
+    bool verbose = false;
+};
+
+static void print_usage(const char* name) {
+    printf("Usage: %s [--host IP] [--port N] [--clients N] [--seconds N] [--rate N] [--seed N] [--verbose]\n", name);
+    printf("  --host IP: Address of the server (default 127.0.0.1)\n");
+    printf("  --port N: Port of the server (default 1836)\n");
+    printf("  --clients N: Number of bots connected at the same time (default 8)\n");
+    printf("  --seconds N: Duration of the test (default 60)\n");
+    printf("  --rate N: Actions per second done by each bot (default 5)\n");
+    printf("  --seed N: Seed for the random number generator (default 0)\n");
+    printf("  --verbose: Do not silence the output of the bots\n");
+}
+
+static uint64_t now_us(void) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * A single bot, the actions it sends are kept until the server tells about their effects.
+ * The callback of the client runs on the network thread (with the world locked) while the
+ * actions are sent by the thread of the bot, so the pending actions are guarded
+ */
+class Bot {
+    Client* client;
+    Nation* nation = nullptr;
+    size_t policy_field = 0;
+
+    std::mutex pending_mutex;
+    std::map<std::pair<const Unit*, std::pair<size_t, size_t>>, uint64_t> pending_targets;
+    std::map<std::pair<size_t, size_t>, uint64_t> pending_buildings;
+    std::map<std::string, uint64_t> pending_messages;
+    std::vector<uint64_t> pending_policies;
+    uint64_t ping_time = 0;
+    uint64_t ping_bytes = 0;
+    uint64_t tick_bytes = 0;
+    size_t n_messages = 0;
+
+    void send(Archive& ar) {
+        Packet packet = Packet();
+        packet.data(ar.get_buffer(), ar.size());
+        const std::lock_guard<std::mutex> lock(client->packet_mutex);
+        client->packet_queue.push_back(packet);
+    }
+
+    void on_action(ActionType action, Archive& ar);
+    void change_unit_target(void);
+    void enact_policy(void);
+    void chat(void);
+    void add_building(void);
+    void ping(void);
+public:
+    std::map<std::string, std::vector<uint64_t>> samples;
+
+    void run(const LoadTestOptions& options, size_t id);
+};
+
+void Bot::on_action(ActionType action, Archive& ar) {
+    const uint64_t now = now_us();
+    const std::lock_guard<std::mutex> lock(pending_mutex);
+    switch(action) {
+    case ActionType::WORLD_TICK: {
+        const uint64_t bytes = client->bytes_received;
+        if(tick_bytes)
+            samples["Bytes per tick"].push_back(bytes - tick_bytes);
+        tick_bytes = bytes;
+    } break;
+    case ActionType::PING: {
+        if(!ping_time)
+            break;
+        samples["PONG -> PING"].push_back(now - ping_time);
+        samples["Server queue (bytes)"].push_back(client->bytes_received - ping_bytes);
+        ping_time = 0;
+    } break;
+    case ActionType::UNIT_MOVE: {
+        if(pending_targets.empty())
+            break;
+        Unit* unit;
+        float x, y;
+        size_t tx, ty;
+        ::deserialize(ar, &unit);
+        ::deserialize(ar, &x);
+        ::deserialize(ar, &y);
+        ::deserialize(ar, &tx);
+        ::deserialize(ar, &ty);
+        auto it = pending_targets.find(std::make_pair(unit, std::make_pair(tx, ty)));
+        if(it != pending_targets.end()) {
+            samples["UNIT_CHANGE_TARGET"].push_back(now - it->second);
+            pending_targets.erase(it);
+        }
+    } break;
+    case ActionType::UNIT_UPDATE: {
+        // The new target may come on a correction instead of a move
+        if(pending_targets.empty())
+            break;
+        Unit* unit;
+        Unit tmp = Unit();
+        ::deserialize(ar, &unit);
+        ::deserialize(ar, &tmp);
+        auto it = pending_targets.find(std::make_pair(unit, std::make_pair(tmp.tx, tmp.ty)));
+        if(it != pending_targets.end()) {
+            samples["UNIT_CHANGE_TARGET"].push_back(now - it->second);
+            pending_targets.erase(it);
+        }
+    } break;
+    case ActionType::NATION_DELTA: {
+        if(pending_policies.empty())
+            break;
+        Nation* delta_nation;
+        uint32_t mask;
+        ::deserialize(ar, &delta_nation);
+        ::deserialize(ar, &mask);
+        if(delta_nation != nation || !(mask & ((uint32_t)1 << policy_field)))
+            break;
+        for(const auto& time: pending_policies) {
+            samples["NATION_ENACT_POLICY"].push_back(now - time);
+        }
+        pending_policies.clear();
+    } break;
+    case ActionType::CHAT_MESSAGE: {
+        std::string msg;
+        ::deserialize(ar, &msg);
+        auto it = pending_messages.find(msg);
+        if(it != pending_messages.end()) {
+            samples["CHAT_MESSAGE"].push_back(now - it->second);
+            pending_messages.erase(it);
+        }
+    } break;
+    case ActionType::BUILDING_ADD: {
+        Building building = Building();
+        ::deserialize(ar, &building);
+        auto it = pending_buildings.find(std::make_pair(building.x, building.y));
+        if(building.owner == nation && it != pending_buildings.end()) {
+            samples["BUILDING_ADD"].push_back(now - it->second);
+            pending_buildings.erase(it);
+        }
+    } break;
+    default:
+        break;
+    }
+}
+
+// Moves one of our units somewhere near
+void Bot::change_unit_target(void) {
+    Archive ar = Archive();
+    {
+        std::lock_guard<std::recursive_mutex> lock(g_world->world_mutex);
+        std::vector<Unit*> our_units;
+        for(const auto& unit: g_world->units) {
+            if(unit->owner == nation)
+                our_units.push_back(unit);
+        }
+        if(our_units.empty())
+            return;
+
+        Unit* unit = our_units[std::rand() % our_units.size()];
+        const size_t tx = std::min<size_t>(g_world->width - 1, std::max<int>(0, (int)unit->x + std::rand() % 21 - 10));
+        const size_t ty = std::min<size_t>(g_world->height - 1, std::max<int>(0, (int)unit->y + std::rand() % 21 - 10));
+
+        ActionType action = ActionType::UNIT_CHANGE_TARGET;
+        ::serialize(ar, &action);
+        ::serialize(ar, &unit);
+        ::serialize(ar, &tx);
+        ::serialize(ar, &ty);
+
+        const std::lock_guard<std::mutex> pending_lock(pending_mutex);
+        pending_targets[std::make_pair(unit, std::make_pair(tx, ty))] = now_us();
+    }
+    send(ar);
+}
+
+// Changes the taxes of our nation
+void Bot::enact_policy(void) {
+    Archive ar = Archive();
+    {
+        std::lock_guard<std::recursive_mutex> lock(g_world->world_mutex);
+        Policies policy = nation->current_policy;
+        policy.import_tax = (std::rand() % 100) / 100.f;
+        policy.export_tax = (std::rand() % 100) / 100.f;
+
+        ActionType action = ActionType::NATION_ENACT_POLICY;
+        ::serialize(ar, &action);
+        ::serialize(ar, &policy);
+    }
+    {
+        const std::lock_guard<std::mutex> pending_lock(pending_mutex);
+        pending_policies.push_back(now_us());
+    }
+    send(ar);
+}
+
+void Bot::chat(void) {
+    Archive ar = Archive();
+    ActionType action = ActionType::CHAT_MESSAGE;
+    std::string msg = client->username + " says " + std::to_string(n_messages++);
+    ::serialize(ar, &action);
+    ::serialize(ar, &msg);
+    {
+        const std::lock_guard<std::mutex> pending_lock(pending_mutex);
+        pending_messages[msg] = now_us();
+    }
+    send(ar);
+}
+
+// Builds a barracks on our land, the server disconnects us if it's not
+void Bot::add_building(void) {
+    Archive ar = Archive();
+    {
+        std::lock_guard<std::recursive_mutex> lock(g_world->world_mutex);
+        if(nation->owned_provinces.empty() || g_world->building_types.empty())
+            return;
+
+        auto province_it = nation->owned_provinces.begin();
+        std::advance(province_it, std::rand() % nation->owned_provinces.size());
+        const Province* province = *province_it;
+
+        Building building = Building();
+        building.type = g_world->building_types[0];
+        building.owner = nation;
+        building.working_unit_type = nullptr;
+        building.working_boat_type = nullptr;
+        building.req_goods = building.type->req_goods;
+        for(size_t i = 0; ; i++) {
+            if(i == 16)
+                return;
+
+            building.x = province->min_x + std::rand() % (province->max_x - province->min_x + 1);
+            building.y = province->min_y + std::rand() % (province->max_y - province->min_y + 1);
+            if(building.x < g_world->width && building.y < g_world->height
+            && g_world->get_tile(building.x, building.y).owner_id == g_world->get_id(nation))
+                break;
+        }
+
+        ActionType action = ActionType::BUILDING_ADD;
+        ::serialize(ar, &action);
+        ::serialize(ar, &building);
+
+        const std::lock_guard<std::mutex> pending_lock(pending_mutex);
+        pending_buildings[std::make_pair(building.x, building.y)] = now_us();
+    }
+    send(ar);
+}
+
+// The server answers a PONG with a PING queued after everything it has for us
+void Bot::ping(void) {
+    Archive ar = Archive();
+    ActionType action = ActionType::PONG;
+    ::serialize(ar, &action);
+    {
+        const std::lock_guard<std::mutex> pending_lock(pending_mutex);
+        if(ping_time)
+            return;
+        ping_time = now_us();
+        ping_bytes = client->bytes_received;
+    }
+    send(ar);
+}
+
+void Bot::run(const LoadTestOptions& options, size_t id) {
+    new World();
+    const uint64_t connect_time = now_us();
+    client = new Client(options.host, options.port, "bot" + std::to_string(id));
+    {
+        std::lock_guard<std::recursive_mutex> lock(g_world->world_mutex);
+        client->on_action = [this](ActionType action, Archive& ar) {
+            on_action(action, ar);
+        };
+    }
+    client->wait_for_snapshot();
+    samples["Snapshot"].push_back(now_us() - connect_time);
+
+    // Take a nation that exists, each bot a different one if possible
+    {
+        std::lock_guard<std::recursive_mutex> lock(g_world->world_mutex);
+        std::vector<Nation*> nations;
+        for(const auto& candidate: g_world->nations) {
+            if(!candidate->owned_provinces.empty())
+                nations.push_back(candidate);
+        }
+        if(nations.empty())
+            throw ClientException("No nation to play with");
+        nation = nations[id % nations.size()];
+
+        size_t field = 0;
+        DeltaFields<Nation>::for_each(nation, [this, &field](const auto* value) {
+            if((const void*)value == (const void*)&nation->current_policy)
+                policy_field = field;
+            field++;
+        });
+
+        Archive ar = Archive();
+        ActionType action = ActionType::SELECT_NATION;
+        ::serialize(ar, &action);
+        ::serialize(ar, &nation);
+        send(ar);
+    }
+
+    const uint64_t end_time = now_us() + options.seconds * 1000000;
+    const uint64_t interval_us = 1000000 / std::max<size_t>(1, options.actions_per_second);
+    uint64_t next_ping = 0;
+    while(now_us() < end_time) {
+        std::this_thread::sleep_for(std::chrono::microseconds(interval_us));
+        if(now_us() >= next_ping) {
+            ping();
+            next_ping = now_us() + 1000000;
+        }
+
+        const int roll = std::rand() % 100;
+        if(roll < 50) {
+            change_unit_target();
+        } else if(roll < 70) {
+            chat();
+        } else if(roll < 90) {
+            enact_policy();
+        } else {
+            add_building();
+        }
+    }
+}
+
+static uint64_t get_percentile(const std::vector<uint64_t>& sorted_samples, float percentile) {
+    if(sorted_samples.empty())
+        return 0;
+    const size_t idx = std::min<size_t>(sorted_samples.size() - 1, (size_t)(percentile / 100.f * sorted_samples.size()));
+    return sorted_samples[idx];
+}
+
+static void print_samples(const std::string& name, std::vector<uint64_t> samples, float divisor) {
+    std::sort(samples.begin(), samples.end());
+    printf("%-32s %8zu %10.3f %10.3f %10.3f %10.3f\n",
+        name.c_str(),
+        samples.size(),
+        get_percentile(samples, 50.f) / divisor,
+        get_percentile(samples, 90.f) / divisor,
+        get_percentile(samples, 99.f) / divisor,
+        samples.empty() ? 0.f : samples.back() / divisor);
+}
+
+// Average of the samples between the given fractions of the vector
+static float get_average(const std::vector<uint64_t>& samples, float from, float to) {
+    const size_t start = samples.size() * from;
+    const size_t end = samples.size() * to;
+    if(start >= end)
+        return 0.f;
+
+    uint64_t total = 0;
+    for(size_t i = start; i < end; i++) {
+        total += samples[i];
+    }
+    return (float)total / (end - start);
+}
+
+#ifdef unix
+// Runs a bot on a child process, which writes it's samples ("name value" lines) on the pipe
+static pid_t spawn_bot(const LoadTestOptions& options, size_t id, int& result_fd) {
+    int pipe_fds[2];
+    if(pipe(pipe_fds) != 0)
+        return -1;
+
+    const pid_t pid = fork();
+    if(pid != 0) {
+        close(pipe_fds[1]);
+        result_fd = pipe_fds[0];
+        return pid;
+    }
+
+    close(pipe_fds[0]);
+    if(!options.verbose && freopen("/dev/null", "w", stdout) == nullptr)
+        _exit(EXIT_FAILURE);
+
+    std::srand(options.seed + id);
+    Bot bot = Bot();
+    try {
+        bot.run(options, id);
+    } catch(std::exception& e) {
+        print_error("Bot %zu: %s", id, e.what());
+    }
+
+    FILE* results = fdopen(pipe_fds[1], "w");
+    for(const auto& metric: bot.samples) {
+        for(const auto& sample: metric.second) {
+            fprintf(results, "%s\t%llu\n", metric.first.c_str(), (unsigned long long)sample);
+        }
+
+        // The samples are in order, so the growth of the queue can be seen
+        if(metric.first == "Server queue (bytes)") {
+            fprintf(results, "Queue start\t%llu\n", (unsigned long long)get_average(metric.second, 0.f, 0.25f));
+            fprintf(results, "Queue end\t%llu\n", (unsigned long long)get_average(metric.second, 0.75f, 1.f));
+        }
+    }
+    fclose(results);
+
+    // The network thread of the client never ends
+    _exit(EXIT_SUCCESS);
+}
+#endif
+
+int main(int argc, char** argv) {
+    LoadTestOptions options;
+    for(int i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "--host") && i + 1 < argc) {
+            options.host = argv[++i];
+        } else if(!strcmp(argv[i], "--port") && i + 1 < argc) {
+            options.port = std::strtoul(argv[++i], nullptr, 10);
+        } else if(!strcmp(argv[i], "--clients") && i + 1 < argc) {
+            options.n_clients = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+        } else if(!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+            options.seconds = std::strtoul(argv[++i], nullptr, 10);
+        } else if(!strcmp(argv[i], "--rate") && i + 1 < argc) {
+            options.actions_per_second = std::strtoul(argv[++i], nullptr, 10);
+        } else if(!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            options.seed = std::strtoul(argv[++i], nullptr, 10);
+        } else if(!strcmp(argv[i], "--verbose")) {
+            options.verbose = true;
+        } else {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+#ifdef unix
+    printf("Running %zu bots against %s:%u for %zu seconds\n", options.n_clients, options.host.c_str(), options.port, options.seconds);
+    fflush(stdout);
+
+    std::vector<pid_t> pids;
+    std::vector<int> result_fds;
+    for(size_t i = 0; i < options.n_clients; i++) {
+        int result_fd;
+        const pid_t pid = spawn_bot(options, i, result_fd);
+        if(pid < 0) {
+            print_error("Cannot start bot %zu", i);
+            continue;
+        }
+        pids.push_back(pid);
+        result_fds.push_back(result_fd);
+    }
+
+    // Bots that ended early (i.e they were disconnected) are the ones without samples
+    std::map<std::string, std::vector<uint64_t>> samples;
+    size_t n_finished = 0;
+    for(const auto& result_fd: result_fds) {
+        FILE* results = fdopen(result_fd, "r");
+        char line[256];
+        bool has_samples = false;
+        while(fgets(line, sizeof(line), results) != nullptr) {
+            char* separator = strchr(line, '\t');
+            if(separator == nullptr)
+                continue;
+            *separator = '\0';
+            samples[line].push_back(std::strtoull(separator + 1, nullptr, 10));
+            has_samples = true;
+        }
+        fclose(results);
+        n_finished += has_samples ? 1 : 0;
+    }
+    for(const auto& pid: pids) {
+        waitpid(pid, nullptr, 0);
+    }
+
+    printf("%zu of %zu bots reported\n", n_finished, options.n_clients);
+    printf("%-32s %8s %10s %10s %10s %10s\n", "Latency", "Samples", "p50 (ms)", "p90 (ms)", "p99 (ms)", "max (ms)");
+    for(const auto& name: { "Snapshot", "PONG -> PING", "UNIT_CHANGE_TARGET", "NATION_ENACT_POLICY", "CHAT_MESSAGE", "BUILDING_ADD" }) {
+        print_samples(name, samples[name], 1000.f);
+    }
+    printf("%-32s %8s %10s %10s %10s %10s\n", "Size", "Samples", "p50 (KB)", "p90 (KB)", "p99 (KB)", "max (KB)");
+    for(const auto& name: { "Bytes per tick", "Server queue (bytes)" }) {
+        print_samples(name, samples[name], 1000.f);
+    }
+    printf("Server queue growth: %.3f KB on the first quarter, %.3f KB on the last quarter (average of the bots)\n",
+        get_average(samples["Queue start"], 0.f, 1.f) / 1000.f,
+        get_average(samples["Queue end"], 0.f, 1.f) / 1000.f);
+    return 0;
+#else
+    print_error("The load test needs fork, which is not available on this platform");
+    return EXIT_FAILURE;
+#endif
+}
@@ -142,7 +142,7 @@ void Nation::give_province(World& world, Province& province) {
 
     for(size_t i = province.min_x; i < province.max_x; i++) {
         for(size_t j = province.min_y; j < province.max_y; j++) {
-            Tile& tile = world.get_tile(i, j);
+            Tile& tile = world.get_tile_unchecked(i, j);
             if(tile.province_id != province_id)
                 continue;
             
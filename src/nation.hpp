@@ -1,6 +1,7 @@
 #ifndef NATION_H
 #define NATION_H
 
+#include "entity.hpp"
 #include <cstdint>
 #include <queue>
 #include <deque>
@@ -50,10 +51,8 @@ public:
     Ideology* ideology;
 };
 
-class NationModifier {
+class NationModifier : public IdEntity<uint16_t> {
 public:
-    using Id = uint16_t;
-
     std::string ref_name;
     std::string name;
 
@@ -76,12 +75,10 @@ public:
     float luxury_needs_met_mod = 1.f;
 };
 
-class Nation {
+class Nation : public IdEntity<uint16_t> {
     inline void do_diplomacy();
     inline bool can_do_diplomacy();
 public:
-    using Id = uint16_t;
-
     bool is_ally(const Nation& nation);
     bool is_enemy(const Nation& nation);
     bool exists(void);
@@ -9,16 +9,20 @@
 #include <cstdio>
 #include <cstdlib>
 #include <mutex>
+#include <algorithm>
 /* Visual Studio does not know about UNISTD.H, Mingw does through */
 #ifndef _MSC_VER
 #	include <unistd.h>
 #endif
 
+#include <zlib.h>
+
 #include "network.hpp"
 #include "print.hpp"
 
 #ifdef unix
 #	include <poll.h>
+#	include <sys/uio.h>
 #elif defined windows
 /* MingW does not behave well with pollfd structures, however MSVC does */
 #	ifndef _MSC_VER
@@ -37,7 +41,7 @@ WINSOCK_API_LINKAGE int WSAAPI WSAPoll(LPWSAPOLLFD fdArray, ULONG fds, INT timeo
 void SocketStream::send(const void* data, size_t size) {
     const char* c_data = (const char*)data;
     for(size_t i = 0; i < size; ) {
-        int r = ::send(fd, &c_data[i], std::min<size_t>(1024, size - i), 0);
+        int r = ::send(fd, &c_data[i], size - i, 0);
         if(r <= 0)
             throw SocketException("Can't send data of packet");
         i += (size_t)r;
@@ -47,9 +51,189 @@ void SocketStream::send(const void* data, size_t size) {
 void SocketStream::recv(void* data, size_t size) {
     char* c_data = (char*)data;
     for(size_t i = 0; i < size; ) {
-        int r = ::recv(fd, &c_data[i], std::min<size_t>(1024, size - i), MSG_WAITALL);
+        int r = ::recv(fd, &c_data[i], size - i, MSG_WAITALL);
         if(r <= 0)
             throw SocketException("Can't receive data of packet");
         i += (size_t)r;
     }
 }
+
+// Maximum number of packets gathered on a single write, each one takes 3 buffers
+static constexpr size_t max_packets_per_write = 64;
+
+long SocketStream::send_packets(const Packet* const* packets, size_t n_packets, size_t offset) {
+    n_packets = std::min(n_packets, max_packets_per_write);
+
+    uint32_t headers[max_packets_per_write][2];
+    static const uint16_t eof_marker = htons(0xE0F);
+#ifdef unix
+    struct iovec bufs[max_packets_per_write * 3];
+#elif defined windows
+    WSABUF bufs[max_packets_per_write * 3];
+#endif
+    size_t n_bufs = 0;
+    const auto add_buf = [&bufs, &n_bufs, &offset](const void* data, size_t size) {
+        // Skip what was already sent
+        if(offset >= size) {
+            offset -= size;
+            return;
+        }
+#ifdef unix
+        bufs[n_bufs].iov_base = (uint8_t*)data + offset;
+        bufs[n_bufs].iov_len = size - offset;
+#elif defined windows
+        bufs[n_bufs].buf = (char*)data + offset;
+        bufs[n_bufs].len = (ULONG)(size - offset);
+#endif
+        offset = 0;
+        n_bufs++;
+    };
+
+    for(size_t i = 0; i < n_packets; i++) {
+        headers[i][0] = htonl(static_cast<uint32_t>(packets[i]->get_code()));
+        headers[i][1] = htonl(packets[i]->size());
+        add_buf(headers[i], packet_header_size);
+        if(packets[i]->size())
+            add_buf(packets[i]->buffer.data(), packets[i]->size());
+        add_buf(&eof_marker, packet_trailer_size);
+    }
+
+    if(!n_bufs)
+        return 0;
+
+#ifdef unix
+    struct msghdr msg = {};
+    msg.msg_iov = bufs;
+    msg.msg_iovlen = n_bufs;
+    return (long)sendmsg(fd, &msg, MSG_NOSIGNAL);
+#elif defined windows
+    DWORD sent = 0;
+    if(WSASend(fd, bufs, (DWORD)n_bufs, &sent, 0, NULL, NULL) == SOCKET_ERROR)
+        return -1;
+    return (long)sent;
+#endif
+}
+
+bool deflate_packet(const Packet& packet, Packet& out, int level) {
+    const uint32_t size = packet.size();
+    uLongf compressed_size = compressBound(size);
+    out.resize(sizeof(uint32_t) + compressed_size, PacketCode::DEFLATED);
+
+    const uint32_t net_size = htonl(size);
+    std::memcpy(out.buffer.data(), &net_size, sizeof(net_size));
+    if(compress2(out.buffer.data() + sizeof(uint32_t), &compressed_size, packet.buffer.data(), size, level) != Z_OK)
+        return false;
+    
+    if(sizeof(uint32_t) + compressed_size >= size)
+        return false;
+    out.resize(sizeof(uint32_t) + compressed_size, PacketCode::DEFLATED);
+    return true;
+}
+
+void inflate_packet(Packet& packet, size_t max_size) {
+    if(packet.size() < sizeof(uint32_t))
+        throw SocketException("Compressed packet without size");
+
+    uint32_t net_size;
+    std::memcpy(&net_size, packet.buffer.data(), sizeof(net_size));
+    const size_t size = (size_t)ntohl(net_size);
+    if(max_size && size > max_size)
+        throw SocketException("Compressed packet is too big");
+
+    std::vector<uint8_t> out(size);
+    uLongf out_size = size;
+    if(uncompress(out.data(), &out_size, packet.buffer.data() + sizeof(uint32_t), packet.size() - sizeof(uint32_t)) != Z_OK || out_size != size)
+        throw SocketException("Corrupted compressed packet");
+    
+    packet.buffer.swap(out);
+    packet.resize(size, PacketCode::OK);
+}
+
+// Copies size bytes, starting offset bytes after the head, out of the ring
+void PacketReader::peek(void* dest, size_t offset, size_t size) const {
+    const size_t start = (head + offset) % ring.size();
+    const size_t first_part = std::min(size, ring.size() - start);
+    std::memcpy(dest, &ring[start], first_part);
+    std::memcpy((uint8_t*)dest + first_part, &ring[0], size - first_part);
+}
+
+// Makes the ring big enough to hold size bytes, the ring is always a power of two
+void PacketReader::grow(size_t size) {
+    size_t new_size = ring.size();
+    while(new_size < size)
+        new_size *= 2;
+    if(new_size == ring.size())
+        return;
+    
+    std::vector<uint8_t> new_ring(new_size);
+    peek(new_ring.data(), 0, tail - head);
+    ring.swap(new_ring);
+    tail -= head;
+    head = 0;
+}
+
+int PacketReader::fill(int fd) {
+    if(tail - head == ring.size())
+        grow(ring.size() * 2);
+
+    // The free space of the ring may wrap around it's end
+    const size_t start = tail % ring.size();
+    const size_t free_size = ring.size() - (tail - head);
+    const size_t first_part = std::min(free_size, ring.size() - start);
+#ifdef unix
+    struct iovec bufs[2];
+    bufs[0].iov_base = &ring[start];
+    bufs[0].iov_len = first_part;
+    bufs[1].iov_base = &ring[0];
+    bufs[1].iov_len = free_size - first_part;
+    const int r = (int)readv(fd, bufs, (free_size > first_part) ? 2 : 1);
+#elif defined windows
+    const int r = ::recv(fd, (char*)&ring[start], (int)first_part, 0);
+#endif
+    if(r > 0)
+        tail += (size_t)r;
+    return r;
+}
+
+bool PacketReader::next(Packet& packet) {
+    if(tail - head < packet_header_size)
+        return false;
+    
+    uint32_t header[2];
+    peek(header, 0, sizeof(header));
+    const size_t size = (size_t)ntohl(header[1]);
+    if(max_packet_size && size > max_packet_size)
+        throw SocketException("Packet is too big");
+
+    // Make room for the whole packet so the next fills can complete it
+    const size_t total_size = packet_header_size + size + packet_trailer_size;
+    if(tail - head < total_size) {
+        grow(total_size);
+        return false;
+    }
+
+    uint16_t eof_marker;
+    peek(&eof_marker, packet_header_size + size, sizeof(eof_marker));
+    if(ntohs(eof_marker) != 0xE0F)
+        throw SocketException("Packet with invalid EOF");
+
+    packet.resize(size, static_cast<PacketCode>(ntohl(header[0])));
+    if(size)
+        peek(packet.buffer.data(), packet_header_size, size);
+    head += total_size;
+
+    if(packet.get_code() == PacketCode::DEFLATED)
+        inflate_packet(packet, max_packet_size);
+
+    // Keep the positions small when the ring is empty
+    if(head == tail) {
+        head = 0;
+        tail = 0;
+    }
+    return true;
+}
+
+void PacketReader::clear(void) {
+    head = 0;
+    tail = 0;
+}
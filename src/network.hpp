@@ -62,6 +62,7 @@ public:
     }
 };
 
+class Packet;
 class SocketStream {
     bool is_server_stream = false;
 public:
@@ -72,12 +73,30 @@ public:
 
     void send(const void* data, size_t size);
     void recv(void* data, size_t size);
+
+    // Sends the packets (each one with it's header and EOF marker) with a single vectored
+    // write, the first offset bytes are skipped since they were already sent. Returns how
+    // many bytes were written or -1 on error
+    long send_packets(const Packet* const* packets, size_t n_packets, size_t offset);
 };
 
+// Each packet is sent with a header (code and size) and followed by an EOF marker
+constexpr size_t packet_header_size = sizeof(uint32_t) + sizeof(uint32_t);
+constexpr size_t packet_trailer_size = sizeof(uint16_t);
+
 enum class PacketCode {
     OK,
     ERROR,
+    // The data is compressed with zlib, it starts with the size of the uncompressed data
+    DEFLATED,
+};
+
+// Features a client supports, told to the server when connecting
+enum NetworkFeature : uint32_t {
+    // Can receive DEFLATED packets
+    NET_FEATURE_DEFLATE = 1 << 0,
 };
+
 class Packet {
     size_t n_data = 0;
     PacketCode code = PacketCode::OK;
@@ -87,6 +106,10 @@ public:
 
     Packet() {};
     Packet(int _fd) { stream = SocketStream(_fd); };
+    Packet(const Packet&) = default;
+    Packet(Packet&&) = default;
+    Packet& operator=(const Packet&) = default;
+    Packet& operator=(Packet&&) = default;
     ~Packet() {};
 
     inline void* data(void) {
@@ -99,10 +122,21 @@ public:
         std::memcpy(&buffer[0], buf, size);
     }
 
-    inline size_t size(void) {
+    inline size_t size(void) const {
         return n_data;
     }
 
+    inline PacketCode get_code(void) const {
+        return code;
+    }
+
+    // Makes room for size bytes of data, so it can be written directly on the buffer
+    inline void resize(size_t size, PacketCode _code = PacketCode::OK) {
+        n_data = size;
+        code = _code;
+        buffer.resize(n_data);
+    }
+
     template<typename T>
     inline void send(const T* buf = nullptr, size_t size = sizeof(T)) {
         if(buf != nullptr) {
@@ -111,17 +145,15 @@ public:
             std::memcpy(&buffer[0], buf, n_data);
         }
 
-        const uint32_t net_code = htonl(static_cast<uint32_t>(code));
-        stream.send(&net_code, sizeof(net_code));
-        
-        const uint32_t net_size = htonl(n_data);
-        stream.send(&net_size, sizeof(net_size));
-        
-        // Socket writes can only be done 1024 bytes at a time
-        stream.send(&buffer[0], n_data);
-
-        const uint16_t eof_marker = htons(0xE0F);
-        stream.send(&eof_marker, sizeof(eof_marker));
+        // The header, data and EOF are gathered on a single write
+        const Packet* packet = this;
+        const size_t total_size = packet_header_size + n_data + packet_trailer_size;
+        for(size_t sent = 0; sent < total_size; ) {
+            const long r = stream.send_packets(&packet, 1, sent);
+            if(r <= 0)
+                throw SocketException("Can't send data of packet");
+            sent += (size_t)r;
+        }
     }
 
     inline void send(void) {
@@ -140,7 +172,6 @@ public:
         n_data = (size_t)ntohl(net_size);
         buffer.resize(n_data + 1);
         
-        // Reads can only be done 1024 bytes at a time
         stream.recv(&buffer[0], n_data);
         if(buf != nullptr)
             std::memcpy(buf, &buffer[0], n_data);
@@ -160,4 +191,41 @@ public:
     }
 };
 
+// Compresses the data of the packet onto out (a DEFLATED packet), returns false when
+// compressing does not make it smaller
+bool deflate_packet(const Packet& packet, Packet& out, int level);
+
+// Decompresses a DEFLATED packet in place, throws if the data is bigger than max_size
+// (when max_size is not 0) or it's corrupted
+void inflate_packet(Packet& packet, size_t max_size);
+
+// Buffers the bytes received from a socket on a ring, so packets are parsed out of a few
+// big reads instead of reading each part of each packet separately
+class PacketReader {
+    std::vector<uint8_t> ring;
+
+    // Positions (not wrapped around the ring) of the first byte that was not parsed and
+    // of the end of the received bytes
+    size_t head = 0;
+    size_t tail = 0;
+
+    // Packets bigger than this are rejected, 0 for no limit
+    size_t max_packet_size;
+
+    void peek(void* dest, size_t offset, size_t size) const;
+    void grow(size_t size);
+public:
+    PacketReader(size_t _max_packet_size = 0) : ring(65536), max_packet_size(_max_packet_size) {};
+
+    // Receives as much as fits on the ring with a single call, returns the same as recv
+    int fill(int fd);
+
+    // Takes the next packet out of the received bytes (decompressing it if needed), returns
+    // false if it has not been completely received yet
+    bool next(Packet& packet);
+
+    // Discards everything, for reusing the reader on another connection
+    void clear(void);
+};
+
 #endif
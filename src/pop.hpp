@@ -1,5 +1,6 @@
 #ifndef POP_H
 #define POP_H
+#include "entity.hpp"
 #include <vector>
 #include <string>
 
@@ -20,10 +21,8 @@ enum {
     POP_TYPE_AGED = 13,
 };
 
-class PopType {
+class PopType : public IdEntity<uint8_t> {
 public:
-    using Id = uint8_t;
-    
     std::string name;
     std::string ref_name;
     float average_budget;
@@ -1,5 +1,6 @@
 #ifndef PRODUCT_H
 #define PRODUCT_H
+#include "entity.hpp"
 #include <string>
 #include "company.hpp"
 #include "province.hpp"
@@ -8,10 +9,8 @@
 
 // A product (based off a Good) which can be bought by POPs, converted by factories and transported
 // accross the world
-class Product {
+class Product : public IdEntity<uint16_t> {
 public:
-    using Id = uint16_t;
-
     // Onwer (companyId) of this product
     Company* owner;
     
@@ -0,0 +1,180 @@
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include "profiler.hpp"
+#include "print.hpp"
+
+static const char* counter_names[] = {
+    "orders matched",
+    "packets broadcast",
+    "bytes broadcast",
+    "units evaluated",
+    "boats evaluated",
+};
+
+// Small, consecutive, IDs for the threads so traces are readable
+static std::atomic<size_t> next_thread_id(0);
+static thread_local size_t thread_id = next_thread_id++;
+
+Profiler::Profiler()
+    : enabled(false),
+    tracing(false),
+    keep_samples(false),
+    start_time(std::chrono::steady_clock::now())
+{
+    for(auto& counter: counters) {
+        counter = 0;
+    }
+}
+
+Profiler& Profiler::get_instance(void) {
+    static Profiler profiler;
+    return profiler;
+}
+
+void Profiler::enable(void) {
+    enabled = true;
+}
+
+void Profiler::disable(void) {
+    // A trace in progress keeps the profiler enabled until it's written
+    if(!tracing)
+        enabled = false;
+}
+
+void Profiler::set_keep_samples(bool keep) {
+    keep_samples = keep;
+}
+
+std::unordered_map<std::string, std::vector<uint64_t>> Profiler::get_samples(void) {
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    std::unordered_map<std::string, std::vector<uint64_t>> samples;
+    for(const auto& scope: stats) {
+        samples[scope.first] = scope.second.samples;
+    }
+    return samples;
+}
+
+uint64_t Profiler::now_us(void) const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+void Profiler::start_trace(size_t n_ticks, const std::string& path) {
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    trace_events.clear();
+    trace_path = path;
+    trace_ticks_left = std::max<size_t>(1, n_ticks);
+    if(!tracing)
+        enabled_before_trace = enabled;
+    tracing = true;
+    enabled = true;
+}
+
+void Profiler::add_sample(const char* name, uint64_t start_us, uint64_t end_us) {
+    const uint64_t duration_us = end_us - start_us;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        ScopeStats& scope = stats[name];
+        scope.calls++;
+        scope.total_us += duration_us;
+        scope.max_us = std::max(scope.max_us, duration_us);
+        if(keep_samples)
+            scope.samples.push_back(duration_us);
+    }
+
+    if(tracing) {
+        std::lock_guard<std::mutex> lock(trace_mutex);
+        trace_events.push_back(TraceEvent{ name, start_us, duration_us, thread_id });
+    }
+}
+
+void Profiler::tick_done(void) {
+    if(!is_enabled())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        n_ticks++;
+    }
+
+    if(tracing) {
+        std::lock_guard<std::mutex> lock(trace_mutex);
+        trace_ticks_left--;
+        if(!trace_ticks_left) {
+            write_trace();
+            tracing = false;
+            enabled = enabled_before_trace;
+        }
+    }
+}
+
+/**
+ * Writes the trace events in the chrome trace-event format, the trace_mutex must be held
+ */
+void Profiler::write_trace(void) {
+    std::ofstream file(trace_path);
+    if(!file.is_open()) {
+        print_error("Cannot open trace file %s", trace_path.c_str());
+        return;
+    }
+
+    file << "{\"traceEvents\":[";
+    for(size_t i = 0; i < trace_events.size(); i++) {
+        const TraceEvent& event = trace_events[i];
+        if(i)
+            file << ",";
+        file << "\n{\"name\":\"" << event.name << "\",\"cat\":\"tick\",\"ph\":\"X\""
+            << ",\"ts\":" << event.start_us
+            << ",\"dur\":" << event.duration_us
+            << ",\"pid\":1,\"tid\":" << event.thread_id << "}";
+    }
+
+    // The counters at the end of the trace
+    file << (trace_events.empty() ? "" : ",") << "\n{\"name\":\"counters\",\"ph\":\"C\",\"ts\":" << now_us() << ",\"pid\":1,\"args\":{";
+    for(size_t i = 0; i < (size_t)ProfileCounter::COUNT; i++) {
+        if(i)
+            file << ",";
+        file << "\"" << counter_names[i] << "\":" << counters[i].load();
+    }
+    file << "}}\n]}\n";
+
+    print_info("Wrote %zu trace events to %s", trace_events.size(), trace_path.c_str());
+    trace_events.clear();
+}
+
+std::string Profiler::get_stats(void) {
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    std::ostringstream out;
+
+    out << "Ticks: " << n_ticks << std::endl;
+
+    // Most expensive scopes first
+    std::vector<std::pair<std::string, ScopeStats>> sorted_stats(stats.begin(), stats.end());
+    std::sort(sorted_stats.begin(), sorted_stats.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.second.total_us > rhs.second.total_us;
+    });
+    for(const auto& scope: sorted_stats) {
+        out << scope.first
+            << ": calls=" << scope.second.calls
+            << " total=" << scope.second.total_us / 1000.f << "ms"
+            << " avg=" << (scope.second.total_us / (float)scope.second.calls) / 1000.f << "ms"
+            << " max=" << scope.second.max_us / 1000.f << "ms"
+            << std::endl;
+    }
+
+    for(size_t i = 0; i < (size_t)ProfileCounter::COUNT; i++) {
+        out << counter_names[i] << ": " << counters[i].load() << std::endl;
+    }
+    return out.str();
+}
+
+void Profiler::reset_stats(void) {
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    stats.clear();
+    n_ticks = 0;
+    for(auto& counter: counters) {
+        counter = 0;
+    }
+}
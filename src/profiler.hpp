@@ -0,0 +1,130 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <unordered_map>
+
+// Things that are counted by the profiler
+enum class ProfileCounter {
+    ORDERS_MATCHED,
+    PACKETS_BROADCAST,
+    BYTES_BROADCAST,
+    UNITS_EVALUATED,
+    BOATS_EVALUATED,
+    // Number of counters
+    COUNT,
+};
+
+/**
+ * Records how much time is spent on each (named) part of the code and keeps some counters,
+ * the results can be printed as statistics or written as a trace in the chrome trace-event
+ * format (which can be opened on chrome://tracing). When it's not enabled nothing is
+ * recorded, timers and counters just check an atomic flag
+ */
+class Profiler {
+    class ScopeStats {
+    public:
+        size_t calls = 0;
+        uint64_t total_us = 0;
+        uint64_t max_us = 0;
+
+        // Duration of each call, only kept when keep_samples is set
+        std::vector<uint64_t> samples;
+    };
+
+    class TraceEvent {
+    public:
+        std::string name;
+        uint64_t start_us;
+        uint64_t duration_us;
+        size_t thread_id;
+    };
+
+    std::atomic<bool> enabled;
+    std::atomic<bool> tracing;
+    std::atomic<bool> keep_samples;
+
+    // Whetever the profiler was enabled before the trace started
+    bool enabled_before_trace = false;
+
+    std::atomic<uint64_t> counters[(size_t)ProfileCounter::COUNT];
+
+    std::mutex stats_mutex;
+    std::unordered_map<std::string, ScopeStats> stats;
+    size_t n_ticks = 0;
+
+    std::mutex trace_mutex;
+    std::vector<TraceEvent> trace_events;
+    std::string trace_path;
+    size_t trace_ticks_left = 0;
+
+    std::chrono::steady_clock::time_point start_time;
+
+    void write_trace(void);
+public:
+    Profiler();
+    static Profiler& get_instance(void);
+
+    inline bool is_enabled(void) const {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    void enable(void);
+    void disable(void);
+
+    // Keeps the duration of every call of every scope, so percentiles can be obtained
+    void set_keep_samples(bool keep);
+    std::unordered_map<std::string, std::vector<uint64_t>> get_samples(void);
+
+    // Records trace events of the next n_ticks ticks and writes them to path afterwards
+    void start_trace(size_t n_ticks, const std::string& path);
+
+    inline void count(ProfileCounter counter, uint64_t n = 1) {
+        if(!is_enabled())
+            return;
+        counters[(size_t)counter].fetch_add(n, std::memory_order_relaxed);
+    }
+
+    // Microseconds since the profiler was created
+    uint64_t now_us(void) const;
+
+    // Called by timers when they are destroyed
+    void add_sample(const char* name, uint64_t start_us, uint64_t end_us);
+
+    // Called after each tick is done
+    void tick_done(void);
+
+    // Obtains a human readable text with the statistics collected since the last reset
+    std::string get_stats(void);
+    void reset_stats(void);
+};
+
+// Measures the time spent from it's creation to it's destruction
+class ProfileTimer {
+    const char* name;
+    uint64_t start_us;
+public:
+    ProfileTimer(const char* _name) : name(nullptr) {
+        Profiler& profiler = Profiler::get_instance();
+        if(!profiler.is_enabled())
+            return;
+
+        name = _name;
+        start_us = profiler.now_us();
+    };
+    ~ProfileTimer() {
+        if(name == nullptr)
+            return;
+
+        Profiler& profiler = Profiler::get_instance();
+        profiler.add_sample(name, start_us, profiler.now_us());
+    };
+};
+
+#endif
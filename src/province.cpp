@@ -6,12 +6,7 @@
 
 // Gets ID from pointer
 Province::Id Province::get_id(const World& world) {
-    const std::vector<Province *>* provinces = &world.provinces;
-    const auto province = std::find(provinces->begin(), provinces->end(), this);
-    if(province != provinces->end()) {
-        return (Province::Id)std::distance(provinces->begin(), province);
-    }
-    return (Province::Id)-1;
+    return world.get_id(this);
 }
 
 // Obtains the country that currently has a larger number of
@@ -20,7 +15,7 @@ Nation& Province::get_occupation_controller(const World& world) const {
     std::vector<Nation::Id> nations_cnt;
     for(size_t x = min_x; x < max_x; x++) {
         for(size_t y = min_y; y < max_y; y++) {
-            nations_cnt.push_back(world.get_tile(x, y).owner_id);
+            nations_cnt.push_back(world.get_tile_unchecked(x, y).owner_id);
         }
     }
 
@@ -1,5 +1,6 @@
 #ifndef PROVINCE_H
 #define PROVINCE_H
+#include "entity.hpp"
 #include <cstdint>
 #include <vector>
 #include <set>
@@ -12,10 +13,8 @@ class Industry;
 class Product;
 // A single province, which is used to simulate economy in a "bulk-tiles" way
 // instead of doing economical operations on every single tile
-class Province {
+class Province : public IdEntity<uint16_t> {
 public:
-    using Id = uint16_t;
-    
     Province::Id get_id(const World& world);
     Nation& get_occupation_controller(const World& world) const;
     size_t total_pops(void) const;
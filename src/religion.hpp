@@ -1,12 +1,11 @@
 #ifndef RELIGION_HPP
 #define RELIGION_HPP
+#include "entity.hpp"
 #include <string>
 
 typedef uint8_t ReligionId;
-class Religion {
+class Religion : public IdEntity<uint8_t> {
 public:
-    using Id = uint8_t;
-
     std::string name;
     std::string ref_name;
 };
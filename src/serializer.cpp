@@ -1,60 +1,52 @@
 #include "serializer.hpp"
 
-void Archive::copy_to(void* ptr, size_t size) {
-    if(size > buffer.size() - this->ptr)
-        throw SerializerException("Buffer too small for write");
-    
-    std::memcpy(ptr, &buffer[this->ptr], size);
-    this->ptr += size;
-}
-
-void Archive::copy_from(const void* ptr, size_t size) {
-    if(size > buffer.size() - this->ptr)
-        throw SerializerException("Buffer too small for read");
-    
-    std::memcpy(&buffer[this->ptr], ptr, size);
-    this->ptr += size;
-}
-
-// Expands the archive to fit a new serialized object
-void Archive::expand(size_t amount) {
-    buffer.resize(buffer.size() + amount);
-}
-
-// Call when serialization has ended and it's ready to be sent to a fstream
-void Archive::end_stream(void) {
-    buffer.shrink_to_fit();
-}
-
 void Archive::rewind(void) {
     ptr = 0;
 }
 
 void Archive::to_file(const std::string& path) {
     FILE* fp = fopen(path.c_str(), "wb");
-    fwrite(&buffer[0], 1, buffer.size(), fp);
-    fclose(fp);
+    if(fp == NULL)
+        throw SerializerException("Can't open " + path + " for writing");
+
+    const size_t written = fwrite(data(), 1, size(), fp);
+    if(fclose(fp) != 0 || written != size())
+        throw SerializerException("Can't write " + path);
 }
 
 #include <fstream>
-#include <iterator>
 #include <cstdint>
+// The file is read straight into the buffer, it's size is known beforehand so it's
+// allocated once
 void Archive::from_file(const std::string& path) {
-    std::ifstream ifs(path, std::ios::binary);
-    std::vector<uint8_t> tmpbuf(std::istreambuf_iterator<char>(ifs), {});
-    buffer = tmpbuf;
-    buffer.shrink_to_fit();
+    std::ifstream ifs(path, std::ios::binary | std::ios::ate);
+    if(!ifs)
+        throw SerializerException("Can't open " + path);
+
+    const std::streamoff file_size = ifs.tellg();
+    if(file_size < 0)
+        throw SerializerException("Can't read " + path);
+    ifs.seekg(0);
+
+    view = nullptr;
+    buffer.resize(file_size);
+    if(!ifs.read((char*)buffer.data(), file_size))
+        throw SerializerException("Can't read " + path);
 }
 
 void* Archive::get_buffer(void) {
+    own();
     return (void*)&buffer[0];
 }
     
 void Archive::set_buffer(void* buf, size_t size) {
+    view = nullptr;
     buffer.resize(size);
     std::memcpy(&buffer[0], buf, size);
 }
-    
-size_t Archive::size(void) {
-    return buffer.size();
+
+Archive& get_scratch_archive(void) {
+    thread_local Archive ar = Archive();
+    ar.clear();
+    return ar;
 }
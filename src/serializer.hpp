@@ -9,6 +9,9 @@
 #include <string>
 #include <vector>
 #include <cstdio>
+#include <algorithm>
+#include <tuple>
+#include <type_traits>
 
 // The purpouse of the serializer is to serialize objects onto a byte stream
 // that can be transfered onto the disk or over the network.
@@ -35,19 +38,107 @@ public:
 
     Archive() {};
     ~Archive() {};
-    
-    void copy_to(void* ptr, size_t size);
-    void copy_from(const void* ptr, size_t size);
-    void expand(size_t amount);
-    void end_stream(void);
+
+    // Reads from bytes owned by someone else (i.e the buffer of a received packet) instead
+    // of copying them onto the archive, they must outlive the archive and not change while
+    // it's being read. Writing onto the archive copies them first
+    inline void set_view(const void* data, size_t size) {
+        view = (const uint8_t*)data;
+        view_size = size;
+        buffer.clear();
+        ptr = 0;
+    }
+
+    // The bytes being read, the ones of the view or the buffer
+    inline const uint8_t* data(void) const {
+        return (view != nullptr) ? view : buffer.data();
+    }
+
+    inline size_t size(void) const {
+        return (view != nullptr) ? view_size : buffer.size();
+    }
+
+    // These are called for every field, so they are kept inline
+    inline void copy_to(void* dest, size_t size) {
+        if(size > this->size() - ptr)
+            throw SerializerException("Buffer too small for write");
+
+        std::memcpy(dest, data() + ptr, size);
+        ptr += size;
+    }
+
+    inline void copy_from(const void* src, size_t size) {
+        own();
+        if(size > buffer.size() - ptr)
+            throw SerializerException("Buffer too small for read");
+
+        std::memcpy(&buffer[ptr], src, size);
+        ptr += size;
+    }
+
+    // Expands the archive to fit a new serialized object, the capacity grows geometrically
+    // so serializing many small fields does few reallocations
+    inline void expand(size_t amount) {
+        own();
+        grow(buffer.size() + amount);
+        buffer.resize(buffer.size() + amount);
+    }
+
+    // Same as expand followed by copy_from, but the new bytes are not zero filled first
+    inline void write(const void* src, size_t size) {
+        own();
+        if(ptr != buffer.size()) {
+            expand(size);
+            copy_from(src, size);
+            return;
+        }
+
+        grow(buffer.size() + size);
+        buffer.insert(buffer.end(), (const uint8_t*)src, (const uint8_t*)src + size);
+        ptr += size;
+    }
+
+    // Makes room for size more bytes, use with the serialized_size of what is going to
+    // be written so the archive is allocated once
+    inline void reserve(size_t size) {
+        grow(buffer.size() + size);
+    }
+
+    // Empties the archive but keeps it's memory, for reusing it
+    inline void clear(void) {
+        view = nullptr;
+        buffer.clear();
+        ptr = 0;
+    }
+
     void rewind(void);
     void to_file(const std::string& path);
     void from_file(const std::string& path);
     void* get_buffer(void);
     void set_buffer(void* buf, size_t size);
-    size_t size(void);
+private:
+    const uint8_t* view = nullptr;
+    size_t view_size = 0;
+
+    // Copies the view onto the buffer, before writing
+    inline void own(void) {
+        if(view != nullptr) {
+            buffer.assign(view, view + view_size);
+            view = nullptr;
+        }
+    }
+
+    inline void grow(size_t size) {
+        if(size > buffer.capacity())
+            buffer.reserve(std::max(size, buffer.capacity() * 2));
+    }
 };
 
+// Archive of the calling thread, for serializing packets that are copied out right after
+// (i.e the updates broadcasted each tick) without allocating each time. It's cleared each
+// time it's taken, so it must not be taken again while in use
+Archive& get_scratch_archive(void);
+
 // A serializer (base class) which can be used to serialize objects
 // and create per-object optimized classes
 template<typename T>
@@ -64,21 +155,17 @@ public:
 template<>
 class Serializer<std::string> {
 public:
-    static inline void serialize(Archive& ar, const std::string* obj) {
-        uint16_t len = obj->length();
+    static constexpr size_t max_length = 1024;
 
+    static inline void serialize(Archive& ar, const std::string* obj) {
         // Truncate lenght
-        if(len >= 1024) {
-            len = 1024;
-        }
+        const uint16_t len = std::min(obj->length(), max_length);
 
         // Put length for later deserialization (since UTF-8/UTF-16 exists)
-        ar.expand(sizeof(len));
-        ar.copy_from(&len, sizeof(len));
+        ar.write(&len, sizeof(len));
 
         // Copy the string into the output
-        ar.expand(len);
-        ar.copy_from(obj->c_str(), len);
+        ar.write(obj->c_str(), len);
     }
     static inline void deserialize(Archive& ar, std::string* obj) {
         uint16_t len;
@@ -86,20 +173,17 @@ public:
         // Obtain the lenght of the string to be read
         ar.copy_to(&len, sizeof(len));
 
-        if(len >= 1024)
+        if(len > max_length)
             throw SerializerException("String is too lenghty");
 
-        // Obtain the string itself
-        char* string = new char[len + 1];
-        
-        ar.copy_to(string, len);
-        string[len] = '\0';
-        
-        *obj = string;
-        delete[] string;
+        // Obtain the string itself, directly from the bytes of the archive
+        if(len > ar.size() - ar.ptr)
+            throw SerializerException("Buffer too small for string");
+        obj->assign((const char*)ar.data() + ar.ptr, len);
+        ar.ptr += len;
     }
     static inline size_t size(const std::string* obj) {
-        return sizeof(uint32_t) + (obj->length() * sizeof(char));
+        return sizeof(uint16_t) + std::min(obj->length(), max_length);
     }
 };
 
@@ -110,8 +194,7 @@ template<typename T>
 class SerializerMemcpy {
 public:
     static inline void serialize(Archive& ar, const T* obj) {
-        ar.expand(size(obj));
-        ar.copy_from(obj, sizeof(T));
+        ar.write(obj, sizeof(T));
     }
     static inline void deserialize(Archive& ar, T* obj) {
         ar.copy_to(obj, sizeof(T));
@@ -150,6 +233,129 @@ class Serializer<float> : public SerializerMemcpy<float> {};
 template<>
 class Serializer<bool> : public SerializerMemcpy<bool> {};
 
+// Whetever the serialized form of T is just it's bytes in memory, so many of them can be
+// copied at once
+template<typename T>
+constexpr bool is_memcpy_serializable = std::is_base_of<SerializerMemcpy<T>, Serializer<T>>::value;
+
+// Lists the serialized fields of a type as pointers to members, in the order they are
+// serialized. Each type declares it's fields once and the serializer is generated from
+// the list (see SerializerReflected):
+//
+//     template<>
+//     class SerializerFields<Good> {
+//     public:
+//         static constexpr auto fields = std::make_tuple(&Good::name, &Good::ref_name, &Good::is_edible);
+//     };
+//     template<>
+//     class Serializer<Good> : public SerializerReflected<Good> {};
+template<typename T>
+class SerializerFields;
+
+// Type of a field given the pointer to the member
+template<typename P>
+class FieldType;
+template<typename M, typename C>
+class FieldType<M C::*> {
+public:
+    using type = M;
+};
+
+// What is known at compile time about a list of fields
+template<typename L>
+class FieldListInfo;
+template<typename... P>
+class FieldListInfo<std::tuple<P...>> {
+public:
+    // All the fields are copied as they are, so the object always has the same size
+    static constexpr bool is_fixed_size = (is_memcpy_serializable<typename FieldType<P>::type> && ...);
+    static constexpr size_t fixed_size = (sizeof(typename FieldType<P>::type) + ... + 0);
+};
+
+// Calls func with a pointer to each serialized field of obj, in order
+template<typename T, typename O, typename F>
+inline void for_each_field(O* obj, F func) {
+    std::apply([obj, &func](auto... fields) {
+        (func(&(obj->*fields)), ...);
+    }, SerializerFields<T>::fields);
+}
+
+// Serializer generated from the list of fields of the type. Consecutive fields that are
+// copied as they are and are next to each other in memory are copied with a single memcpy
+template<typename T>
+class SerializerReflected {
+    using Info = FieldListInfo<std::remove_cv_t<decltype(SerializerFields<T>::fields)>>;
+public:
+    static constexpr bool is_fixed_size = Info::is_fixed_size;
+    static constexpr size_t fixed_size = Info::fixed_size;
+
+    static inline void serialize(Archive& ar, const T* obj) {
+        const uint8_t* run = nullptr;
+        size_t run_size = 0;
+        const auto flush = [&ar, &run, &run_size]() {
+            if(run_size) {
+                ar.write(run, run_size);
+            }
+            run_size = 0;
+        };
+
+        for_each_field<T>(obj, [&](const auto* field) {
+            using F = std::remove_cv_t<std::remove_pointer_t<decltype(field)>>;
+            if constexpr(is_memcpy_serializable<F>) {
+                if(run_size && run + run_size == (const uint8_t*)field) {
+                    run_size += sizeof(F);
+                    return;
+                }
+                flush();
+                run = (const uint8_t*)field;
+                run_size = sizeof(F);
+            } else {
+                flush();
+                Serializer<F>::serialize(ar, field);
+            }
+        });
+        flush();
+    }
+    static inline void deserialize(Archive& ar, T* obj) {
+        uint8_t* run = nullptr;
+        size_t run_size = 0;
+        const auto flush = [&ar, &run, &run_size]() {
+            if(run_size)
+                ar.copy_to(run, run_size);
+            run_size = 0;
+        };
+
+        for_each_field<T>(obj, [&](auto* field) {
+            using F = std::remove_pointer_t<decltype(field)>;
+            if constexpr(is_memcpy_serializable<F>) {
+                if(run_size && run + run_size == (uint8_t*)field) {
+                    run_size += sizeof(F);
+                    return;
+                }
+                flush();
+                run = (uint8_t*)field;
+                run_size = sizeof(F);
+            } else {
+                flush();
+                Serializer<F>::deserialize(ar, field);
+            }
+        });
+        flush();
+    }
+    static inline size_t size(const T* obj) {
+        if constexpr(is_fixed_size) {
+            return fixed_size;
+        } else {
+            size_t total = 0;
+            for_each_field<T>(obj, [&total](const auto* field) {
+                using F = std::remove_cv_t<std::remove_pointer_t<decltype(field)>>;
+                total += Serializer<F>::size(field);
+            });
+            return total;
+        }
+    }
+};
+
 // TODO: Vector serializers do not like different endianess
 
 // Non-contigous serializer for STL containers
@@ -158,8 +364,7 @@ class SerializerContainer {
 public:
     static inline void serialize(Archive& ar, const C* obj_group) {
         uint32_t len = obj_group->size();
-        ar.expand(sizeof(len));
-        ar.copy_from(&len, sizeof(len));
+        ar.write(&len, sizeof(len));
 
         for(auto& obj: *obj_group) {
             Serializer<T>::serialize(ar, &obj);
@@ -175,8 +380,16 @@ public:
             obj_group->insert(obj);
         }
     }
-    static constexpr size_t size(const C* obj_group) {
-        return sizeof(uint32_t) + (obj_group->size()* sizeof(T));
+    static inline size_t size(const C* obj_group) {
+        if constexpr(is_memcpy_serializable<T>) {
+            return sizeof(uint32_t) + obj_group->size() * sizeof(T);
+        } else {
+            size_t total = sizeof(uint32_t);
+            for(const auto& obj: *obj_group) {
+                total += Serializer<T>::size(&obj);
+            }
+            return total;
+        }
     }
 };
 
@@ -192,8 +405,8 @@ public:
         Serializer<T>::deserialize(ar, &obj->first);
         Serializer<U>::deserialize(ar, &obj->second);
     }
-    static constexpr size_t size(const std::pair<T, U>* obj) {
-        return Serializer<T>::size(obj->first) + Serializer<T>::size(obj->second);
+    static inline size_t size(const std::pair<T, U>* obj) {
+        return Serializer<T>::size(&obj->first) + Serializer<U>::size(&obj->second);
     }
 };
 
@@ -202,10 +415,20 @@ public:
 template<typename T>
 class Serializer<std::vector<T>> : public SerializerContainer<T, std::vector<T>> {
 public:
+    // The elements are contiguous, so when they are copied as they are the whole
+    // vector is copied at once
+    static constexpr bool is_contiguous_memcpy = is_memcpy_serializable<T> && !std::is_same<T, bool>::value;
+
     static inline void serialize(Archive& ar, const std::vector<T>* obj_group) {
         uint32_t len = obj_group->size();
-        ar.expand(sizeof(len));
-        ar.copy_from(&len, sizeof(len));
+        if constexpr(is_contiguous_memcpy) {
+            ar.write(&len, sizeof(len));
+            if(len)
+                ar.write(obj_group->data(), len * sizeof(T));
+            return;
+        }
+
+        ar.write(&len, sizeof(len));
         for(auto& obj: *obj_group) {
             Serializer<T>::serialize(ar, &obj);
         }
@@ -214,6 +437,15 @@ public:
         uint32_t len;
         ar.copy_to(&len, sizeof(len));
         obj_group->clear();
+        if constexpr(is_contiguous_memcpy) {
+            if(len > (ar.size() - ar.ptr) / sizeof(T))
+                throw SerializerException("Buffer too small for vector");
+            obj_group->resize(len);
+            if(len)
+                ar.copy_to(obj_group->data(), len * sizeof(T));
+            return;
+        }
+
         for(size_t i = 0; i < len; i++) {
             T obj;
             Serializer<T>::deserialize(ar, &obj);
@@ -228,8 +460,7 @@ class Serializer<std::deque<T>> : public SerializerContainer<T, std::deque<T>> {
 public:
     static inline void serialize(Archive& ar, const std::deque<T>* obj_group) {
         uint32_t len = obj_group->size();
-        ar.expand(sizeof(len));
-        ar.copy_from(&len, sizeof(len));
+        ar.write(&len, sizeof(len));
 
         for(auto& obj: *obj_group) {
             Serializer<T>::serialize(ar, &obj);
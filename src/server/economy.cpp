@@ -9,6 +9,7 @@
 #include "../io_impl.hpp"
 #include "server_network.hpp"
 #include "../thread_pool.hpp"
+#include "../profiler.hpp"
 #include "../product.hpp"
 #include "../good.hpp"
 #include "../company.hpp"
@@ -51,6 +52,8 @@ bool Building::can_do_output(const World& world) {
 * Phase 1 of economy: Delivers & Orders are sent from all factories in the world
  */
 void Economy::do_phase_1(World& world) {
+    ProfileTimer timer("Economy::do_phase_1");
+
     // Buildings who have fullfilled requirements to build stuff will spawna  lil' unit/boat
     for(size_t j = 0; j < world.buildings.size(); j++) {
         auto& building = world.buildings.at(j);
@@ -169,7 +172,7 @@ void Economy::do_phase_1(World& world) {
             unit->base = unit->size;
             
             // Notify all clients of the server about this new unit
-            g_world->units.push_back(unit);
+            g_world->insert(unit);
             building->working_unit_type = nullptr;
 
             Packet packet = Packet();
@@ -198,7 +201,7 @@ void Economy::do_phase_1(World& world) {
             boat->base = boat->size;
 
             // Notify all clients of the server about this new boat
-            g_world->boats.push_back(boat);
+            g_world->insert(boat);
             building->working_boat_type = nullptr;
 
             Packet packet = Packet();
@@ -227,8 +230,8 @@ void Economy::do_phase_1(World& world) {
                 if(building->type->is_factory == true) {
                     building->delete_factory(world);
                 }
+                world.remove(building);
                 delete building;
-                world.buildings.erase(world.buildings.begin() + j);
 
                 --j;
                 continue;
@@ -367,7 +370,7 @@ void Economy::do_phase_1(World& world) {
         
         // Take opportunity to also send an update about our buildings
         Packet packet = Packet();
-        Archive ar = Archive();
+        Archive& ar = get_scratch_archive();
         ActionType action = ActionType::BUILDING_UPDATE;
         ::serialize(ar, &action); // ActionInt
         ::serialize(ar, &building); // BuildingRef
@@ -385,148 +388,215 @@ void Economy::do_phase_1(World& world) {
     });
 }
 
+// A trade between an order and a deliver, found by the order book of a good and applied
+// to the world afterwards
+class TradeMatch {
+public:
+    OrderGoods* order;
+    DeliverGoods* deliver;
+    size_t count;
+
+    float order_cost;
+    float deliver_cost;
+    float total_order_cost;
+    float total_deliver_cost;
+};
+
+// Orders and delivers of a single good, books of different goods do not share any
+// ticket so they are matched in parallel
+class OrderBook {
+public:
+    std::vector<OrderGoods*> orders;
+    std::vector<DeliverGoods*> delivers;
+
+    // Results of the matching, settled in order once all books are matched
+    std::vector<TradeMatch> matches;
+    std::vector<std::pair<Building*, float>> willing_payments;
+
+    void match(const World& world);
+};
+
+void OrderBook::match(const World& world) {
+    // Cheapest delivers are served first, orders were already sorted with the ones
+    // that pay the most first
+    std::stable_sort(delivers.begin(), delivers.end(), [](const DeliverGoods* lhs, const DeliverGoods* rhs) {
+        return lhs->product->price < rhs->product->price;
+    });
+
+    // Orders still wanting goods, as a linked list so fullfilled orders are unlinked
+    // without moving the rest - orders.size() is the end of the list
+    std::vector<size_t> next(orders.size() + 1);
+    for(size_t i = 0; i < orders.size(); i++) {
+        next[i] = i + 1;
+    }
+    next[orders.size()] = orders.size();
+    size_t head = 0;
+
+    for(auto& deliver: delivers) {
+        const Province* deliver_province = deliver->province;
+        if(deliver_province->owner == nullptr)
+            continue;
+        
+        const Province::Id deliver_province_id = world.get_id(deliver_province);
+        const Policies& deliver_policy = deliver_province->owner->current_policy;
+
+        size_t* prev = &head;
+        for(size_t j = head; j < orders.size() && deliver->quantity; j = next[j]) {
+            OrderGoods& order = *orders[j];
+            const Province* order_province = order.province;
+            if(order_province->owner == nullptr) {
+                prev = &next[j];
+                continue;
+            }
+
+            // Is there a transport company able to transport between both provinces?
+            if(!world.transport_network.is_connected(deliver_province_id, world.get_id(order_province))) {
+                prev = &next[j];
+                continue;
+            }
+
+            const Policies& order_policy = order_province->owner->current_policy;
+
+            // If foreign trade is not allowed, then order owner === sender owner
+            if(deliver_policy.foreign_trade == false
+            || order_policy.foreign_trade == false) {
+                // Trade not allowed
+                if(order_province->owner != deliver_province->owner) {
+                    prev = &next[j];
+                    continue;
+                }
+            }
+
+            TradeMatch trade;
+            trade.order = &order;
+            trade.deliver = deliver;
+            trade.count = std::min<size_t>(order.quantity, deliver->quantity);
+            trade.order_cost = deliver->product->price * trade.count;
+            trade.deliver_cost = deliver->product->price * trade.count;
+
+            // International trade
+            if(order_province->owner != deliver_province->owner) {
+                trade.total_order_cost = trade.order_cost * order_policy.import_tax;
+                trade.total_deliver_cost = trade.deliver_cost * order_policy.export_tax;
+            }
+            // Domestic trade
+            else {
+                trade.total_order_cost = trade.order_cost * order_policy.domestic_import_tax;
+                trade.total_deliver_cost = trade.deliver_cost * order_policy.domestic_export_tax;
+            }
+
+            // Orders payment should also cover the import tax and a deliver payment should also cover the export
+            // tax too. Otherwise we can't deliver
+            if(order.payment < trade.total_order_cost && trade.total_order_cost > 0.f) {
+                if(order.type == OrderType::INDUSTRIAL) {
+                    willing_payments.push_back(std::make_pair(order.building, trade.total_order_cost));
+                }
+                prev = &next[j];
+                continue;
+            } else if(deliver->payment < trade.total_deliver_cost && trade.total_deliver_cost > 0.f) {
+                willing_payments.push_back(std::make_pair(deliver->building, trade.total_deliver_cost));
+                prev = &next[j];
+                continue;
+            }
+
+            // Must have above minimum quality to be accepted
+            if(order.type == OrderType::INDUSTRIAL && deliver->product->quality < order.building->min_quality) {
+                prev = &next[j];
+                continue;
+            }
+
+            order.quantity -= trade.count;
+            deliver->quantity -= trade.count;
+            matches.push_back(trade);
+
+            // Fullfilled orders are not checked by the next delivers
+            if(!order.quantity) {
+                *prev = next[j];
+            } else {
+                prev = &next[j];
+            }
+        }
+    }
+}
+
 // Phase 2 of the economy: Goods are transported all around the world, generating commerce and making them
 // be ready for POPs to buy
 void Economy::do_phase_2(World& world) {
-    while(world.delivers.size() && world.orders.size()) {
-        // We will check all transport companies; they will transport in a first-come first-serve fashion
-        for(auto& company: world.companies) {
-            if(!company->is_transport)
-                continue;
-            
-            // Check all delivers
-            for(size_t i = 0; i < world.delivers.size(); i++) {
-                DeliverGoods& deliver = world.delivers.at(i);
+    ProfileTimer timer("Economy::do_phase_2");
 
-                // Is the transport company able to transport from this province?
-                if(!company->in_range(deliver.province))
-                    continue;
-                
-                const Province* deliver_province = deliver.province;
-                const Policies& deliver_policy = deliver_province->owner->current_policy;
-                Building* deliver_building = deliver.building;
+    // Put the orders and delivers on the book of their good, keeping the order they have
+    std::vector<OrderBook> books(world.goods.size());
+    for(auto& order: world.orders) {
+        const Good::Id good_id = world.get_id(order.good);
+        if(good_id == (Good::Id)-1)
+            continue;
+        books[good_id].orders.push_back(&order);
+    }
+    for(auto& deliver: world.delivers) {
+        const Good::Id good_id = world.get_id(deliver.good);
+        if(good_id == (Good::Id)-1)
+            continue;
+        books[good_id].delivers.push_back(&deliver);
+    }
 
-                // Check all orders
-                for(size_t j = 0; j < world.orders.size(); j++) {
-                    OrderGoods& order = world.orders.at(j);
-                    
-                    // Do they want these goods?
-                    if(order.good != deliver.good)
-                        continue;
-                    
-                    // Is this transport company able to transport to this province?
-                    if(!company->in_range(order.province))
-                        continue;
-                    
-                    Province* order_province = order.province;
-                    const Policies& order_policy = order_province->owner->current_policy;
-
-                    // If foreign trade is not allowed, then order owner === sender owner
-                    if(deliver_policy.foreign_trade == false
-                    || order_policy.foreign_trade == false) {
-                        // Trade not allowed
-                        if(order_province->owner != deliver_province->owner) {
-                            continue;
-                        }
-                    }
-                    
-                    const float order_cost = deliver.product->price * std::min(order.quantity, deliver.quantity);
-                    const float deliver_cost = deliver.product->price * std::min(order.quantity, deliver.quantity);
-                    
-                    float total_order_cost, total_deliver_cost;
-                    
-                    // International trade
-                    if(order.province->owner != deliver.province->owner) {
-                        total_order_cost = order_cost * order_policy.import_tax;
-                        total_deliver_cost = deliver_cost * order_policy.export_tax;
-                    }
-                    // Domestic trade
-                    else {
-                        total_order_cost = order_cost * order_policy.domestic_import_tax;
-                        total_deliver_cost = deliver_cost * order_policy.domestic_export_tax;
-                    }
-                    
-                    // Orders payment should also cover the import tax and a deliver payment should also cover the export
-                    // tax too. Otherwise we can't deliver
-                    if(order.payment < total_order_cost && total_order_cost > 0.f) {
-                        if(order.type == OrderType::INDUSTRIAL) {
-                            order.building->willing_payment = total_order_cost;
-                        }
-                        continue;
-                    } else if(deliver.payment < total_deliver_cost && total_deliver_cost > 0.f) {
-                        deliver.building->willing_payment = total_deliver_cost;
-                        continue;
-                    }
+    ThreadPool::get_instance().parallel_for(0, books.size(), [&books, &world](size_t good_id) {
+        OrderBook& book = books[good_id];
+        if(book.orders.empty() || book.delivers.empty())
+            return;
+        book.match(world);
+    });
 
-                    // Must have above minimum quality to be accepted
-                    if(order.type == OrderType::INDUSTRIAL && deliver.product->quality < order.building->min_quality) {
-                        continue;
-                    }
-                    
-                    // Give both goverments their part of the tax (when tax is 1.0< then the goverment pays for it)
-                    order_province->owner->budget += total_order_cost - order_cost;
-                    deliver_province->owner->budget += total_deliver_cost - deliver_cost;
-                    
-                    // Province receives a small (military) supply buff from commerce
-                    order_province->supply_rem += 5.f;
-                    order_province->supply_rem = std::min(order_province->supply_limit, order_province->supply_rem);
-                    
-                    // Obtain number of goods that we can satisfy
-                    size_t count = std::min<size_t>(order.quantity, deliver.quantity);
-                    // Add to stockpile (duplicate items) to the province at each transporting
-                    order.province->stockpile[world.get_id(deliver.product)] += count;
-                    deliver.quantity -= count;
-                    order.quantity -= count;
-                    
-                    // Increment demand of the product, and decrement supply when the demand is fullfilled
-                    deliver.product->demand += count;
-
-                    if(order.type == OrderType::INDUSTRIAL) {
-                        // Duplicate products and put them into the province's stock (a commerce buff)
-                        order.building->add_to_stock(world, order.good, count);
-
-                        // Increment the production cost of this building which is used
-                        // so we sell our product at a profit instead  of at a loss
-                        order.building->production_cost += deliver.product->price;
-
-                        // Set quality to the max from this product
-                        order.building->min_quality = std::max(order.building->min_quality, deliver.product->quality);
-                    } else if(order.type == OrderType::BUILDING) {
-                        // The building will take the production materials
-                        // and use them for building the unit
-                        order.building->owner->budget -= total_order_cost;
-                        for(auto& p: order.building->req_goods) {
-                            if(p.first != deliver.good)
-                                continue;
-                            p.second -= std::min(deliver.quantity, p.second);
-                        }
-                    } else if(order.type == OrderType::UNIT) {
-                        // TODO: We should deduct and set willing payment from military spendings
-                        order.building->owner->budget -= total_order_cost;
-                        for(auto& p: order.building->req_goods) {
-                            if(p.first != deliver.good)
-                                continue;
-                            p.second -= std::min(deliver.quantity, p.second);
-                        }
-                    }
+    // Settle the trades, book by book, in the order they were matched
+    for(const auto& book: books) {
+        Profiler::get_instance().count(ProfileCounter::ORDERS_MATCHED, book.matches.size());
+        for(const auto& p: book.willing_payments) {
+            p.first->willing_payment = p.second;
+        }
 
-                    deliver.product->supply += deliver.quantity;
-                    
-                    // Delete this deliver and order tickets from the system since
-                    // they are now fullfilled (only delete when no quanity left)
-                    if(!order.quantity) {
-                        world.orders.erase(world.orders.begin() + j);
-                    } if(!deliver.quantity) {
-                        world.delivers.erase(world.delivers.begin() + i);
-                        i--;
-                    }
-                    break;
+        for(const auto& trade: book.matches) {
+            OrderGoods& order = *trade.order;
+            DeliverGoods& deliver = *trade.deliver;
+            Province* order_province = order.province;
+            Province* deliver_province = deliver.province;
+
+            // Give both goverments their part of the tax (when tax is 1.0< then the goverment pays for it)
+            order_province->owner->budget += trade.total_order_cost - trade.order_cost;
+            deliver_province->owner->budget += trade.total_deliver_cost - trade.deliver_cost;
+            
+            // Province receives a small (military) supply buff from commerce
+            order_province->supply_rem += 5.f;
+            order_province->supply_rem = std::min(order_province->supply_limit, order_province->supply_rem);
+            
+            // Add to stockpile (duplicate items) to the province at each transporting
+            order_province->stockpile[world.get_id(deliver.product)] += trade.count;
+            
+            // Increment demand of the product, and decrement supply when the demand is fullfilled
+            deliver.product->demand += trade.count;
+
+            if(order.type == OrderType::INDUSTRIAL) {
+                // Duplicate products and put them into the province's stock (a commerce buff)
+                order.building->add_to_stock(world, order.good, trade.count);
+
+                // Increment the production cost of this building which is used
+                // so we sell our product at a profit instead  of at a loss
+                order.building->production_cost += deliver.product->price;
+
+                // Set quality to the max from this product
+                order.building->min_quality = std::max(order.building->min_quality, deliver.product->quality);
+            } else if(order.type == OrderType::BUILDING || order.type == OrderType::UNIT) {
+                // The building will take the production materials
+                // and use them for building the unit
+                // TODO: We should deduct and set willing payment from military spendings
+                order.building->owner->budget -= trade.total_order_cost;
+                for(auto& p: order.building->req_goods) {
+                    if(p.first != deliver.good)
+                        continue;
+                    p.second -= std::min(trade.count, p.second);
                 }
             }
-        }
 
-        // Industries who did not got anything will get desesperate
-        break;
+            deliver.product->supply += trade.count;
+        }
     }
 
     // The remaining delivers gets dropped and just simply add up the province's stockpile
@@ -572,18 +642,50 @@ public:
     size_t size;
 };
 
+// Small (splitmix64) random number generator, each province gets it's own stream
+// seeded from the world time and the province ID, this way the result of a phase does
+// not depend on how provinces are distributed across threads
+class EconomyRandom {
+    uint64_t state;
+public:
+    EconomyRandom(uint64_t seed, uint64_t stream) : state(seed * 0x9E3779B97F4A7C15ULL ^ (stream + 1) * 0xBF58476D1CE4E5B9ULL) {};
+
+    inline uint32_t operator()(void) {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return (uint32_t)((z ^ (z >> 31)) >> 33);
+    }
+};
+
+// Changes a province does to the shared state (products and nations) while it's being
+// processed in parallel, they are applied afterwards, in the order of the provinces
+class ProvinceEconomyResult {
+public:
+    // Demand added to each product
+    std::vector<std::pair<Product*, size_t>> demand;
+
+    // Tax money for the owner of the province
+    float owner_budget = 0.f;
+
+    std::vector<Emigrated> emigration;
+};
+
 // Phase 3 of economy: POPs buy the aforementioned products and take from the province's stockpile
 void Economy::do_phase_3(World& world) {
+    ProfileTimer timer("Economy::do_phase_3");
+
     // Now, it's like 1 am here, but i will try to write a very nice economic system
     // TODO: There is a lot to fix here, first the economy system commits inverse great depression and goes way too happy
-    std::vector<Emigrated> emigration = std::vector<Emigrated>();
-    std::mutex emigration_lock;
+    std::vector<ProvinceEconomyResult> results(world.provinces.size());
 
-    std::srand(std::time(nullptr));
-    std::for_each(world.provinces.begin(), world.provinces.end(), [&emigration_lock, &emigration, &world](auto& province) {
+    ThreadPool::get_instance().parallel_for(0, world.provinces.size(), [&results, &world](size_t province_id) {
+        Province* province = world.provinces[province_id];
         if(province->owner == nullptr)
             return;
         
+        ProvinceEconomyResult& result = results[province_id];
+        EconomyRandom rng(world.time, province_id);
         std::vector<Product *> province_products = province->get_products(world);
         
         float current_attractive = province->base_attractive;
@@ -604,11 +706,13 @@ void Economy::do_phase_3(World& world) {
             // TODO: Should sort "product" by priority (i.e with highest quality and best marketing)
             float everyday_alloc_budget = pop.budget / 10;
             for(const auto& product: province_products) {
+                const Product::Id product_id = world.get_id(product);
+
                 // Province must have stockpile
-                if(!province->stockpile[world.get_id(product)]) {
+                if(!province->stockpile[product_id]) {
                     // Desesperation for food leads to higher demand
                     if(product->good->is_edible && pop.life_needs_met <= 0.f) {
-                        product->demand += pop.size * 5.f;
+                        result.demand.push_back(std::make_pair(product, pop.size * 5.f));
                     }
                     continue;
                 }
@@ -626,7 +730,7 @@ void Economy::do_phase_3(World& world) {
                     }
                 }
                 
-                bought = std::min<float>(bought, province->stockpile[world.get_id(product)]);
+                bought = std::min<float>(bought, province->stockpile[product_id]);
                 if(!bought)
                     continue;
 
@@ -634,15 +738,15 @@ void Economy::do_phase_3(World& world) {
 
                 // Take in account taxes for the product
                 // TODO: Have something affect tax efficiency! - complexity at it's finest :)
-                province->owner->budget += (cost_of_transaction * province->owner->get_tax(pop)) - cost_of_transaction;
+                result.owner_budget += (cost_of_transaction * province->owner->get_tax(pop)) - cost_of_transaction;
                 cost_of_transaction *= province->owner->get_tax(pop);
                 pop.budget -= cost_of_transaction;
 
                 // Demand is incremented proportional to items bought and remove item from stockpile
                 // we will also add some "randomness" factor to simulate a pseudo-imperfect economy
-                float errdata = std::fmod((float)(std::rand() + 1) / 1000.f, 2.f) + 1.f;
-                product->demand += bought * 2.5f * errdata;
-                province->stockpile[world.get_id(product)] -= std::min<size_t>(province->stockpile[world.get_id(product)], bought);
+                float errdata = std::fmod((float)(rng() + 1) / 1000.f, 2.f) + 1.f;
+                result.demand.push_back(std::make_pair(product, bought * 2.5f * errdata));
+                province->stockpile[product_id] -= std::min<size_t>(province->stockpile[product_id], bought);
 
                 // Uncomment to see buyers
                 //print_info("Pop with budget %f bought %zu %s", pop.budget, (size_t)bought, product->good->name.c_str());
@@ -676,7 +780,7 @@ void Economy::do_phase_3(World& world) {
                 } else {
                     // Neither literacy nor anything else can save humans from
                     // dying due starvation
-                    growth = -((int)(std::rand() % pop.size));
+                    growth = -((int)(rng() % pop.size));
                 }
                 if(growth < 0 && (size_t)std::abs(growth) > pop.size) {
                     growth = -((int)pop.size);
@@ -685,7 +789,7 @@ void Economy::do_phase_3(World& world) {
             }
 
             // Add some RNG to shake things up and make gameplay more dynamic and less deterministic :)
-            pop.size += std::rand() % std::min<size_t>(5, std::max<size_t>(1, (pop.size / 10000)));
+            pop.size += rng() % std::min<size_t>(5, std::max<size_t>(1, (pop.size / 10000)));
 
             // Population cannot be 0
             pop.size = std::max<size_t>(1, pop.size);
@@ -706,7 +810,7 @@ void Economy::do_phase_3(World& world) {
             // And literacy determines "best" spot, for example a low literacy will
             // choose a slightly less desirable location
             const float emigration_willing = 1.f / std::min(pop.life_needs_met, 0.f);
-            long long int emigreers = (pop.size * emigration_willing) + std::rand() % pop.size;
+            long long int emigreers = (pop.size * emigration_willing) + rng() % pop.size;
             if(emigreers > 0) {
                 // Check that laws on the province we are in allows for emigration
                 if(province->owner->current_policy.migration == ALLOW_NOBODY) {
@@ -724,7 +828,7 @@ void Economy::do_phase_3(World& world) {
 
                 // Find best province
                 Province* best_province = nullptr;
-                for(size_t j = 0; j < world.provinces.size(); j += std::max<size_t>((std::rand() % (world.provinces.size() - j)) / 10, 1)) {
+                for(size_t j = 0; j < world.provinces.size(); j += std::max<size_t>((rng() % (world.provinces.size() - j)) / 10, 1)) {
                     Province* target_province = world.provinces.at(j);
                     float attractive = 0.f;
                     
@@ -796,7 +900,7 @@ void Economy::do_phase_3(World& world) {
                 // If best not found then we don't go to anywhere
                 if(best_province == nullptr) {
                     // Or we do, but just randomly
-                    best_province = world.provinces[std::rand() % world.provinces.size()];
+                    best_province = world.provinces[rng() % world.provinces.size()];
                     //goto skip_emigration;
                 }
                 
@@ -807,10 +911,7 @@ void Economy::do_phase_3(World& world) {
                 emigrated.emigred = pop;
                 emigrated.size = emigreers;
                 emigrated.origin = province;
-                
-                emigration_lock.lock();
-                emigration.push_back(emigrated);
-                emigration_lock.unlock();
+                result.emigration.push_back(emigrated);
             }
         skip_emigration:
             ;
@@ -819,6 +920,21 @@ void Economy::do_phase_3(World& world) {
         std::fill(province->stockpile.begin(), province->stockpile.end(), 0);
     });
 
+    // Apply what the provinces did to the products and nations, always in the order of
+    // the provinces so the outcome is the same regardless of the number of threads
+    std::vector<Emigrated> emigration = std::vector<Emigrated>();
+    for(size_t i = 0; i < results.size(); i++) {
+        ProvinceEconomyResult& result = results[i];
+        if(world.provinces[i]->owner != nullptr) {
+            world.provinces[i]->owner->budget += result.owner_budget;
+        }
+
+        for(const auto& demand: result.demand) {
+            demand.first->demand += demand.second;
+        }
+        emigration.insert(emigration.end(), result.emigration.begin(), result.emigration.end());
+    }
+
     // Now time to do the emigration - we will create a new POP on the province
     // if a POP with similar culture, religion and type does not exist - and we
     // will also subtract the amount of emigrated from the original POP to not
@@ -830,8 +946,7 @@ void Economy::do_phase_3(World& world) {
         auto new_pop = std::find(target.target->pops.begin(), target.target->pops.end(), *pop);
         if(new_pop == target.target->pops.end()) {
             target.target->pops.push_back(*pop);
-            new_pop = target.target->pops.end();
-            new_pop->size = target.size;
+            target.target->pops.back().size = target.size;
         } else {
             new_pop->size += target.size;
         }
@@ -843,6 +958,7 @@ void Economy::do_phase_3(World& world) {
 
     // We will now post a job request so the next economic tick will be able to "link buildings"
     // with their workers and make a somewhat realistic economy
+    EconomyRandom rng(world.time, world.provinces.size());
     world.job_requests.clear();
     for(const auto& province: world.provinces) {
         // Province must have an owner
@@ -865,7 +981,7 @@ void Economy::do_phase_3(World& world) {
             } else if(province->owner->current_policy.treatment == TREATMENT_ONLY_ACCEPTED) {
                 // Same as above except we roll a dice
                 if(province->owner->is_accepted_culture(pop) == false) {
-                    request.amount /= (size_t)std::fmod(std::rand() + 1.f, 32.f) + 1;
+                    request.amount /= (size_t)std::fmod(rng() + 1.f, 32.f) + 1;
                 }
             }
 
@@ -879,6 +995,8 @@ void Economy::do_phase_3(World& world) {
 * the price of each product is calculated and all markets are closed until the next day
  */
 void Economy::do_phase_4(World& world) {
+    ProfileTimer timer("Economy::do_phase_4");
+
     // Preparations for the next tick
 
     // Reset production costs
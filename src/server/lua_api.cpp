@@ -26,6 +26,7 @@ extern "C" {
 #include "economy.hpp"
 #include "../print.hpp"
 #include "../path.hpp"
+#include "../profiler.hpp"
 #include "../event.hpp"
 #include "../building.hpp"
 
@@ -54,7 +55,7 @@ int LuaAPI::add_invention(lua_State* L) {
     invention->name = luaL_checkstring(L, 2);
     invention->description = luaL_checkstring(L, 3);
 
-    g_world->inventions.push_back(invention);
+    g_world->insert(invention);
     lua_pushnumber(L, g_world->inventions.size() - 1);
     return 1;
 }
@@ -77,7 +78,7 @@ int LuaAPI::add_technology(lua_State* L) {
     technology->cost = lua_tonumber(L, 4);
     technology->type = (TechnologyType)((int)lua_tonumber(L, 5));
 
-    g_world->technologies.push_back(technology);
+    g_world->insert(technology);
     lua_pushnumber(L, g_world->technologies.size() - 1);
     return 1;
 }
@@ -109,7 +110,7 @@ int LuaAPI::add_unit_trait(lua_State* L) {
     unit_trait->defense_mod = lua_tonumber(L, 5);
     unit_trait->attack_mod = lua_tonumber(L, 6);
 
-    g_world->unit_traits.push_back(unit_trait);
+    g_world->insert(unit_trait);
     lua_pushnumber(L, g_world->unit_traits.size() - 1);
     return 1;
 }
@@ -123,7 +124,7 @@ int LuaAPI::add_building_type(lua_State* L) {
     building_type->is_build_naval_units = lua_toboolean(L, 4);
     building_type->defense_bonus = lua_tonumber(L, 5);
 
-    g_world->building_types.push_back(building_type);
+    g_world->insert(building_type);
     lua_pushnumber(L, g_world->building_types.size() - 1);
     return 1;
 }
@@ -135,7 +136,7 @@ int LuaAPI::add_good(lua_State* L) {
     good->name = luaL_checkstring(L, 2);
     good->is_edible = lua_toboolean(L, 3);
 
-    g_world->goods.push_back(good);
+    g_world->insert(good);
     lua_pushnumber(L, g_world->goods.size() - 1);
     return 1;
 }
@@ -161,7 +162,7 @@ int LuaAPI::add_industry_type(lua_State* L) {
     industry_type->inputs.clear();
     industry_type->outputs.clear();
 
-    g_world->building_types.push_back(industry_type);
+    g_world->insert(industry_type);
     lua_pushnumber(L, g_world->get_id(industry_type));
     return 1;
 }
@@ -208,7 +209,7 @@ int LuaAPI::add_nation(lua_State* L) {
         }
     }
     
-    g_world->nations.push_back(nation);
+    g_world->insert(nation);
     lua_pushnumber(L, g_world->get_id(nation));
     return 1;
 }
@@ -398,7 +399,7 @@ int LuaAPI::add_province(lua_State* L) {
         }
     }
 
-    g_world->provinces.push_back(province);
+    g_world->insert(province);
     lua_pushnumber(L, g_world->get_id(province));
     return 1;
 }
@@ -424,7 +425,7 @@ int LuaAPI::add_province_industry(lua_State* L) {
     Province *& province = g_world->provinces.at(lua_tonumber(L, 1));
     Building* building = new Building();
     building->corporate_owner = g_world->companies.at(lua_tonumber(L, 2));
-    building->corporate_owner->operating_provinces.insert(province);
+    building->corporate_owner->operate_on(*g_world, province);
     building->type = g_world->building_types.at(lua_tonumber(L, 3));
     
     //province->add_industry(*g_world, &industry);
@@ -601,15 +602,15 @@ int LuaAPI::add_company(lua_State* L) {
     company->operating_provinces.clear();
 
     // Add onto vector
-    g_world->companies.push_back(company);
+    g_world->insert(company);
     lua_pushnumber(L, g_world->get_id(company));
     return 1;
 }
 
 int LuaAPI::add_op_province_to_company(lua_State* L) {
     Company* company = g_world->companies.at(lua_tonumber(L, 1));
-    //std::string ref_name = luaL_checkstring(L, 2);
-    //company->operating_provinces.insert(province);
+    Province* province = g_world->provinces.at(lua_tonumber(L, 2));
+    company->operate_on(*g_world, province);
     return 0;
 }
 
@@ -623,7 +624,7 @@ int LuaAPI::add_event(lua_State* L) {
     event->text = luaL_checkstring(L, 5);
 
     // Add onto vector
-    g_world->events.push_back(event);
+    g_world->insert(event);
     lua_pushnumber(L, g_world->events.size() - 1);
     return 1;
 }
@@ -668,7 +669,7 @@ int LuaAPI::add_pop_type(lua_State* L) {
     pop->name = luaL_checkstring(L, 2);
     
     // Add onto vector
-    g_world->pop_types.push_back(pop);
+    g_world->insert(pop);
     lua_pushnumber(L, g_world->pop_types.size() - 1);
     return 1;
 }
@@ -687,7 +688,7 @@ int LuaAPI::add_culture(lua_State* L) {
     culture->ref_name = luaL_checkstring(L, 1);
     culture->name = luaL_checkstring(L, 2);
 
-    g_world->cultures.push_back(culture);
+    g_world->insert(culture);
     lua_pushnumber(L, g_world->cultures.size() - 1);
     return 1;
 }
@@ -706,7 +707,7 @@ int LuaAPI::add_religion(lua_State* L) {
     religion->ref_name = luaL_checkstring(L, 1);
     religion->name = luaL_checkstring(L, 2);
 
-    g_world->religions.push_back(religion);
+    g_world->insert(religion);
     lua_pushnumber(L, g_world->religions.size() - 1);
     return 1;
 }
@@ -731,7 +732,7 @@ int LuaAPI::add_unit_type(lua_State* L) {
     unit_type->max_defensive_ticks = lua_tonumber(L, 6);
     unit_type->position_defense = lua_tonumber(L, 7);
 
-    g_world->unit_types.push_back(unit_type);
+    g_world->insert(unit_type);
     lua_pushnumber(L, g_world->unit_types.size() - 1);
     return 1;
 }
@@ -768,7 +769,7 @@ int LuaAPI::add_boat_type(lua_State* L) {
     boat_type->max_health = lua_tonumber(L, 5);
     boat_type->capacity = lua_tonumber(L, 6);
 
-    g_world->boat_types.push_back(boat_type);
+    g_world->insert(boat_type);
     lua_pushnumber(L, g_world->boat_types.size() - 1);
     return 1;
 }
@@ -792,7 +793,7 @@ int LuaAPI::add_ideology(lua_State* L) {
     ideology->name = luaL_checkstring(L, 2);
     ideology->check_policies_fn = lua_tostring(L, 3);
 
-    g_world->ideologies.push_back(ideology);
+    g_world->insert(ideology);
     lua_pushnumber(L, g_world->ideologies.size() - 1);
     return 1;
 }
@@ -836,6 +837,8 @@ int LuaAPI::get_year(lua_State* L) {
 
 // Checks all events and their condition functions
 void LuaAPI::check_events(lua_State* L) {
+    ProfileTimer timer("LuaAPI::check_events");
+
     // Because of the logic of this loop, only 1 event can happen in the world per tick
     // This is on purpouse ;)
     for(size_t i = 0; i < g_world->events.size(); i++) {
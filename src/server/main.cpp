@@ -22,20 +22,24 @@ std::atomic<bool> run;
 #endif
 #include "../path.hpp"
 #include "server_network.hpp"
+#include "../profiler.hpp"
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 
 #include "../io_impl.hpp"
 
 #include "../actions.hpp"
+#include "save_game.hpp"
 std::mutex world_lock;
 
 std::string async_get_input(void) {
     std::cout << "server> ";
 
+    // The whole line is read, since commands may have arguments
     std::string cmd;
-    std::cin >> cmd;
+    std::getline(std::cin, cmd);
     return cmd;
 }
 
@@ -78,13 +82,22 @@ int main(int argc, char** argv) {
 
     bool paused = true;
     while(run) {
+        // Actions of the clients are handled between ticks
+        server->process_actions();
+
         if(!paused) {
             std::unique_lock<std::mutex> lock(world_lock);
             world->do_tick();
+            Profiler::get_instance().tick_done();
         }
 
         if(future.wait_for(std::chrono::milliseconds(10)) == std::future_status::ready) {
-            std::string r = future.get();
+            std::string line = future.get();
+
+            // Split the command from it's arguments
+            std::istringstream line_stream(line);
+            std::string r;
+            line_stream >> r;
 
             if(r == "help" || r == "info") {
                 std::cout << "start: Start the simulation" << std::endl;
@@ -95,6 +108,11 @@ int main(int argc, char** argv) {
                 std::cout << "lsc: List all clients" << std::endl;
                 std::cout << "debugen: Enable debug" << std::endl;
                 std::cout << "debugdis: Disable debug" << std::endl;
+                std::cout << "stats [on|off|reset]: Show the profiler statistics, or enable/disable/reset the profiler" << std::endl;
+                std::cout << "trace <ticks> [file]: Write a chrome trace of the next ticks (trace.json by default)" << std::endl;
+                std::cout << "save [file]: Save the game (into save.soe by default)" << std::endl;
+                std::cout << "load [file]: Load a saved game (from save.soe by default), players have to join again" << std::endl;
+                std::cout << "savecheck [file]: Save the game, load it back and check that saving it again gives the same file" << std::endl;
             }
             else if(r == "debugen") {
                 print_enable_debug();
@@ -102,6 +120,61 @@ int main(int argc, char** argv) {
             else if(r == "debugdis") {
                 print_disable_debug();
             }
+            else if(r == "stats") {
+                std::string arg;
+                line_stream >> arg;
+                if(arg == "on") {
+                    Profiler::get_instance().enable();
+                } else if(arg == "off") {
+                    Profiler::get_instance().disable();
+                } else if(arg == "reset") {
+                    Profiler::get_instance().reset_stats();
+                } else {
+                    if(!Profiler::get_instance().is_enabled()) {
+                        std::cout << "The profiler is disabled, use stats on to enable it" << std::endl;
+                    }
+                    std::cout << Profiler::get_instance().get_stats();
+                }
+            }
+            else if(r == "trace") {
+                size_t n_ticks = 0;
+                std::string path = "trace.json";
+                line_stream >> n_ticks >> path;
+                if(!n_ticks) {
+                    std::cout << "Usage: trace <ticks> [file]" << std::endl;
+                } else {
+                    Profiler::get_instance().start_trace(n_ticks, path);
+                    std::cout << "Tracing " << n_ticks << " ticks into " << path << std::endl;
+                }
+            }
+            else if(r == "save" || r == "load" || r == "savecheck") {
+                std::string path = "save.soe";
+                line_stream >> path;
+
+                std::unique_lock<std::mutex> lock(world_lock);
+                const auto start = std::chrono::steady_clock::now();
+                try {
+                    if(r == "save") {
+                        SaveGame::save(*world, path);
+                    } else if(r == "load") {
+                        SaveGame::load(*world, path);
+                        server->disconnect_clients();
+                    } else {
+                        // The game is loaded back even if the check fails
+                        try {
+                            SaveGame::check(*world, path);
+                        } catch(SaveGameException& e) {
+                            server->disconnect_clients();
+                            throw;
+                        }
+                        server->disconnect_clients();
+                    }
+                    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                    std::cout << (r == "save" ? "Saved " : (r == "load" ? "Loaded " : "Checked ")) << path << " in " << elapsed.count() << " seconds" << std::endl;
+                } catch(std::exception& e) {
+                    print_error("%s", e.what());
+                }
+            }
             else if(r == "lsc") {
                 for(size_t i = 0; i < server->n_clients; i++) {
                     ServerClient& cl = server->clients[i];
@@ -186,8 +259,8 @@ int main(int argc, char** argv) {
                 std::cout << gettext("Quitting...") << std::endl;
                 run = false;
                 break;
-            } else {
-                int ret = luaL_loadstring(world->lua, r.c_str());
+            } else if(!r.empty()) {
+                int ret = luaL_loadstring(world->lua, line.c_str());
                 if (ret == 0) {
                     lua_pcall(world->lua, 0, 0, 0);
                 } else {
@@ -0,0 +1,798 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <zlib.h>
+
+#ifdef unix
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "save_game.hpp"
+#include "../world.hpp"
+#include "../io_impl.hpp"
+#include "../thread_pool.hpp"
+#include "../tile_codec.hpp"
+#include "../print.hpp"
+
+// Lists of the world that are saved, the objects of all of them are created (in this
+// order) before any section is loaded so the references between sections can be
+// resolved right away
+static constexpr auto world_lists = std::make_tuple(
+    &World::goods,
+    &World::unit_types,
+    &World::boat_types,
+    &World::religions,
+    &World::cultures,
+    &World::pop_types,
+    &World::unit_traits,
+    &World::building_types,
+    &World::ideologies,
+    &World::inventions,
+    &World::technologies,
+    &World::nation_modifiers,
+    &World::events,
+    &World::nations,
+    &World::provinces,
+    &World::companies,
+    &World::products,
+    &World::buildings,
+    &World::units,
+    &World::boats,
+    &World::treaties
+);
+static constexpr size_t n_world_lists = std::tuple_size<std::remove_cv_t<decltype(world_lists)>>::value;
+
+// Lists whose sections are split in chunks
+static constexpr size_t nations_list = 13;
+static constexpr size_t provinces_list = 14;
+static_assert(std::get<nations_list>(world_lists) == &World::nations);
+static_assert(std::get<provinces_list>(world_lists) == &World::provinces);
+
+// TODO: Endianess compatibility
+class Header {
+public:
+    char magic[8];
+    uint32_t version;
+    uint32_t n_sections;
+    uint64_t width;
+    uint64_t height;
+    uint64_t sea_level;
+    uint64_t time;
+
+    // Number of objects of each of the world_lists
+    uint64_t n_elems[n_world_lists];
+};
+static constexpr char save_magic[8] = { 'S', 'O', 'E', 'S', 'A', 'V', 'E', '\0' };
+
+enum class SectionId : uint32_t {
+    // Rows of tiles, encoded with TileCodec
+    TILES,
+    // Goods, types of units, boats and buildings, religions, cultures, ideologies,
+    // inventions, technologies, modifiers and events
+    DEFINITIONS,
+    NATIONS,
+    // Provinces without their pops
+    PROVINCES,
+    // The pops of a range of provinces
+    POPS,
+    // Companies, products, buildings and the orders and delivers of goods
+    ECONOMY,
+    // Units and boats
+    MILITARY,
+    // Treaties
+    DIPLOMACY,
+    COUNT,
+};
+
+class Section {
+public:
+    SectionId id;
+    uint32_t checksum;
+
+    // Range of the elements (rows of tiles, nations or provinces) the section has, the
+    // sections that are not split have all of them
+    uint64_t first;
+    uint64_t count;
+
+    // Where the data of the section is on the file
+    uint64_t offset;
+    uint64_t size;
+};
+
+// Number of elements of each chunk of the sections that are split
+static constexpr size_t tile_rows_per_section = 128;
+static constexpr size_t nations_per_section = 64;
+static constexpr size_t provinces_per_section = 256;
+
+// State that only the server needs (clients do not receive it on the snapshot) but that
+// must survive a save, it's saved after the serialized fields of the type
+template<typename T>
+class SaveFields {
+public:
+    static constexpr auto fields = std::make_tuple();
+};
+
+template<>
+class SaveFields<UnitType> {
+public:
+    static constexpr auto fields = std::make_tuple(
+        &UnitType::max_defensive_ticks,
+        &UnitType::position_defense,
+        &UnitType::req_goods
+    );
+};
+
+template<>
+class SaveFields<BoatType> {
+public:
+    static constexpr auto fields = std::make_tuple(
+        &BoatType::req_goods
+    );
+};
+
+template<>
+class SaveFields<BuildingType> {
+public:
+    static constexpr auto fields = std::make_tuple(
+        &BuildingType::name,
+        &BuildingType::is_factory,
+        &BuildingType::inputs,
+        &BuildingType::outputs
+    );
+};
+
+template<>
+class SaveFields<Event> {
+public:
+    static constexpr auto fields = std::make_tuple(
+        &Event::checked
+    );
+};
+
+template<>
+class SaveFields<Nation> {
+public:
+    static constexpr auto fields = std::make_tuple(
+        &Nation::gdp,
+        &Nation::neighbours,
+        &Nation::modifiers,
+        &Nation::is_ai
+    );
+};
+
+template<>
+class SaveFields<Province> {
+public:
+    static constexpr auto fields = std::make_tuple(
+        &Province::base_attractive
+    );
+};
+
+template<>
+class SaveFields<Company> {
+public:
+    static constexpr auto fields = std::make_tuple(
+        &Company::nation
+    );
+};
+
+template<>
+class SaveFields<Product> {
+public:
+    static constexpr auto fields = std::make_tuple(
+        &Product::price_history,
+        &Product::supply_history,
+        &Product::demand_history
+    );
+};
+
+template<>
+class SaveFields<Building> {
+public:
+    static constexpr auto fields = std::make_tuple(
+        &Building::req_goods_for_unit,
+        &Building::req_goods_for_boat,
+        &Building::employees_needed_per_output
+    );
+};
+
+template<>
+class SaveFields<Unit> {
+public:
+    static constexpr auto fields = std::make_tuple(
+        &Unit::base,
+        &Unit::morale,
+        &Unit::experience,
+        &Unit::ignore_tag,
+        &Unit::defensive_ticks,
+        &Unit::supply,
+        &Unit::budget
+    );
+};
+
+template<>
+class SaveFields<Boat> {
+public:
+    static constexpr auto fields = std::make_tuple(
+        &Boat::base,
+        &Boat::morale,
+        &Boat::experience,
+        &Boat::ignore_tag,
+        &Boat::defensive_ticks,
+        &Boat::supply
+    );
+};
+
+template<typename T, typename O, typename F>
+inline void for_each_save_field(O* obj, F func) {
+    std::apply([obj, &func](auto... fields) {
+        (func(&(obj->*fields)), ...);
+    }, SaveFields<T>::fields);
+}
+
+template<typename T>
+static inline void save_object(Archive& ar, const T* obj) {
+    ::serialize(ar, obj);
+    for_each_save_field<T>(obj, [&ar](const auto* field) {
+        ::serialize(ar, field);
+    });
+}
+
+template<typename T>
+static inline void load_object(Archive& ar, T* obj) {
+    ::deserialize(ar, obj);
+    for_each_save_field<T>(obj, [&ar](auto* field) {
+        ::deserialize(ar, field);
+    });
+}
+
+// Provinces are saved without their pops, which go on their own sections
+template<>
+inline void save_object<Province>(Archive& ar, const Province* obj) {
+    for_each_field<Province>(obj, [&ar](const auto* field) {
+        using F = std::remove_cv_t<std::remove_pointer_t<decltype(field)>>;
+        if constexpr(!std::is_same<F, std::vector<Pop>>::value)
+            ::serialize(ar, field);
+    });
+    for_each_save_field<Province>(obj, [&ar](const auto* field) {
+        ::serialize(ar, field);
+    });
+}
+
+template<>
+inline void load_object<Province>(Archive& ar, Province* obj) {
+    for_each_field<Province>(obj, [&ar](auto* field) {
+        using F = std::remove_pointer_t<decltype(field)>;
+        if constexpr(!std::is_same<F, std::vector<Pop>>::value)
+            ::deserialize(ar, field);
+    });
+    for_each_save_field<Province>(obj, [&ar](auto* field) {
+        ::deserialize(ar, field);
+    });
+}
+
+template<typename T>
+static inline void save_objects(Archive& ar, const std::vector<T*>& list, size_t first, size_t count) {
+    for(size_t i = first; i < first + count; i++) {
+        save_object(ar, (const T*)list[i]);
+    }
+}
+
+template<typename T>
+static inline void save_objects(Archive& ar, const std::vector<T*>& list) {
+    save_objects(ar, list, 0, list.size());
+}
+
+template<typename T>
+static inline void load_objects(Archive& ar, std::vector<T*>& list, size_t first, size_t count) {
+    for(size_t i = first; i < first + count; i++) {
+        load_object(ar, list[i]);
+    }
+}
+
+template<typename T>
+static inline void load_objects(Archive& ar, std::vector<T*>& list) {
+    load_objects(ar, list, 0, list.size());
+}
+
+static void serialize_section(const World& world, const Section& section, Archive& ar) {
+    switch(section.id) {
+    case SectionId::TILES:
+        TileCodec::encode(ar, &world.tiles[section.first * world.width], section.count * world.width);
+        break;
+    case SectionId::DEFINITIONS:
+        save_objects(ar, world.goods);
+        save_objects(ar, world.unit_types);
+        save_objects(ar, world.boat_types);
+        save_objects(ar, world.religions);
+        save_objects(ar, world.cultures);
+        save_objects(ar, world.pop_types);
+        save_objects(ar, world.unit_traits);
+        save_objects(ar, world.building_types);
+        save_objects(ar, world.ideologies);
+        save_objects(ar, world.inventions);
+        save_objects(ar, world.technologies);
+        save_objects(ar, world.nation_modifiers);
+        save_objects(ar, world.events);
+        break;
+    case SectionId::NATIONS:
+        save_objects(ar, world.nations, section.first, section.count);
+        break;
+    case SectionId::PROVINCES:
+        save_objects(ar, world.provinces, section.first, section.count);
+        break;
+    case SectionId::POPS:
+        for(size_t i = section.first; i < section.first + section.count; i++) {
+            ::serialize(ar, &world.provinces[i]->pops);
+        }
+        break;
+    case SectionId::ECONOMY:
+        save_objects(ar, world.companies);
+        save_objects(ar, world.products);
+        save_objects(ar, world.buildings);
+        ::serialize(ar, &world.orders);
+        ::serialize(ar, &world.delivers);
+        break;
+    case SectionId::MILITARY:
+        save_objects(ar, world.units);
+        save_objects(ar, world.boats);
+        break;
+    case SectionId::DIPLOMACY:
+        save_objects(ar, world.treaties);
+        break;
+    default:
+        throw SaveGameException("Unknown section");
+    }
+}
+
+static void deserialize_section(World& world, const Section& section, Archive& ar) {
+    switch(section.id) {
+    case SectionId::TILES:
+        TileCodec::decode(ar, &world.tiles[section.first * world.width], section.count * world.width);
+        break;
+    case SectionId::DEFINITIONS:
+        load_objects(ar, world.goods);
+        load_objects(ar, world.unit_types);
+        load_objects(ar, world.boat_types);
+        load_objects(ar, world.religions);
+        load_objects(ar, world.cultures);
+        load_objects(ar, world.pop_types);
+        load_objects(ar, world.unit_traits);
+        load_objects(ar, world.building_types);
+        load_objects(ar, world.ideologies);
+        load_objects(ar, world.inventions);
+        load_objects(ar, world.technologies);
+        load_objects(ar, world.nation_modifiers);
+        load_objects(ar, world.events);
+        break;
+    case SectionId::NATIONS:
+        load_objects(ar, world.nations, section.first, section.count);
+        break;
+    case SectionId::PROVINCES:
+        load_objects(ar, world.provinces, section.first, section.count);
+        break;
+    case SectionId::POPS:
+        for(size_t i = section.first; i < section.first + section.count; i++) {
+            ::deserialize(ar, &world.provinces[i]->pops);
+        }
+        break;
+    case SectionId::ECONOMY:
+        // Companies add themselves to the transport network when deserialized, so
+        // this section is never split
+        load_objects(ar, world.companies);
+        load_objects(ar, world.products);
+        load_objects(ar, world.buildings);
+        ::deserialize(ar, &world.orders);
+        ::deserialize(ar, &world.delivers);
+        break;
+    case SectionId::MILITARY:
+        load_objects(ar, world.units);
+        load_objects(ar, world.boats);
+        break;
+    case SectionId::DIPLOMACY:
+        load_objects(ar, world.treaties);
+        break;
+    default:
+        throw SaveGameException("Unknown section");
+    }
+}
+
+// Number of elements the sections of the given type are split on, 1 for the sections
+// that are not split
+static size_t get_n_elems(const Header& header, SectionId id) {
+    switch(id) {
+    case SectionId::TILES:
+        return header.height;
+    case SectionId::NATIONS:
+        return header.n_elems[nations_list];
+    case SectionId::PROVINCES:
+    case SectionId::POPS:
+        return header.n_elems[provinces_list];
+    default:
+        return 1;
+    }
+}
+
+static size_t get_chunk_size(SectionId id) {
+    switch(id) {
+    case SectionId::TILES:
+        return tile_rows_per_section;
+    case SectionId::NATIONS:
+        return nations_per_section;
+    case SectionId::PROVINCES:
+    case SectionId::POPS:
+        return provinces_per_section;
+    default:
+        return 1;
+    }
+}
+
+static uint32_t get_checksum(const uint8_t* data, size_t size) {
+    uLong crc = crc32(0L, Z_NULL, 0);
+
+    // zlib takes 32-bit lengths
+    while(size) {
+        const uInt len = (uInt)std::min<size_t>(size, 1 << 30);
+        crc = crc32(crc, data, len);
+        data += len;
+        size -= len;
+    }
+    return (uint32_t)crc;
+}
+
+static void get_list_sizes(const World& world, uint64_t* sizes) {
+    size_t i = 0;
+    std::apply([&world, sizes, &i](auto... lists) {
+        ((sizes[i++] = (world.*lists).size()), ...);
+    }, world_lists);
+}
+
+void SaveGame::save(const World& world, const std::string& path) {
+    Header header;
+    std::memcpy(header.magic, save_magic, sizeof(header.magic));
+    header.version = SaveGame::version;
+    header.width = world.width;
+    header.height = world.height;
+    header.sea_level = world.sea_level;
+    header.time = world.time;
+    get_list_sizes(world, header.n_elems);
+
+    std::vector<Section> sections;
+    for(uint32_t i = 0; i < (uint32_t)SectionId::COUNT; i++) {
+        const SectionId id = (SectionId)i;
+        const size_t n_elems = get_n_elems(header, id);
+        const size_t chunk_size = get_chunk_size(id);
+        for(size_t first = 0; first < n_elems; first += chunk_size) {
+            Section section;
+            section.id = id;
+            section.first = first;
+            section.count = std::min(chunk_size, n_elems - first);
+            sections.push_back(section);
+        }
+    }
+    header.n_sections = sections.size();
+
+    // The sections are serialized in parallel, each on it's own archive
+    std::vector<Archive> archives(sections.size());
+    TaskGroup group;
+    for(size_t i = 0; i < sections.size(); i++) {
+        group.run([&world, &sections, &archives, i]() {
+            serialize_section(world, sections[i], archives[i]);
+            sections[i].size = archives[i].size();
+            sections[i].checksum = get_checksum(archives[i].data(), archives[i].size());
+        });
+    }
+    group.wait();
+
+    uint64_t offset = sizeof(Header) + sections.size() * sizeof(Section);
+    for(auto& section: sections) {
+        section.offset = offset;
+        offset += section.size;
+    }
+
+    const std::string tmp_path = path + ".tmp";
+    FILE* fp = fopen(tmp_path.c_str(), "wb");
+    if(fp == NULL)
+        throw SaveGameException("Can't open " + tmp_path + " for writing");
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    ok = ok && fwrite(sections.data(), sizeof(Section), sections.size(), fp) == sections.size();
+    for(const auto& ar: archives) {
+        if(ar.size())
+            ok = ok && fwrite(ar.data(), 1, ar.size(), fp) == ar.size();
+    }
+    ok = (fclose(fp) == 0) && ok;
+    if(!ok) {
+        std::remove(tmp_path.c_str());
+        throw SaveGameException("Can't write " + tmp_path);
+    }
+
+#ifdef windows
+    // Windows does not replace the destination on a rename
+    std::remove(path.c_str());
+#endif
+    if(std::rename(tmp_path.c_str(), path.c_str()) != 0)
+        throw SaveGameException("Can't rename " + tmp_path + " to " + path);
+
+    print_info("Saved %zu sections (%llu bytes) into %s", sections.size(), (unsigned long long)offset, path.c_str());
+}
+
+// A file mapped on memory (read only), only the pages that are touched are read from
+// the disk
+class MappedFile {
+#ifdef unix
+    int fd = -1;
+#elif defined windows
+    // TODO: Use MapViewOfFile, the whole file is read for now
+    Archive archive;
+#endif
+public:
+    MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+MappedFile::MappedFile(const std::string& path) {
+#ifdef unix
+    fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw SaveGameException("Can't open " + path);
+
+    struct stat st;
+    if(fstat(fd, &st) < 0) {
+        close(fd);
+        throw SaveGameException("Can't stat " + path);
+    }
+    size = st.st_size;
+    if(!size)
+        return;
+
+    void* ptr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(ptr == MAP_FAILED) {
+        close(fd);
+        throw SaveGameException("Can't map " + path);
+    }
+    data = (const uint8_t*)ptr;
+
+    // All the sections are going to be read right away
+    madvise(ptr, size, MADV_WILLNEED);
+#elif defined windows
+    try {
+        archive.from_file(path);
+    } catch(SerializerException& e) {
+        throw SaveGameException(e.what());
+    }
+    data = archive.data();
+    size = archive.size();
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef unix
+    if(data != nullptr)
+        munmap((void*)data, size);
+    close(fd);
+#endif
+}
+
+// Checks the header and the table of sections, so the sections can be loaded in
+// parallel without stepping on each other
+static std::vector<Section> read_table(const MappedFile& file, Header& header) {
+    if(file.size < sizeof(Header))
+        throw SaveGameException("File too small for a save");
+
+    std::memcpy(&header, file.data, sizeof(Header));
+    if(std::memcmp(header.magic, save_magic, sizeof(header.magic)))
+        throw SaveGameException("Not a save");
+    if(header.version != SaveGame::version)
+        throw SaveGameException("Unsupported version " + std::to_string(header.version) + " of save");
+
+    if(!header.width || !header.height || header.width > SIZE_MAX / sizeof(Tile) / header.height)
+        throw SaveGameException("Invalid size of map");
+
+    // Every object takes at least a byte of the file
+    for(const auto& n_elems: header.n_elems) {
+        if(n_elems > file.size)
+            throw SaveGameException("Too many objects");
+    }
+
+    if(header.n_sections > (file.size - sizeof(Header)) / sizeof(Section))
+        throw SaveGameException("Table of sections does not fit");
+
+    std::vector<Section> sections(header.n_sections);
+    std::memcpy(sections.data(), file.data + sizeof(Header), sections.size() * sizeof(Section));
+
+    // The chunks of each type must come in order and cover all the elements, without
+    // overlapping
+    std::vector<uint64_t> next_first((size_t)SectionId::COUNT, 0);
+    for(const auto& section: sections) {
+        if(section.id >= SectionId::COUNT)
+            throw SaveGameException("Unknown section");
+        if(section.offset > file.size || section.size > file.size - section.offset)
+            throw SaveGameException("Section does not fit");
+
+        uint64_t& next = next_first[(size_t)section.id];
+        if(section.first != next || !section.count || section.count > get_n_elems(header, section.id) - next)
+            throw SaveGameException("Invalid range of section");
+        next += section.count;
+    }
+    for(uint32_t i = 0; i < (uint32_t)SectionId::COUNT; i++) {
+        if(next_first[i] != get_n_elems(header, (SectionId)i))
+            throw SaveGameException("Missing sections");
+    }
+    return sections;
+}
+
+template<typename T>
+static void create_list(World& world, std::vector<T*>& list, size_t n_elems) {
+    list.reserve(n_elems);
+    for(size_t i = 0; i < n_elems; i++) {
+        world.insert(new T());
+    }
+}
+
+template<typename T>
+static void delete_list(std::vector<T*>& list) {
+    for(auto& obj: list) {
+        delete obj;
+    }
+    list.clear();
+}
+
+template<typename L>
+class ListsOf;
+template<typename... M>
+class ListsOf<std::tuple<M...>> {
+public:
+    using type = std::tuple<std::remove_reference_t<decltype(std::declval<World&>().*std::declval<M>())>...>;
+};
+
+// What a load replaces of the world, the current state is kept aside until the save is
+// loaded so it can be put back if the save turns out to be corrupted
+class WorldState {
+    template<size_t... I>
+    void swap_lists(World& world, std::index_sequence<I...>) {
+        (std::swap(std::get<I>(lists), world.*std::get<I>(world_lists)), ...);
+    }
+public:
+    WorldState() {};
+    WorldState(const WorldState&) = delete;
+    WorldState& operator=(const WorldState&) = delete;
+    ~WorldState() {
+        std::apply([](auto&... list) {
+            (delete_list(list), ...);
+        }, lists);
+        delete[] tiles;
+    };
+
+    typename ListsOf<std::remove_cv_t<decltype(world_lists)>>::type lists;
+    Tile* tiles = nullptr;
+    size_t width = 0, height = 0, sea_level = 0;
+    uint64_t time = 0;
+    std::vector<OrderGoods> orders;
+    std::vector<DeliverGoods> delivers;
+    TransportNetwork transport_network;
+
+    void swap(World& world) {
+        swap_lists(world, std::make_index_sequence<n_world_lists>());
+        std::swap(tiles, world.tiles);
+        std::swap(width, world.width);
+        std::swap(height, world.height);
+        std::swap(sea_level, world.sea_level);
+        std::swap(time, world.time);
+        std::swap(orders, world.orders);
+        std::swap(delivers, world.delivers);
+        std::swap(transport_network, world.transport_network);
+    }
+};
+
+void SaveGame::load(World& world, const std::string& path) {
+    MappedFile file(path);
+    Header header;
+    std::vector<Section> sections = read_table(file, header);
+
+    // The world is emptied, the previous state is destroyed when we are done (or put
+    // back if something goes wrong)
+    WorldState prev_state;
+    prev_state.swap(world);
+    try {
+        world.width = header.width;
+        world.height = header.height;
+        world.sea_level = header.sea_level;
+        world.time = header.time;
+        world.tiles = new Tile[world.width * world.height];
+
+        size_t i = 0;
+        std::apply([&world, &header, &i](auto... lists) {
+            (create_list(world, world.*lists, header.n_elems[i++]), ...);
+        }, world_lists);
+
+        // Bigger sections first, so the pool is not left waiting for a big one at the end
+        std::sort(sections.begin(), sections.end(), [](const Section& lhs, const Section& rhs) {
+            return lhs.size > rhs.size;
+        });
+
+        TaskGroup group;
+        for(const auto& section: sections) {
+            group.run([&world, &file, &section]() {
+                const uint8_t* data = file.data + section.offset;
+                if(get_checksum(data, section.size) != section.checksum)
+                    throw SaveGameException("Corrupted section " + std::to_string((uint32_t)section.id));
+
+                Archive ar = Archive();
+                ar.set_view(data, section.size);
+                deserialize_section(world, section, ar);
+                if(ar.ptr != ar.size())
+                    throw SaveGameException("Trailing data on section " + std::to_string((uint32_t)section.id));
+            });
+        }
+        group.wait();
+    } catch(std::exception& e) {
+        // Take out what was loaded (to be destroyed) and put the previous state back
+        WorldState failed_state;
+        failed_state.swap(world);
+        prev_state.swap(world);
+        throw SaveGameException(std::string("Can't load ") + path + ": " + e.what());
+    }
+
+    // Drop everything that pointed to the previous objects and tiles
+    world.job_requests.clear();
+    world.taken_descisions.clear();
+    world.changed_tile_coords.clear();
+    world.nation_changed_tiles.clear();
+    world.elevation_changed_tiles.clear();
+    world.unit_grid.build(world.units, world.width);
+    world.boat_grid.build(world.boats, world.width);
+
+    // Publish the new tiles from scratch
+    std::atomic_store(&world.front_tiles, std::shared_ptr<std::vector<Tile>>());
+    world.back_tiles = nullptr;
+    world.back_dirty_tiles.clear();
+    world.publish_tiles();
+
+    print_info("Loaded %zu sections from %s", sections.size(), path.c_str());
+}
+
+void SaveGame::check(World& world, const std::string& path) {
+    save(world, path);
+    load(world, path);
+    const std::string check_path = path + ".check";
+    save(world, check_path);
+
+    size_t offset = 0;
+    std::string where;
+    {
+        MappedFile file(path);
+        MappedFile check_file(check_path);
+        const size_t size = std::min(file.size, check_file.size);
+        while(offset < size && file.data[offset] == check_file.data[offset]) {
+            offset++;
+        }
+        if(offset == file.size && offset == check_file.size) {
+            std::remove(check_path.c_str());
+            print_info("Saving %s again gives the same %zu bytes", path.c_str(), offset);
+            return;
+        }
+
+        // Tell on which section they start to differ
+        where = (offset < sizeof(Header)) ? "the header" : "the table of sections";
+        Header header;
+        for(const auto& section: read_table(file, header)) {
+            if(offset >= section.offset && offset < section.offset + section.size) {
+                where = "section " + std::to_string((uint32_t)section.id) + " (from element " + std::to_string(section.first) + ")";
+            }
+        }
+    }
+    throw SaveGameException(path + " and " + check_path + " differ at byte " + std::to_string(offset) + ", on " + where);
+}
@@ -0,0 +1,52 @@
+#ifndef SAVE_GAME_HPP
+#define SAVE_GAME_HPP
+
+#include <cstdint>
+#include <exception>
+#include <string>
+
+class World;
+
+class SaveGameException : public std::exception {
+    std::string buffer;
+public:
+    SaveGameException(const std::string& msg) {
+        buffer = msg;
+    };
+    virtual const char* what(void) const noexcept {
+        return buffer.c_str();
+    };
+};
+
+/**
+ * Saved games, the file is a header (size of the map and of the lists of the world)
+ * followed by a table of sections and their data. Each section holds a part of the world
+ * (tiles, definitions, nations, provinces, pops, economy, military and diplomacy) and the
+ * big ones are split in chunks (i.e a range of provinces) so they can be saved and loaded
+ * in parallel.
+ *
+ * The file is mapped on memory when loading and the sections are read in place, the
+ * header and the table are checked first but the data of a section is only checked
+ * (against it's checksum) by the job that loads it, right before loading it
+ */
+namespace SaveGame {
+    // Incremented each time the format changes, older saves can't be loaded
+    constexpr uint32_t version = 2;
+
+    // Saves the whole state of the world, the file is written on a temporal file first so
+    // a failed save does not destroy the previous one
+    void save(const World& world, const std::string& path);
+
+    // Replaces the state of the world with the saved one, the world must be the instance
+    // (the references between objects are resolved thru it). Must be called between ticks
+    // by the thread running the simulation, since the tiles and all the objects of the world
+    // are reallocated. If the save is corrupted the world is left as it was
+    void load(World& world, const std::string& path);
+
+    // Saves the world, loads it back and saves it again into path + ".check", both files
+    // must be the same byte by byte (otherwise something is not saved or loaded right).
+    // The world is loaded, so the same as for load applies
+    void check(World& world, const std::string& path);
+};
+
+#endif
@@ -8,6 +8,7 @@
 #include <cstring>
 #include <cstdio>
 #include <cstdlib>
+#include <cerrno>
 #include <mutex>
 /* Visual Studio does not know about UNISTD.H, Mingw does through */
 #ifndef _MSC_VER
@@ -16,6 +17,9 @@
 
 #ifdef unix
 #	include <poll.h>
+#	include <sys/epoll.h>
+#	include <sys/eventfd.h>
+#	include <sys/wait.h>
 #elif defined windows
 /* MingW does not behave well with pollfd structures, however MSVC does */
 #	ifndef _MSC_VER
@@ -41,18 +45,60 @@ WINSOCK_API_LINKAGE int WSAAPI WSAPoll(LPWSAPOLLFD fdArray, ULONG fds, INT timeo
 
 #include <chrono>
 #include <thread>
+#include <zlib.h>
 #include "../actions.hpp"
 #include "../world.hpp"
 #include "../io_impl.hpp"
 #include "server_network.hpp"
-#include "../actions.hpp"
-#include "../io_impl.hpp"
+#include "../profiler.hpp"
+
+// Tags of the epoll events that are not about a client
+static constexpr uint64_t listen_tag = (uint64_t)-1;
+static constexpr uint64_t wake_tag = (uint64_t)-2;
+
+// Set on the tag of the pipe of a snapshot being made, the rest is the client ID
+static constexpr uint64_t snapshot_tag = (uint64_t)1 << 62;
+
+// Maximum number of packets given to a single write
+static constexpr size_t max_packets_per_write = 64;
+
+#ifdef unix
+static void set_nonblocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+static void close_socket(int fd) {
+    shutdown(fd, SHUT_RDWR);
+    close(fd);
+}
+#elif defined windows
+static void set_nonblocking(SOCKET fd) {
+    u_long mode = 1;
+    ioctlsocket(fd, FIONBIO, &mode);
+}
+
+static void close_socket(SOCKET fd) {
+    shutdown(fd, SD_BOTH);
+    closesocket(fd);
+}
+#endif
+
+// Whetever the last failed socket operation failed because it would have blocked
+static bool would_block(void) {
+#ifdef unix
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#elif defined windows
+    const int error = WSAGetLastError();
+    return error == WSAEWOULDBLOCK || error == WSAEINTR;
+#endif
+}
 
 Server* g_server = nullptr;
 Server::Server(const unsigned port, const unsigned max_conn) : n_clients(max_conn) {
     g_server = this;
 
     run = true;
+    snapshot_generation = 0;
 #ifdef windows
     WSADATA data;
     WSAStartup(MAKEWORD(2, 2), &data);
@@ -75,482 +121,1261 @@ Server::Server(const unsigned port, const unsigned max_conn) : n_clients(max_con
     if(listen(fd, max_conn) != 0) {
         throw SocketException("Cannot listen in specified number of concurrent connections");
     }
+    set_nonblocking(fd);
 
-#ifdef unix
-    fcntl(fd, F_SETFL, fcntl(fd, F_GETFD, 0) | O_NONBLOCK);
-#endif
-
-    print_info("Deploying %u threads for clients", max_conn);
     clients = new ServerClient[max_conn];
     for(size_t i = 0; i < max_conn; i++) {
+        clients[i].conn_id = 0;
         clients[i].is_connected = false;
-        clients[i].packets_mutex.unlock();
-        clients[i].thread = std::thread(&Server::net_loop, this, i);
+        clients[i].has_snapshot = false;
+        clients[i].is_closing = false;
+        clients[i].is_loading = false;
+        clients[i].features = 0;
+#ifdef unix
+        clients[i].wants_snapshot = false;
+#endif
     }
     
 #ifdef unix
     // We need to ignore pipe signals since any client disconnecting **will** kill the server
     signal(SIGPIPE, SIG_IGN);
+
+    epoll_fd = epoll_create1(0);
+    if(epoll_fd < 0) {
+        throw SocketException("Cannot create epoll instance");
+    }
+
+    wake_fd = eventfd(0, EFD_NONBLOCK);
+    if(wake_fd < 0) {
+        throw SocketException("Cannot create wake up event");
+    }
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = listen_tag;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    event.data.u64 = wake_tag;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
 #endif
+
+    // A single thread does all the I/O of the clients
+    io_thread = std::thread(&Server::io_loop, this);
     
-    print_info("Server created sucessfully and listening to %u; now invite people!", port);
+    print_info("Server created sucessfully and listening to %u (up to %u clients); now invite people!", port, max_conn);
+}
+
+Server::Server(NullSink) : clients(nullptr), n_clients(0) {
+    g_server = this;
+    run = false;
+    snapshot_generation = 0;
+    fd = INVALID_SOCKET;
+#ifdef unix
+    epoll_fd = -1;
+    wake_fd = -1;
+#endif
 }
 
 Server::~Server() {
     run = false;
+    if(io_thread.joinable()) {
+        wake();
+        io_thread.join();
+    }
+
+    for(size_t i = 0; i < (size_t)n_clients; i++) {
+        if(clients[i].is_connected) {
+            close_socket(clients[i].fd);
 #ifdef unix
-    close(fd);
+            cancel_snapshot(i);
+#endif
+        }
+    }
+
+#ifdef unix
+    if(epoll_fd != -1)
+        close(epoll_fd);
+    if(wake_fd != -1)
+        close(wake_fd);
+#endif
+
+    if(fd != INVALID_SOCKET) {
+#ifdef unix
+        close(fd);
 #elif defined windows
-    closesocket(fd);
-    WSACleanup();
+        closesocket(fd);
+        WSACleanup();
 #endif
+    }
     delete[] clients;
 }
 
 // This will broadcast the given packet to all clients currently on the server
+thread_local Outbox* Server::outbox = nullptr;
+
 void Server::broadcast(Packet& packet) {
-    for(size_t i = 0; i < n_clients; i++) {
+    if(outbox != nullptr) {
+        outbox->packets.push_back(packet);
+        return;
+    }
+    send_to_clients(std::make_shared<const Packet>(packet));
+}
+
+void Server::broadcast_local(Packet& packet, size_t x, size_t y, const Nation* owner, size_t key) {
+    LocalPacket local;
+    local.packet = std::make_shared<const Packet>(packet);
+    local.x = x;
+    local.y = y;
+    local.owner = owner;
+    local.key = key;
+    broadcast_local(local);
+}
+
+void Server::broadcast_local(const LocalPacket& local) {
+    if(outbox != nullptr) {
+        outbox->local_packets.push_back(local);
+        return;
+    }
+    send_local(std::vector<LocalPacket>{ local }, false);
+}
+
+void Server::forget_local(size_t key) {
+    LocalPacket local;
+    local.packet = nullptr;
+    local.x = 0;
+    local.y = 0;
+    local.owner = nullptr;
+    local.key = key;
+    broadcast_local(local);
+}
+
+// Puts the packets on a TICK_FRAME, each action is prefixed with it's size
+static std::shared_ptr<Packet> make_frame(const std::vector<const Packet*>& packets) {
+    Archive ar = Archive();
+    size_t total_size = sizeof(ActionType) + sizeof(uint32_t);
+    for(const auto& packet: packets) {
+        total_size += sizeof(uint32_t) + packet->size();
+    }
+    ar.reserve(total_size);
+
+    ActionType action = ActionType::TICK_FRAME;
+    ::serialize(ar, &action);
+    uint32_t n_actions = packets.size();
+    ::serialize(ar, &n_actions);
+    for(const auto& packet: packets) {
+        uint32_t size = packet->size();
+        ::serialize(ar, &size);
+        ar.write(packet->buffer.data(), size);
+    }
+
+    std::shared_ptr<Packet> frame = std::make_shared<Packet>();
+    frame->data(ar.get_buffer(), ar.size());
+    return frame;
+}
+
+void Server::broadcast_frame(Outbox& frame_outbox) {
+    // The frames are sent as is, even if this thread has an outbox
+    if(!frame_outbox.packets.empty()) {
+        std::vector<const Packet*> packets;
+        packets.reserve(frame_outbox.packets.size());
+        for(const auto& packet: frame_outbox.packets) {
+            packets.push_back(&packet);
+        }
+        send_to_clients(make_frame(packets));
+    }
+
+    frames_since_summary++;
+    const bool is_summary = (frames_since_summary >= summary_interval);
+    if(is_summary)
+        frames_since_summary = 0;
+    send_local(frame_outbox.local_packets, is_summary);
+}
+
+/**
+ * Whetever the client wants to know right away about the local packet: it happened on
+ * the territory of the nation of the client, it's about the nation or an ally, or it's
+ * on the viewport of the client. Clients that did not tell their viewport are interested
+ * in everything
+ */
+bool Server::is_interested(const ServerClient& cl, const LocalPacket& local) const {
+    if(!cl.has_viewport)
+        return true;
+
+    // Some margin so things entering the viewport are already there
+    const float margin = 8.f;
+    if(local.x + margin >= cl.view_min_x && local.x <= cl.view_max_x + margin
+    && local.y + margin >= cl.view_min_y && local.y <= cl.view_max_y + margin)
+        return true;
+
+    const Nation* nation = cl.selected_nation;
+    if(nation == nullptr)
+        return false;
+
+    if(local.owner == nation)
+        return true;
+    if(local.owner != nullptr && nation->relations[g_world->get_id(local.owner)].has_alliance)
+        return true;
+
+    const Tile& tile = g_world->get_tile(std::min(local.x, g_world->width - 1), std::min(local.y, g_world->height - 1));
+    return tile.owner_id == g_world->get_id(nation);
+}
+
+/**
+ * Sends each client a TICK_FRAME with the local packets it's interested in. The rest are
+ * deferred (or dropped if they have no key) until the summary, when everything is sent
+ */
+void Server::send_local(const std::vector<LocalPacket>& local_packets, bool is_summary) {
+    ProfileTimer timer("Server::send_local");
+    std::vector<size_t> forgotten_keys;
+    for(const auto& local: local_packets) {
+        if(local.packet == nullptr)
+            forgotten_keys.push_back(local.key);
+    }
+
+    std::vector<const Packet*> packets;
+    for(size_t i = 0; i < (size_t)n_clients; i++) {
+        ServerClient& cl = clients[i];
+        if(!cl.is_connected || !cl.has_snapshot)
+            continue;
+
+        // Forgotten before the deferred packets are sent, they are older than the frame
+        for(const auto& key: forgotten_keys) {
+            cl.deferred.erase(key);
+        }
+
+        packets.clear();
+        if(is_summary) {
+            for(const auto& deferred: cl.deferred) {
+                packets.push_back(deferred.second.get());
+            }
+        }
+
+        for(const auto& local: local_packets) {
+            if(local.packet == nullptr)
+                continue;
+
+            if(is_summary || is_interested(cl, local)) {
+                packets.push_back(local.packet.get());
+                if(local.key != LocalPacket::no_key)
+                    cl.deferred.erase(local.key);
+            } else if(local.key != LocalPacket::no_key) {
+                cl.deferred[local.key] = local.packet;
+            }
+        }
+
+        // The deferred packets were sent above, and some may have been replaced by newer
+        // packets of the same key sent after them
+        if(is_summary)
+            cl.deferred.clear();
+
+        if(!packets.empty())
+            send_to(i, make_frame(packets));
+    }
+}
+
+void Server::send_to_clients(std::shared_ptr<const Packet> packet) {
+    ProfileTimer timer("Server::broadcast");
+    Profiler::get_instance().count(ProfileCounter::PACKETS_BROADCAST);
+    Profiler::get_instance().count(ProfileCounter::BYTES_BROADCAST, packet->buffer.size());
+
+    // Big packets are compressed once for all the clients that support it
+    std::shared_ptr<const Packet> compressed = nullptr;
+    if(packet->size() >= compress_threshold) {
+        for(size_t i = 0; i < (size_t)n_clients; i++) {
+            if(clients[i].is_connected && clients[i].has_snapshot && (clients[i].features & NET_FEATURE_DEFLATE)) {
+                ProfileTimer compress_timer("Server::compress");
+                std::shared_ptr<Packet> tmp = std::make_shared<Packet>();
+                if(deflate_packet(*packet, *tmp, Z_BEST_SPEED))
+                    compressed = tmp;
+                break;
+            }
+        }
+    }
+
+    for(size_t i = 0; i < (size_t)n_clients; i++) {
         if(clients[i].is_connected == true) {
             const std::lock_guard<std::mutex> lock(clients[i].packets_mutex);
-            clients[i].packets.push_back(packet);
+            if(clients[i].has_snapshot == false)
+                continue;
+
+            const std::shared_ptr<const Packet>& client_packet = (compressed != nullptr && (clients[i].features & NET_FEATURE_DEFLATE)) ? compressed : packet;
+            clients[i].packets.push_back(client_packet);
+            clients[i].packets_size += client_packet->buffer.size();
 
             // Disconnect the client when more than 200 MB is used
             // we can't save your packets buddy - other clients need their stuff too!
-            size_t total_size = 0;
-            for(const auto& packet_q: clients[i].packets) {
-                total_size += packet_q.buffer.size();
-            }
-            if(total_size >= 200 * 1000000) {
-                clients[i].is_connected = false;
+            if(clients[i].packets_size >= 200 * 1000000) {
+                print_error("Client %zu has exceeded max quota! - It has used %zu bytes!", i, clients[i].packets_size);
+                clients[i].has_snapshot = false;
+                clients[i].is_closing = true;
                 clients[i].packets.clear();
-                print_error("Client %zu has exceeded max quota! - It has used %zu bytes!", i, total_size);
+                clients[i].packets_size = 0;
             }
         }
     }
+    wake();
 }
 
-/** This is the handling thread-function for handling a connection to a single client
- * Sending packets will only be received by the other end, when trying to broadcast please
- * put the packets on the send queue, they will be sent accordingly
- */
-void Server::net_loop(int id) {
+// Queues a packet to be sent only to the given client
+void Server::send_to(size_t id, Packet& packet) {
+    send_to(id, std::make_shared<const Packet>(packet));
+}
+
+void Server::send_to(size_t id, std::shared_ptr<const Packet> packet) {
     ServerClient& cl = clients[id];
+    if(packet->size() >= compress_threshold && (cl.features & NET_FEATURE_DEFLATE)) {
+        std::shared_ptr<Packet> compressed = std::make_shared<Packet>();
+        if(deflate_packet(*packet, *compressed, Z_BEST_SPEED))
+            packet = compressed;
+    }
+
+    {
+        const std::lock_guard<std::mutex> lock(cl.packets_mutex);
+        cl.packets_size += packet->buffer.size();
+        cl.packets.push_back(std::move(packet));
+    }
+    wake();
+}
+
+// Wakes up the I/O thread so it sends the queued packets
+void Server::wake(void) {
+#ifdef unix
+    if(wake_fd == -1)
+        return;
+
+    // A failure means the counter is already full, so it's already going to wake up
+    const uint64_t n = 1;
+    if(::write(wake_fd, &n, sizeof(n)) < 0)
+        return;
+#endif
+}
+
+/**
+ * The loop of the I/O thread, waits for the sockets to be ready and reads or writes
+ * them without blocking, the packets received are queued for the simulation thread
+ * (see process_actions)
+ */
+void Server::io_loop(void) {
+#ifdef unix
+    std::vector<epoll_event> events(64);
     while(run) {
-        int conn_fd = 0;
-        try {
-            sockaddr_in client;
-            socklen_t len = sizeof(client);
-
-            cl.is_connected = false;
-            while(!cl.is_connected) {
-                try {
-                    conn_fd = accept(fd, (sockaddr *)&client, &len);
-                    if(conn_fd == INVALID_SOCKET)
-                        throw SocketException("Cannot accept client connection");
-
-                    // At this point the client's connection was accepted - so we only have to check
-                    // Then we check if the server is running and we throw accordingly
-                    cl.is_connected = true;
-                    break;
-                } catch(SocketException& e) {
-                    // Do something
-                    if(run == false)
-                        throw SocketException("Close client");
-                }
-                std::this_thread::sleep_for(std::chrono::seconds(3));
+        const int n_events = epoll_wait(epoll_fd, events.data(), events.size(), 100);
+        for(int i = 0; i < n_events; i++) {
+            const uint64_t tag = events[i].data.u64;
+            if(tag == listen_tag) {
+                accept_clients();
+            } else if(tag == wake_tag) {
+                uint64_t n;
+                while(::read(wake_fd, &n, sizeof(n)) > 0);
+            } else if(tag & snapshot_tag) {
+                if(!read_snapshot(tag & ~snapshot_tag))
+                    close_client(tag & ~snapshot_tag);
+            } else if(events[i].events & (EPOLLERR | EPOLLHUP)) {
+                close_client(tag);
+            } else if((events[i].events & EPOLLIN) && !read_client(tag)) {
+                close_client(tag);
             }
-            print_info("New client connection established");
-            cl.is_connected = true;
+        }
+        check_snapshots();
+#elif defined windows
+    // Windows has no epoll, so the sockets are polled instead
+    std::vector<WSAPOLLFD> pfds;
+    std::vector<size_t> pfd_clients;
+    while(run) {
+        pfds.clear();
+        pfd_clients.clear();
 
-            Nation* selected_nation = nullptr;
-            Packet packet = Packet(conn_fd);
+        WSAPOLLFD pfd = {};
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfds.push_back(pfd);
+        for(size_t i = 0; i < (size_t)n_clients; i++) {
+            if(!clients[i].is_connected)
+                continue;
             
-            // Send the whole snapshot of the world
-            {
-                Archive ar = Archive();
-                g_world->world_mutex.lock();
-                ::serialize(ar, g_world);
-                g_world->world_mutex.unlock();
-                packet.send(ar.get_buffer(), ar.size());
+            pfd.fd = clients[i].fd;
+            pfd.events = POLLIN | (clients[i].wants_write ? POLLOUT : 0);
+            pfds.push_back(pfd);
+            pfd_clients.push_back(i);
+        }
+
+        WSAPoll(pfds.data(), pfds.size(), 10);
+        if(pfds[0].revents & POLLIN)
+            accept_clients();
+        
+        for(size_t i = 1; i < pfds.size(); i++) {
+            const size_t id = pfd_clients[i - 1];
+            if(pfds[i].revents & (POLLERR | POLLHUP)) {
+                close_client(id);
+            } else if((pfds[i].revents & POLLIN) && !read_client(id)) {
+                close_client(id);
             }
+        }
+#endif
 
-            // Read the data from client
-            {
-                Archive ar = Archive();
-                packet.recv();
-                ar.set_buffer(packet.data(), packet.size());
+        // Send the queued packets and close the connections the simulation asked to close
+        for(size_t i = 0; i < (size_t)n_clients; i++) {
+            ServerClient& cl = clients[i];
+            if(!cl.is_connected)
+                continue;
+            
+            if(cl.is_closing || !write_client(i))
+                close_client(i);
+        }
+    }
+}
 
-                ActionType action;
-                ::deserialize(ar, &action);
-                ::deserialize(ar, &cl.username);
+// Accepts all the pending connections, each one takes a free slot
+void Server::accept_clients(void) {
+    while(run) {
+        sockaddr_in client;
+        socklen_t len = sizeof(client);
+        auto conn_fd = accept(fd, (sockaddr *)&client, &len);
+        if(conn_fd == INVALID_SOCKET)
+            break;
+        
+        size_t id = 0;
+        while(id < (size_t)n_clients && clients[id].is_connected)
+            id++;
+
+        if(id == (size_t)n_clients) {
+            print_error("Server is full, connection refused");
+            close_socket(conn_fd);
+            continue;
+        }
+        set_nonblocking(conn_fd);
+
+        ServerClient& cl = clients[id];
+        cl.fd = conn_fd;
+        cl.reader.clear();
+        cl.out_packets.clear();
+        cl.out_offset = 0;
+        cl.wants_write = false;
+        cl.is_closing = false;
+        cl.is_loading = false;
+        cl.has_snapshot = false;
+        {
+            const std::lock_guard<std::mutex> lock(cl.packets_mutex);
+            cl.packets.clear();
+            cl.packets_size = 0;
+        }
+        cl.conn_id = next_conn_id++;
+
+#ifdef unix
+        cl.wants_snapshot = false;
+
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = id;
+        if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, conn_fd, &event) != 0) {
+            print_error("Cannot add client to epoll");
+            close_socket(conn_fd);
+            continue;
+        }
+#endif
+        cl.features = 0;
+        cl.is_connected = true;
+        print_info("New client connection established");
+    }
+}
+
+/**
+ * Reads everything the client has sent, the complete packets are queued for the
+ * simulation thread and the incomplete ones are kept until the rest arrives. Returns
+ * false if the connection was closed or the client sent garbage
+ */
+bool Server::read_client(size_t id) {
+    ServerClient& cl = clients[id];
+    while(true) {
+        const int r = cl.reader.fill(cl.fd);
+        if(r > 0)
+            continue;
+
+        // Closed by the client
+        if(r == 0)
+            return false;
+        
+        if(would_block())
+            break;
+        return false;
+    }
+
+    try {
+        const std::lock_guard<std::mutex> lock(actions_mutex);
+        while(true) {
+            Packet packet = Packet();
+            if(!free_packets.empty()) {
+                packet = std::move(free_packets.back());
+                free_packets.pop_back();
+            }
+
+            if(!cl.reader.next(packet)) {
+                free_packets.push_back(std::move(packet));
+                break;
             }
+            if(!packet.size())
+                throw SocketException("Empty packet");
+
+            actions.push_back(ClientAction());
+            ClientAction& action = actions.back();
+            action.client = id;
+            action.conn_id = cl.conn_id;
+            action.packet = std::move(packet);
+        }
+    } catch(SocketException& e) {
+        print_error("Client %zu sent garbage: %s", id, e.what());
+        return false;
+    }
+    return true;
+}
 
-            // Tell all other clients about the connection of this new client
-            {
-                Archive ar = Archive();
-                ActionType action = ActionType::CONNECT;
-                ::serialize(ar, &action);
-                packet.data(ar.get_buffer(), ar.size());
-                broadcast(packet);
+/**
+ * Sends as much of the queued packets as the socket takes without blocking, the packets
+ * are gathered on vectored writes. If something is left the I/O thread waits for the
+ * socket to be writable. Returns false if the connection failed
+ */
+bool Server::write_client(size_t id) {
+    ServerClient& cl = clients[id];
+
+    // Nothing can be sent before the snapshot
+    if(cl.is_loading)
+        return true;
+
+    while(true) {
+        // Packets are still accounted on the quota until they are sent
+        if(cl.out_packets.size() < max_packets_per_write) {
+            const std::lock_guard<std::mutex> lock(cl.packets_mutex);
+            while(!cl.packets.empty() && cl.out_packets.size() < max_packets_per_write) {
+                cl.out_packets.push_back(std::move(cl.packets.front()));
+                cl.packets.pop_front();
             }
+        }
+
+        if(cl.out_packets.empty())
+            break;
+
+        const Packet* packets[max_packets_per_write];
+        for(size_t i = 0; i < cl.out_packets.size(); i++) {
+            packets[i] = cl.out_packets[i].get();
+        }
+
+        const long r = SocketStream(cl.fd).send_packets(packets, cl.out_packets.size(), cl.out_offset);
+        if(r <= 0) {
+            if(r < 0 && !would_block())
+                return false;
             
-            ActionType action = ActionType::PING;
-            packet.send(&action);
+            // Continue once the socket is writable again
+            set_write_interest(id, true);
+            return true;
+        }
+
+        // Drop the packets that were completely sent
+        size_t sent = cl.out_offset + (size_t)r;
+        size_t sent_size = 0;
+        while(!cl.out_packets.empty()) {
+            const size_t packet_size = packet_header_size + cl.out_packets.front()->size() + packet_trailer_size;
+            if(sent < packet_size)
+                break;
+            
+            sent -= packet_size;
+            sent_size += cl.out_packets.front()->buffer.size();
+            cl.out_packets.pop_front();
+        }
+        cl.out_offset = sent;
+
+        const std::lock_guard<std::mutex> lock(cl.packets_mutex);
+        cl.packets_size -= std::min(cl.packets_size, sent_size);
+    }
+    set_write_interest(id, false);
+    return true;
+}
+
+void Server::set_write_interest(size_t id, bool wants_write) {
+    ServerClient& cl = clients[id];
+    if(cl.wants_write == wants_write)
+        return;
+    
+    cl.wants_write = wants_write;
 #ifdef unix
-            struct pollfd pfd = {};
-            pfd.fd = conn_fd;
-            pfd.events = POLLIN;
+    epoll_event event = {};
+    event.events = EPOLLIN | (wants_write ? EPOLLOUT : 0);
+    event.data.u64 = id;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, cl.fd, &event);
 #endif
-            // TODO: The world mutex is not properly unlocked when an exception occours
-            // this allows clients to abruptly disconnect and softlock a server
-            // so we did this little trick of manually unlocking - but this is a bad idea
-            // we need to use RAII to just unlock the thing on destruction *(specifically when
-            // an exception is thrown), since we are using C++
-            Archive ar = Archive();
-            while(run && cl.is_connected == true) {
-                // Check if we need to read stuff
+}
+
+void Server::close_client(size_t id) {
+    ServerClient& cl = clients[id];
+    if(!cl.is_connected)
+        return;
+
 #ifdef unix
-                int has_pending = poll(&pfd, 1, 0);
-                if(pfd.revents & POLLIN || has_pending && g_world->world_mutex.try_lock() == true) {
-#elif defined windows
-                u_long has_pending = 0;
-                ioctlsocket(fd, FIONREAD, &has_pending);
-                if(has_pending && g_world->world_mutex.try_lock() == true) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, cl.fd, nullptr);
 #endif
-                    packet.recv();
-                    ar.set_buffer(packet.data(), packet.size());
-                    ar.rewind();
-                    ::deserialize(ar, &action);
-
-                    if(selected_nation == nullptr &&
-                    (action != ActionType::PONG && action != ActionType::CHAT_MESSAGE && action != ActionType::SELECT_NATION))
-                        throw ServerException("Unallowed operation without selected nation");
-                    
-                    const std::lock_guard<std::recursive_mutex> lock(g_world->world_mutex);
-                    switch(action) {
-                    /// - Used to test connections between server and client
-                    case ActionType::PONG:
-                        action = ActionType::PING;
-                        packet.send(&action);
-                        print_info("Received pong, responding with ping!");
-                        break;
-                    /// - Client tells server to enact a new policy for it's nation
-                    case ActionType::NATION_ENACT_POLICY: {
-                        Policies policies;
-                        ::deserialize(ar, &policies);
-
-                        // TODO: Do parliament checks and stuff
-                        selected_nation->current_policy = policies;
-                    } break;
-                    /// - Client tells server to change target of unit
-                    case ActionType::UNIT_CHANGE_TARGET: {
-                        Unit* unit;
-                        ::deserialize(ar, &unit);
-                        if(unit == nullptr)
-                            throw ServerException("Unknown unit");
-
-                        // Must control unit
-                        if(selected_nation != unit->owner)
-                            throw ServerException("Nation does not control unit");
-                        
-                        ::deserialize(ar, &unit->tx);
-                        ::deserialize(ar, &unit->ty);
-
-                        if(unit->tx >= g_world->width || unit->ty >= g_world->height)
-                            throw ServerException("Coordinates out of range for unit");
-                        
-                        print_info("Unit changes targets to %zu.%zu", (size_t)unit->tx, (size_t)unit->ty);
-                    } break;
-                    /// - Client tells server to change target of boat
-                    case ActionType::BOAT_CHANGE_TARGET: {
-                        Boat* boat;
-                        ::deserialize(ar, &boat);
-                        if(boat == nullptr)
-                            throw ServerException("Unknown boat");
-
-                        // Must control boat
-                        if(selected_nation != boat->owner)
-                            throw ServerException("Nation does not control boat");
-                        
-                        ::deserialize(ar, &boat->tx);
-                        ::deserialize(ar, &boat->ty);
-
-                        if(boat->tx >= g_world->width || boat->ty >= g_world->height)
-                            throw ServerException("Coordinates out of range for boat");
-                        
-                        print_info("Boat changes targets to %zu.%zu", (size_t)boat->tx, (size_t)boat->ty);
-                    } break;
-                    // Client tells the server about the construction of a new unit, note that this will
-                    // only make the building submit "construction tickets" to obtain materials to build
-                    // the unit can only be created by the server, not by the clients
-                    case ActionType::BUILDING_START_BUILDING_UNIT: {
-                        Building* building;
-                        ::deserialize(ar, &building);
-                        if(building == nullptr)
-                            throw ServerException("Unknown building");
-                        
-                        UnitType* unit_type;
-                        ::deserialize(ar, &unit_type);
-                        if(unit_type == nullptr)
-                            throw ServerException("Unknown unit type");
-                        
-                        // Must control building
-                        if(building->owner != selected_nation)
-                            throw ServerException("Nation does not control building");
-                        
-                        // TODO: Check nation can build this unit
-
-                        // Tell the building to build this specific unit type
-                        building->working_unit_type = unit_type;
-                        building->req_goods_for_unit = unit_type->req_goods;
-                        print_info("New order for building; build unit %s", unit_type->name.c_str());
-                    } break;
-                    // - Same as before but with boats
-                    case ActionType::BUILDING_START_BUILDING_BOAT: {
-                        Building* building;
-                        ::deserialize(ar, &building);
-                        if(building == nullptr)
-                            throw ServerException("Unknown building");
-                        
-                        BoatType* boat_type;
-                        ::deserialize(ar, &boat_type);
-                        if(boat_type == nullptr)
-                            throw ServerException("Unknown boat type");
-                        
-                        // Must control building
-                        if(building->owner != selected_nation)
-                            throw ServerException("Nation does not control building");
-
-                        // Tell the building to build this specific unit type
-                        building->working_boat_type = boat_type;
-                        building->req_goods_for_boat = boat_type->req_goods;
-                        print_info("New order for building; build boat %s", boat_type->name.c_str());
-                    } break;
-                    // Client tells server to build new outpost, the location (& type) is provided by
-                    // the client and the rest of the fields are filled by the server
-                    case ActionType::BUILDING_ADD: {
-                        Building* building = new Building();
-                        ::deserialize(ar, building);
-                        if(building->type == nullptr)
-                            throw ServerException("Unknown building type");
-
-                        // Modify the serialized building
-                        ar.ptr -= ::serialized_size(building);
-                        building->owner = selected_nation;
-
-                        // Check that it's not out of bounds
-                        if(building->x >= g_world->width || building->y >= g_world->height)
-                            throw ServerException("building out of range");
-                        
-                        // Building can only be built on owned land or on shores
-                        if(g_world->get_tile(building->x, building->y).owner_id != g_world->get_id(selected_nation)
-                        && g_world->get_tile(building->x, building->y).elevation > g_world->sea_level)
-                            throw ServerException("Building cannot be built on foreign land");
-
-                        building->working_unit_type = nullptr;
-                        building->working_boat_type = nullptr;
-                        building->req_goods_for_unit = std::vector<std::pair<Good*, size_t>>();
-                        building->req_goods = std::vector<std::pair<Good*, size_t>>();
-                        ::serialize(ar, building);
-
-                        g_world->buildings.push_back(building);
-                        print_info("New building of %s", building->owner->name.c_str());
-                        // Rebroadcast
-                        broadcast(packet);
-                    } break;
-                    // Client tells server that it wants to colonize a province, this can be rejected
-                    // or accepted, client should check via the next PROVINCE_UPDATE action
-                    case ActionType::PROVINCE_COLONIZE: {
-                        Province* province;
-                        ::deserialize(ar, &province);
-
-                        if(province == nullptr)
-                            throw ServerException("Unknown province");
-
-                        // Must not be already owned
-                        if(province->owner != nullptr)
-                            throw ServerException("Province already has an owner");
-
-                        province->owner = selected_nation;
-                        
-                        // Rebroadcast
-                        broadcast(packet);
-                    } break;
-                    // Simple IRC-like chat messaging system
-                    case ActionType::CHAT_MESSAGE: {
-                        std::string msg;
-                        ::deserialize(ar, &msg);
-                        print_info("Message: %s\n", msg.c_str());
-
-                        // Rebroadcast
-                        broadcast(packet);
-                    } break;
-                    // Client changes it's approval on certain treaty
-                    case ActionType::CHANGE_TREATY_APPROVAL: {
-                        Treaty* treaty;
-                        ::deserialize(ar, &treaty);
-                        if(treaty == nullptr)
-                            throw ServerException("Treaty not found");
-                            
-                        TreatyApproval approval;
-                        ::deserialize(ar, &approval);
-
-                        print_info("%s approves treaty %s? %s", selected_nation->name.c_str(), treaty->name.c_str(), (approval == TreatyApproval::ACCEPTED) ? "YES" : "NO");
-                            
-                        // Check that the nation participates in the treaty
-                        bool does_participate = false;
-                        for(auto& status: treaty->approval_status) {
-                            if(status.first == selected_nation) {
-                                // Alright, then change approval
-                                status.second = approval;
-                                does_participate = true;
-                                break;
-                            }
-                        }
-                        if(!does_participate)
-                            throw ServerException("Nation does not participate in treaty");
-                        
-                        // Rebroadcast
-                        broadcast(packet);
-                    } break;
-                    // Client sends a treaty to someone
-                    case ActionType::DRAFT_TREATY: {
-                        Treaty* treaty = new Treaty();
-                        ::deserialize(ar, &treaty->clauses);
-                        ::deserialize(ar, &treaty->name);
-                        ::deserialize(ar, &treaty->sender);
-
-                        // Validate data
-                        if(!treaty->clauses.size())
-                            throw ServerException("Clause-less treaty");
-                        if(treaty->sender == nullptr)
-                            throw ServerException("Treaty has invalid ends");
-                        
-                        // Obtain participants of the treaty
-                        std::set<Nation*> approver_nations = std::set<Nation*>();
-                        for(auto& clause: treaty->clauses) {
-                            if(clause->receiver == nullptr || clause->sender == nullptr)
-                                throw ServerException("Invalid clause receiver/sender");
-                            
-                            approver_nations.insert(clause->receiver);
-                            approver_nations.insert(clause->sender);
-                        }
-
-                        print_info("Participants of treaty %s", treaty->name.c_str());
-                        // Then fill as undecided (and ask nations to sign this treaty)
-                        for(auto& nation: approver_nations) {
-                            treaty->approval_status.push_back(std::make_pair(nation, TreatyApproval::UNDECIDED));
-                            print_info("- %s", nation->name.c_str());
-                        }
-
-                        // The sender automatically accepts the treaty (they are the ones who drafted it)
-                        for(auto& status: treaty->approval_status) {
-                            if(status.first == selected_nation) {
-                                status.second = TreatyApproval::ACCEPTED;
-                                break;
-                            }
-                        }
-
-                        g_world->treaties.push_back(treaty);
-
-                        // Rebroadcast to client
-                        // We are going to add a treaty to the client
-                        Archive tmp_ar = Archive();
-                        action = ActionType::TREATY_ADD;
-                        ::serialize(tmp_ar, &action);
-                        ::serialize(tmp_ar, treaty);
-                        packet.data(tmp_ar.get_buffer(), tmp_ar.size());
-                        broadcast(packet);
-                    } break;
-                    // Client takes a descision
-                    case ActionType::NATION_TAKE_DESCISION: {
-                        // Find event by reference name
-                        std::string event_ref_name;
-                        ::deserialize(ar, &event_ref_name);
-                        auto event = std::find_if(g_world->events.begin(), g_world->events.end(),
-                        [&event_ref_name](const Event* e) {
-                            return e->ref_name == event_ref_name;
-                        });
-                        if(event == g_world->events.end()) {
-                            throw ServerException("Event not found");
-                        }
-                        
-                        // Find descision by reference name
-                        std::string descision_ref_name;
-                        ::deserialize(ar, &descision_ref_name);
-                        auto descision = std::find_if((*event)->descisions.begin(), (*event)->descisions.end(),
-                        [&descision_ref_name](const Descision& e) {
-                            return e.ref_name == descision_ref_name;
-                        });
-                        if(descision == (*event)->descisions.end()) {
-                            throw ServerException("Descision not found");
-                        }
-
-                        (*event)->take_descision(selected_nation, &(*descision));
-                        print_info("Event %s + descision %s taken by %s",
-                            event_ref_name.c_str(),
-                            descision_ref_name.c_str(),
-                            selected_nation->ref_name.c_str()
-                        );
-                    } break;
-                    // The client selects a nation
-                    case ActionType::SELECT_NATION: {
-                        Nation* nation;
-                        ::deserialize(ar, &nation);
-                        if(nation == nullptr)
-                            throw ServerException("Unknown nation");
-                        selected_nation = nation;
-                        selected_nation->is_ai = false;
-                        print_info("Nation %s selected by client %zu", selected_nation->name.c_str(), (size_t)id);
-                    } break;
-                    // Nation and province addition and removals are not allowed to be done by clients
-                    default:
-                        break;
-                    }
-                }
-
-                ar.buffer.clear();
-                ar.rewind();
-                
-                // After reading everything we will send our queue appropriately to the client
-                const std::lock_guard<std::mutex> lock(cl.packets_mutex);
-                while(cl.packets.empty() == false) {
-                    Packet elem = cl.packets.front();
-                    elem.stream = SocketStream(conn_fd);
-                    elem.send();
-                    cl.packets.pop_front();
-                }
-            }
-        } catch(ServerException& e) {
-            print_error("ServerException: %s", e.what());
-        } catch(SocketException& e) {
-            print_error("SocketException: %s", e.what());
-            g_world->world_mutex.unlock();
-        } catch(SerializerException& e) {
-            print_error("SerializerException: %s", e.what());
-            g_world->world_mutex.unlock();
-        }
-        
-        // Unlock mutexes so we don't end up with weird situations... like deadlocks
+    close_socket(cl.fd);
+    cl.fd = INVALID_SOCKET;
+    {
+        const std::lock_guard<std::mutex> lock(cl.packets_mutex);
+        cl.has_snapshot = false;
         cl.is_connected = false;
         cl.packets.clear();
-        cl.packets_mutex.unlock();
+        cl.packets_size = 0;
+    }
+#ifdef unix
+    cancel_snapshot(id);
+#endif
+    cl.out_packets.clear();
+    cl.reader.clear();
+    cl.wants_write = false;
+    print_info("Client disconnected");
+
+    // Tell the remaining clients about the disconnection
+    Packet packet = Packet();
+    Archive ar = Archive();
+    ActionType action = ActionType::DISCONNECT;
+    ::serialize(ar, &action);
+    packet.data(ar.get_buffer(), ar.size());
+    broadcast(packet);
+}
+
+/**
+ * Handles the packets received from the clients (and gives the snapshot of the world to
+ * the clients that joined), clients that send invalid actions are disconnected
+ */
+void Server::process_actions(void) {
+#ifdef unix
+    // Snapshots the I/O thread gave up on are made here
+    for(size_t i = 0; i < (size_t)n_clients; i++) {
+        if(clients[i].wants_snapshot.exchange(false)) {
+            const std::lock_guard<std::recursive_mutex> lock(g_world->world_mutex);
+            send_snapshot_in_process(i);
+        }
+    }
+#endif
+
+    std::deque<ClientAction> pending;
+    {
+        const std::lock_guard<std::mutex> lock(actions_mutex);
+        pending.swap(actions);
+    }
+    if(pending.empty())
+        return;
+
+    {
+        const std::lock_guard<std::recursive_mutex> lock(g_world->world_mutex);
+        for(auto& action: pending) {
+            ServerClient& cl = clients[action.client];
+
+            // The connection was closed (and the slot maybe reused) after the action was received
+            if(cl.conn_id != action.conn_id || !cl.is_connected || cl.is_closing)
+                continue;
+
+            try {
+                handle_action(action.client, action.packet);
+            } catch(ServerException& e) {
+                print_error("ServerException: %s", e.what());
+                cl.is_closing = true;
+                wake();
+            } catch(SerializerException& e) {
+                print_error("SerializerException: %s", e.what());
+                cl.is_closing = true;
+                wake();
+            }
+        }
+    }
 
-        // Tell the remaining clients about the disconnection
+    // Give the packets back for receiving the next actions, big ones are freed instead
+    // so a single big action does not keep it's memory forever
+    const std::lock_guard<std::mutex> lock(actions_mutex);
+    for(auto& action: pending) {
+        if(free_packets.size() >= max_free_packets)
+            break;
+        if(action.packet.buffer.capacity() <= max_free_packet_size)
+            free_packets.push_back(std::move(action.packet));
+    }
+}
+
+void Server::disconnect_clients(void) {
+    for(size_t i = 0; i < (size_t)n_clients; i++) {
+        ServerClient& cl = clients[i];
+        if(!cl.is_connected)
+            continue;
+
+        // Their nations and everything they were sent belong to the previous world
+        cl.has_snapshot = false;
+        cl.selected_nation = nullptr;
+        cl.is_closing = true;
+    }
+
+    // Objects were replicated as deltas against the previous world
+    snapshot_generation++;
+    wake();
+}
+
+// Serializes the world with the given tiles (see Serializer<World>::get_tiles) onto a
+// packet, compressed if the client supports it. Nothing here takes a lock (besides the
+// allocator, which is reset by fork) so it can be done by the child of a fork
+static std::shared_ptr<Packet> make_snapshot(uint32_t features, const Tile* tiles) {
+    Archive ar = Archive();
+    ar.reserve(Serializer<World>::size(g_world, tiles));
+    Serializer<World>::serialize(ar, g_world, tiles);
+
+    std::shared_ptr<Packet> packet = std::make_shared<Packet>();
+    packet->data(ar.get_buffer(), ar.size());
+    if(features & NET_FEATURE_DEFLATE) {
+        std::shared_ptr<Packet> compressed = std::make_shared<Packet>();
+        if(deflate_packet(*packet, *compressed, Z_DEFAULT_COMPRESSION))
+            packet = compressed;
+    }
+    return packet;
+}
+
+#ifdef unix
+/**
+ * Queues the snapshot of the world as the first packet of the client. The process is
+ * forked so the child serializes the world as it is now (the pages are copied by the
+ * system only when the simulation modifies them) while the simulation keeps running.
+ * The child writes the packet (code and data) on a pipe read by the I/O thread, and the
+ * broadcasts done meanwhile are queued after it
+ */
+void Server::send_snapshot(size_t id) {
+    ServerClient& cl = clients[id];
+    const uint64_t conn_id = cl.conn_id;
+
+    // Taking the published tiles locks, so it's done before forking
+    std::shared_ptr<const std::vector<Tile>> tiles_snapshot;
+    const Tile* tiles = Serializer<World>::get_tiles(g_world, tiles_snapshot);
+
+    int pipe_fds[2];
+    if(pipe(pipe_fds) != 0)
+        throw ServerException("Cannot create pipe for the snapshot");
+
+    pid_t pid;
+    {
+        ProfileTimer timer("Fork world");
+        pid = fork();
+    }
+    if(pid < 0) {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        throw ServerException("Cannot fork for the snapshot");
+    } else if(pid == 0) {
+        // Only this thread exists on the child, the locks other threads held when forking
+        // are never released here, so nothing that locks can be called (not even prints)
+        close(pipe_fds[0]);
+        std::shared_ptr<Packet> packet = make_snapshot(cl.features, tiles);
+        const uint32_t code = static_cast<uint32_t>(packet->get_code());
+        bool ok = ::write(pipe_fds[1], &code, sizeof(code)) == sizeof(code);
+        for(size_t i = 0; ok && i < packet->size(); ) {
+            const ssize_t r = ::write(pipe_fds[1], &packet->buffer[i], packet->size() - i);
+            ok = r > 0;
+            i += ok ? (size_t)r : 0;
+        }
+        _exit(ok ? 0 : 1);
+    }
+    close(pipe_fds[1]);
+    set_nonblocking(pipe_fds[0]);
+
+    {
+        const std::lock_guard<std::mutex> lock(cl.packets_mutex);
+
+        // The I/O thread closed the connection while forking
+        if(!cl.is_connected || cl.conn_id != conn_id) {
+            close(pipe_fds[0]);
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+            return;
+        }
+
+        cl.snapshot_fd = pipe_fds[0];
+        cl.snapshot_pid = pid;
+        cl.snapshot_start = std::chrono::steady_clock::now();
+        cl.snapshot_data.clear();
+        cl.is_loading = true;
+        cl.has_snapshot = true;
+
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = id | snapshot_tag;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, cl.snapshot_fd, &event);
+    }
+    snapshot_generation++;
+}
+
+/**
+ * Reads what the child making the snapshot of the client wrote, once it's done the
+ * snapshot is put before the packets queued meanwhile. Returns false if making the
+ * snapshot failed
+ */
+bool Server::read_snapshot(size_t id) {
+    ServerClient& cl = clients[id];
+    while(true) {
+        const size_t size = cl.snapshot_data.size();
+        cl.snapshot_data.resize(size + 65536);
+        const ssize_t r = ::read(cl.snapshot_fd, &cl.snapshot_data[size], 65536);
+        cl.snapshot_data.resize(size + std::max<ssize_t>(r, 0));
+        if(r > 0)
+            continue;
+
+        if(r < 0 && (errno == EAGAIN || errno == EINTR))
+            return true;
+        break;
+    }
+
+    // The child is done
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, cl.snapshot_fd, nullptr);
+    close(cl.snapshot_fd);
+    cl.snapshot_fd = -1;
+    int status;
+    waitpid(cl.snapshot_pid, &status, 0);
+    cl.snapshot_pid = -1;
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != 0 || cl.snapshot_data.size() < sizeof(uint32_t)) {
+        print_error("Cannot make the snapshot for client %zu", id);
+        return false;
+    }
+
+    uint32_t code;
+    std::memcpy(&code, cl.snapshot_data.data(), sizeof(code));
+    std::shared_ptr<Packet> packet = std::make_shared<Packet>();
+    packet->resize(cl.snapshot_data.size() - sizeof(code), static_cast<PacketCode>(code));
+    std::memcpy(packet->buffer.data(), &cl.snapshot_data[sizeof(code)], packet->size());
+    std::vector<uint8_t>().swap(cl.snapshot_data);
+    {
+        const std::lock_guard<std::mutex> lock(cl.packets_mutex);
+        cl.packets.push_front(packet);
+        cl.packets_size += packet->buffer.size();
+        cl.is_loading = false;
+    }
+    return true;
+}
+
+// Kills the process making the snapshot of the client (if there is one)
+void Server::stop_snapshot(size_t id) {
+    ServerClient& cl = clients[id];
+    if(cl.snapshot_fd != -1) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, cl.snapshot_fd, nullptr);
+        close(cl.snapshot_fd);
+        cl.snapshot_fd = -1;
+    }
+    if(cl.snapshot_pid != -1) {
+        kill(cl.snapshot_pid, SIGKILL);
+        waitpid(cl.snapshot_pid, nullptr, 0);
+        cl.snapshot_pid = -1;
+    }
+    std::vector<uint8_t>().swap(cl.snapshot_data);
+}
+
+// Stops making the snapshot of the client (if it's being made)
+void Server::cancel_snapshot(size_t id) {
+    stop_snapshot(id);
+    clients[id].is_loading = false;
+}
+
+// Kills the processes that are taking too long to make a snapshot (they may be stuck),
+// the client keeps loading until the simulation thread makes the snapshot instead
+void Server::check_snapshots(void) {
+    const auto now = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < (size_t)n_clients; i++) {
+        ServerClient& cl = clients[i];
         {
-            Packet packet;
-            Archive ar = Archive();
-            ActionType action = ActionType::DISCONNECT;
-            ::serialize(ar, &action);
-            packet.data(ar.get_buffer(), ar.size());
-            broadcast(packet);
+            const std::lock_guard<std::mutex> lock(cl.packets_mutex);
+            if(cl.snapshot_pid == -1 || now - cl.snapshot_start < snapshot_timeout)
+                continue;
         }
 
-        print_info("Client disconnected");
-#ifdef windows
-        shutdown(conn_fd, SD_BOTH);
-#elif defined unix
-        shutdown(conn_fd, SHUT_RDWR);
+        print_error("Snapshot for client %zu timed out, making it on the server", i);
+        stop_snapshot(i);
+        cl.wants_snapshot = true;
+    }
+}
+
+/**
+ * Queues the snapshot of the world made by this thread, for a client whose snapshot
+ * process was stopped. The packets queued since the fork are about an older state than
+ * this snapshot, so they are dropped. The world must be locked
+ */
+void Server::send_snapshot_in_process(size_t id) {
+    ServerClient& cl = clients[id];
+    if(!cl.is_connected || cl.is_closing || !cl.has_snapshot || !cl.is_loading)
+        return;
+
+    std::shared_ptr<Packet> packet;
+    {
+        ProfileTimer timer("Serialize world");
+        std::shared_ptr<const std::vector<Tile>> tiles_snapshot;
+        packet = make_snapshot(cl.features, Serializer<World>::get_tiles(g_world, tiles_snapshot));
+    }
+    {
+        const std::lock_guard<std::mutex> lock(cl.packets_mutex);
+        for(const auto& dropped: cl.packets) {
+            cl.packets_size -= dropped->buffer.size();
+        }
+        cl.packets.clear();
+        cl.deferred.clear();
+        cl.packets.push_front(packet);
+        cl.packets_size += packet->buffer.size();
+        cl.is_loading = false;
+    }
+    snapshot_generation++;
+    wake();
+}
+#elif defined windows
+// Queues the whole snapshot of the world as the first packet of the client, there is no
+// fork on Windows so the simulation waits for the world to be serialized
+void Server::send_snapshot(size_t id) {
+    ServerClient& cl = clients[id];
+
+    std::shared_ptr<Packet> packet;
+    {
+        ProfileTimer timer("Serialize world");
+        std::shared_ptr<const std::vector<Tile>> tiles_snapshot;
+        packet = make_snapshot(cl.features, Serializer<World>::get_tiles(g_world, tiles_snapshot));
+    }
+    {
+        const std::lock_guard<std::mutex> lock(cl.packets_mutex);
+        cl.packets.push_front(packet);
+        cl.packets_size += packet->buffer.size();
+        cl.has_snapshot = true;
+    }
+    snapshot_generation++;
+    wake();
+}
 #endif
+
+/**
+ * Handles an action sent by a client, the world must be locked
+ */
+void Server::handle_action(size_t id, Packet& packet) {
+    ServerClient& cl = clients[id];
+    Nation*& selected_nation = cl.selected_nation;
+
+    // The packet is read in place, it's only modified after everything was read
+    Archive ar = Archive();
+    ar.set_view(packet.buffer.data(), packet.size());
+
+    ActionType action;
+    ::deserialize(ar, &action);
+
+    // The client must tell who it is (only once) before doing anything else
+    if(action == ActionType::CONNECT && cl.has_snapshot)
+        throw ServerException("Client is already connected");
+    if(action != ActionType::CONNECT && !cl.has_snapshot)
+        throw ServerException("Unallowed operation before connecting");
+
+    if(selected_nation == nullptr &&
+    (action != ActionType::CONNECT && action != ActionType::PONG && action != ActionType::CHAT_MESSAGE && action != ActionType::SELECT_NATION && action != ActionType::CLIENT_VIEWPORT))
+        throw ServerException("Unallowed operation without selected nation");
+
+    switch(action) {
+    /// - Client tells it's username and the features it supports, then it receives the
+    /// snapshot of the world
+    case ActionType::CONNECT: {
+        ::deserialize(ar, &cl.username);
+        uint32_t features;
+        ::deserialize(ar, &features);
+        cl.features = features;
+        selected_nation = nullptr;
+        cl.has_viewport = false;
+        cl.deferred.clear();
+        send_snapshot(id);
+
+        // Tell all other clients about the connection of this new client
+        Archive tmp_ar = Archive();
+        ::serialize(tmp_ar, &action);
+        packet.data(tmp_ar.get_buffer(), tmp_ar.size());
+        broadcast(packet);
+
+        action = ActionType::PING;
+        packet.data(&action, sizeof(action));
+        send_to(id, packet);
+    } break;
+    /// - Client tells the area of the map it's looking at
+    case ActionType::CLIENT_VIEWPORT: {
+        ::deserialize(ar, &cl.view_min_x);
+        ::deserialize(ar, &cl.view_min_y);
+        ::deserialize(ar, &cl.view_max_x);
+        ::deserialize(ar, &cl.view_max_y);
+        cl.has_viewport = true;
+    } break;
+    /// - Used to test connections between server and client
+    case ActionType::PONG:
+        action = ActionType::PING;
+        packet.data(&action, sizeof(action));
+        send_to(id, packet);
+        print_info("Received pong, responding with ping!");
+        break;
+    /// - Client tells server to enact a new policy for it's nation
+    case ActionType::NATION_ENACT_POLICY: {
+        Policies policies;
+        ::deserialize(ar, &policies);
+
+        // TODO: Do parliament checks and stuff
+        selected_nation->current_policy = policies;
+    } break;
+    /// - Client tells server to change target of unit
+    case ActionType::UNIT_CHANGE_TARGET: {
+        Unit* unit;
+        ::deserialize(ar, &unit);
+        if(unit == nullptr)
+            throw ServerException("Unknown unit");
+
+        // Must control unit
+        if(selected_nation != unit->owner)
+            throw ServerException("Nation does not control unit");
+        
+        ::deserialize(ar, &unit->tx);
+        ::deserialize(ar, &unit->ty);
+
+        if(unit->tx >= g_world->width || unit->ty >= g_world->height)
+            throw ServerException("Coordinates out of range for unit");
+        
+        print_info("Unit changes targets to %zu.%zu", (size_t)unit->tx, (size_t)unit->ty);
+    } break;
+    /// - Client tells server to change target of boat
+    case ActionType::BOAT_CHANGE_TARGET: {
+        Boat* boat;
+        ::deserialize(ar, &boat);
+        if(boat == nullptr)
+            throw ServerException("Unknown boat");
+
+        // Must control boat
+        if(selected_nation != boat->owner)
+            throw ServerException("Nation does not control boat");
+        
+        ::deserialize(ar, &boat->tx);
+        ::deserialize(ar, &boat->ty);
+
+        if(boat->tx >= g_world->width || boat->ty >= g_world->height)
+            throw ServerException("Coordinates out of range for boat");
+        
+        print_info("Boat changes targets to %zu.%zu", (size_t)boat->tx, (size_t)boat->ty);
+    } break;
+    // Client tells the server about the construction of a new unit, note that this will
+    // only make the building submit "construction tickets" to obtain materials to build
+    // the unit can only be created by the server, not by the clients
+    case ActionType::BUILDING_START_BUILDING_UNIT: {
+        Building* building;
+        ::deserialize(ar, &building);
+        if(building == nullptr)
+            throw ServerException("Unknown building");
+        
+        UnitType* unit_type;
+        ::deserialize(ar, &unit_type);
+        if(unit_type == nullptr)
+            throw ServerException("Unknown unit type");
+        
+        // Must control building
+        if(building->owner != selected_nation)
+            throw ServerException("Nation does not control building");
+        
+        // TODO: Check nation can build this unit
+
+        // Tell the building to build this specific unit type
+        building->working_unit_type = unit_type;
+        building->req_goods_for_unit = unit_type->req_goods;
+        print_info("New order for building; build unit %s", unit_type->name.c_str());
+    } break;
+    // - Same as before but with boats
+    case ActionType::BUILDING_START_BUILDING_BOAT: {
+        Building* building;
+        ::deserialize(ar, &building);
+        if(building == nullptr)
+            throw ServerException("Unknown building");
+        
+        BoatType* boat_type;
+        ::deserialize(ar, &boat_type);
+        if(boat_type == nullptr)
+            throw ServerException("Unknown boat type");
+        
+        // Must control building
+        if(building->owner != selected_nation)
+            throw ServerException("Nation does not control building");
+
+        // Tell the building to build this specific unit type
+        building->working_boat_type = boat_type;
+        building->req_goods_for_boat = boat_type->req_goods;
+        print_info("New order for building; build boat %s", boat_type->name.c_str());
+    } break;
+    // Client tells server to build new outpost, the location (& type) is provided by
+    // the client and the rest of the fields are filled by the server
+    case ActionType::BUILDING_ADD: {
+        Building* building = new Building();
+        ::deserialize(ar, building);
+        if(building->type == nullptr)
+            throw ServerException("Unknown building type");
+
+        building->owner = selected_nation;
+
+        // Check that it's not out of bounds
+        if(building->x >= g_world->width || building->y >= g_world->height)
+            throw ServerException("building out of range");
+        
+        // Building can only be built on owned land or on shores
+        if(g_world->get_tile(building->x, building->y).owner_id != g_world->get_id(selected_nation)
+        && g_world->get_tile(building->x, building->y).elevation > g_world->sea_level)
+            throw ServerException("Building cannot be built on foreign land");
+
+        building->working_unit_type = nullptr;
+        building->working_boat_type = nullptr;
+        building->req_goods_for_unit = std::vector<std::pair<Good*, size_t>>();
+        building->req_goods = std::vector<std::pair<Good*, size_t>>();
+
+        g_world->insert(building);
+        print_info("New building of %s", building->owner->name.c_str());
+
+        // Rebroadcast with the fields filled by the server
+        Archive tmp_ar = Archive();
+        ::serialize(tmp_ar, &action);
+        ::serialize(tmp_ar, building);
+        packet.data(tmp_ar.get_buffer(), tmp_ar.size());
+        broadcast(packet);
+    } break;
+    // Client tells server that it wants to colonize a province, this can be rejected
+    // or accepted, client should check via the next PROVINCE_UPDATE action
+    case ActionType::PROVINCE_COLONIZE: {
+        Province* province;
+        ::deserialize(ar, &province);
+
+        if(province == nullptr)
+            throw ServerException("Unknown province");
+
+        // Must not be already owned
+        if(province->owner != nullptr)
+            throw ServerException("Province already has an owner");
+
+        province->owner = selected_nation;
+        
+        // Rebroadcast
+        broadcast(packet);
+    } break;
+    // Simple IRC-like chat messaging system
+    case ActionType::CHAT_MESSAGE: {
+        std::string msg;
+        ::deserialize(ar, &msg);
+        print_info("Message: %s\n", msg.c_str());
+
+        // Rebroadcast
+        broadcast(packet);
+    } break;
+    // Client changes it's approval on certain treaty
+    case ActionType::CHANGE_TREATY_APPROVAL: {
+        Treaty* treaty;
+        ::deserialize(ar, &treaty);
+        if(treaty == nullptr)
+            throw ServerException("Treaty not found");
+            
+        TreatyApproval approval;
+        ::deserialize(ar, &approval);
+
+        print_info("%s approves treaty %s? %s", selected_nation->name.c_str(), treaty->name.c_str(), (approval == TreatyApproval::ACCEPTED) ? "YES" : "NO");
+            
+        // Check that the nation participates in the treaty
+        bool does_participate = false;
+        for(auto& status: treaty->approval_status) {
+            if(status.first == selected_nation) {
+                // Alright, then change approval
+                status.second = approval;
+                does_participate = true;
+                break;
+            }
+        }
+        if(!does_participate)
+            throw ServerException("Nation does not participate in treaty");
+        
+        // Rebroadcast
+        broadcast(packet);
+    } break;
+    // Client sends a treaty to someone
+    case ActionType::DRAFT_TREATY: {
+        Treaty* treaty = new Treaty();
+        ::deserialize(ar, &treaty->clauses);
+        ::deserialize(ar, &treaty->name);
+        ::deserialize(ar, &treaty->sender);
+
+        // Validate data
+        if(!treaty->clauses.size())
+            throw ServerException("Clause-less treaty");
+        if(treaty->sender == nullptr)
+            throw ServerException("Treaty has invalid ends");
+        
+        // Obtain participants of the treaty
+        std::set<Nation*> approver_nations = std::set<Nation*>();
+        for(auto& clause: treaty->clauses) {
+            if(clause->receiver == nullptr || clause->sender == nullptr)
+                throw ServerException("Invalid clause receiver/sender");
+            
+            approver_nations.insert(clause->receiver);
+            approver_nations.insert(clause->sender);
+        }
+
+        print_info("Participants of treaty %s", treaty->name.c_str());
+        // Then fill as undecided (and ask nations to sign this treaty)
+        for(auto& nation: approver_nations) {
+            treaty->approval_status.push_back(std::make_pair(nation, TreatyApproval::UNDECIDED));
+            print_info("- %s", nation->name.c_str());
+        }
+
+        // The sender automatically accepts the treaty (they are the ones who drafted it)
+        for(auto& status: treaty->approval_status) {
+            if(status.first == selected_nation) {
+                status.second = TreatyApproval::ACCEPTED;
+                break;
+            }
+        }
+
+        g_world->insert(treaty);
+
+        // Rebroadcast to client
+        // We are going to add a treaty to the client
+        Archive tmp_ar = Archive();
+        action = ActionType::TREATY_ADD;
+        ::serialize(tmp_ar, &action);
+        ::serialize(tmp_ar, treaty);
+        packet.data(tmp_ar.get_buffer(), tmp_ar.size());
+        broadcast(packet);
+    } break;
+    // Client takes a descision
+    case ActionType::NATION_TAKE_DESCISION: {
+        // Find event by reference name
+        std::string event_ref_name;
+        ::deserialize(ar, &event_ref_name);
+        auto event = std::find_if(g_world->events.begin(), g_world->events.end(),
+        [&event_ref_name](const Event* e) {
+            return e->ref_name == event_ref_name;
+        });
+        if(event == g_world->events.end()) {
+            throw ServerException("Event not found");
+        }
+        
+        // Find descision by reference name
+        std::string descision_ref_name;
+        ::deserialize(ar, &descision_ref_name);
+        auto descision = std::find_if((*event)->descisions.begin(), (*event)->descisions.end(),
+        [&descision_ref_name](const Descision& e) {
+            return e.ref_name == descision_ref_name;
+        });
+        if(descision == (*event)->descisions.end()) {
+            throw ServerException("Descision not found");
+        }
+
+        (*event)->take_descision(selected_nation, &(*descision));
+        print_info("Event %s + descision %s taken by %s",
+            event_ref_name.c_str(),
+            descision_ref_name.c_str(),
+            selected_nation->ref_name.c_str()
+        );
+    } break;
+    // The client selects a nation
+    case ActionType::SELECT_NATION: {
+        Nation* nation;
+        ::deserialize(ar, &nation);
+        if(nation == nullptr)
+            throw ServerException("Unknown nation");
+        selected_nation = nation;
+        selected_nation->is_ai = false;
+        print_info("Nation %s selected by client %zu", selected_nation->name.c_str(), (size_t)id);
+    } break;
+    // Nation and province addition and removals are not allowed to be done by clients
+    default:
+        break;
     }
 }
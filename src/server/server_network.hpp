@@ -2,52 +2,265 @@
 #define NETWORK_SERVER_HPP
 
 #include <deque>
+#include <memory>
+#include <unordered_map>
 #include <mutex>
 #include <atomic>
 #include <vector>
 #include <thread>
+#include <chrono>
 #include "../network.hpp"
 
-#ifdef windows
+#ifdef unix
+#include <sys/types.h>
+#elif defined windows
 #include <winsock2.h>
 #endif
 
+class Nation;
+
+// A connection slot of the server, the socket is only touched by the I/O thread while
+// the fields about the game (username, selected nation) are only touched by the thread
+// running the simulation
 class ServerClient {
 public:
-    ServerClient() {};
-    ~ServerClient(void) {
-        thread.join();
-    };
+    ServerClient() : reader(max_packet_size) {};
+    ~ServerClient() {};
+
+    // Clients only send small actions, anything bigger than this is garbage
+    static constexpr size_t max_packet_size = 16 * 1000000;
+
+#ifdef unix
+    int fd = INVALID_SOCKET;
+#elif defined windows
+    SOCKET fd = INVALID_SOCKET;
+#endif
+
+    // Unique for each connection, actions of a connection that was closed (when the
+    // slot is reused) are discarded
+    std::atomic<uint64_t> conn_id;
 
-    std::thread thread;
     std::atomic<bool> is_connected;
 
-    std::deque<Packet> packets;
+    // Broadcasts are only queued after the snapshot of the world is queued, so the
+    // snapshot is always the first thing a client receives
+    std::atomic<bool> has_snapshot;
+
+    // Set by the simulation thread to make the I/O thread close the connection
+    std::atomic<bool> is_closing;
+
+    // The snapshot is being made on the background, nothing is sent until it's done
+    std::atomic<bool> is_loading;
+
+    // Packets are immutable and shared by the queues of all the clients they were
+    // broadcasted to
+    std::deque<std::shared_ptr<const Packet>> packets;
     std::mutex packets_mutex;
 
+    // Total size of the packets that were not sent yet (including the ones being sent)
+    size_t packets_size = 0;
+
     std::string username;
+    Nation* selected_nation = nullptr;
+
+    // NetworkFeature flags the client told when connecting
+    std::atomic<uint32_t> features;
+
+    // Area of the map the client is looking at (in tiles), told by the client
+    bool has_viewport = false;
+    float view_min_x, view_min_y, view_max_x, view_max_y;
+
+    // Last local packet of each key the client was not interested in, sent on the
+    // next summary
+    std::unordered_map<size_t, std::shared_ptr<const Packet>> deferred;
+
+    // Bytes received that do not form a whole packet yet
+    PacketReader reader;
+
+    // Packets taken from the queue to be sent, the first one may be partially sent
+    std::deque<std::shared_ptr<const Packet>> out_packets;
+    size_t out_offset = 0;
+
+    // Whetever the I/O thread waits for the socket to be writable
+    bool wants_write = false;
+
+#ifdef unix
+    // Pipe and process making the snapshot, and what was received from it so far
+    int snapshot_fd = -1;
+    pid_t snapshot_pid = -1;
+    std::vector<uint8_t> snapshot_data;
+    std::chrono::steady_clock::time_point snapshot_start;
+
+    // Set by the I/O thread when the process took too long, the simulation thread then
+    // makes the snapshot itself
+    std::atomic<bool> wants_snapshot;
+#endif
+};
+
+// A packet about something that happened at a place of the map, only the clients
+// interested in that place receive it right away (see Server::broadcast_local)
+class LocalPacket {
+public:
+    static constexpr size_t no_key = (size_t)-1;
+
+    // What a key is about, it goes on the top bits of the key so the IDs of different
+    // kinds of things do not collide
+    enum class KeyKind : size_t {
+        TILE,
+        UNIT,
+        BOAT,
+    };
+    static constexpr size_t make_key(KeyKind kind, size_t id) {
+        return ((size_t)kind << 56) | id;
+    }
+
+    // Without packet the clients only forget what was deferred for the key
+    std::shared_ptr<const Packet> packet;
+    size_t x, y;
+
+    // Nation the packet is about, it's players and their allies are always interested
+    const Nation* owner;
+
+    // The uninterested clients receive the last packet of each key on the next summary.
+    // Packets without key are about a state that is sent again each tick, so they only
+    // get the ones sent on the summary tick
+    size_t key;
+};
+
+// The packets broadcasted while a tick is done, sent later in a deterministic order
+class Outbox {
+public:
+    std::vector<Packet> packets;
+    std::vector<LocalPacket> local_packets;
 };
 
 class Server {
     struct sockaddr_in addr;
 #ifdef unix
     int fd;
+    int epoll_fd;
+
+    // Written to wake up the I/O thread when there are packets to send
+    int wake_fd;
 #elif defined windows
     SOCKET fd;
 #endif
 
     std::atomic<bool> run;
+    std::thread io_thread;
+    uint64_t next_conn_id = 1;
+
+    // A packet received from a client, to be handled by the simulation thread
+    class ClientAction {
+    public:
+        size_t client;
+        uint64_t conn_id;
+        Packet packet;
+    };
+    std::deque<ClientAction> actions;
+    std::mutex actions_mutex;
+
+    // Packets of the actions that were handled, reused for receiving the next ones so
+    // their buffers are not allocated for each action (guarded by actions_mutex)
+    std::vector<Packet> free_packets;
+    static constexpr size_t max_free_packets = 256;
+    static constexpr size_t max_free_packet_size = 65536;
+
+    void io_loop(void);
+    void accept_clients(void);
+    bool read_client(size_t id);
+    bool write_client(size_t id);
+    void set_write_interest(size_t id, bool wants_write);
+    void close_client(size_t id);
+    void wake(void);
+
+    void send_snapshot(size_t id);
+#ifdef unix
+    // A process making a snapshot for longer than this is assumed to be stuck
+    static constexpr std::chrono::seconds snapshot_timeout{30};
+
+    bool read_snapshot(size_t id);
+    void stop_snapshot(size_t id);
+    void cancel_snapshot(size_t id);
+    void check_snapshots(void);
+    void send_snapshot_in_process(size_t id);
+#endif
+    void handle_action(size_t id, Packet& packet);
+    void send_to(size_t id, Packet& packet);
+    void send_to(size_t id, std::shared_ptr<const Packet> packet);
+    void send_to_clients(std::shared_ptr<const Packet> packet);
+
+    bool is_interested(const ServerClient& cl, const LocalPacket& local) const;
+    void send_local(const std::vector<LocalPacket>& local_packets, bool is_summary);
+
+    // Frames since the last time everything was sent to everyone
+    unsigned frames_since_summary = 0;
 public:
     ServerClient* clients;
 
-    Server(unsigned port = 1825, unsigned max_conn = 16);
+    Server(unsigned port = 1825, unsigned max_conn = 128);
+
+    // Broadcasted packets of at least this size are compressed for the clients that
+    // support it, smaller ones are not worth the time
+    static constexpr size_t compress_threshold = 4096;
+
+    // Every this many frames the local packets are sent to all the clients, so the
+    // ones not interested still see the rest of the world (slowly)
+    static constexpr unsigned summary_interval = 16;
+
+    // A server without socket nor clients, everything broadcasted goes nowhere. Used
+    // to run the simulation without networking (i.e the benchmark)
+    class NullSink {};
+    Server(NullSink);
     ~Server();
-    
+
     void broadcast(Packet& packet);
-    void net_loop(int id);
-    
+
+    // Broadcasts a packet about something that happened on the given tile, key identifies
+    // what the packet is about (i.e the ID of the tile) or is LocalPacket::no_key
+    void broadcast_local(Packet& packet, size_t x, size_t y, const Nation* owner, size_t key = LocalPacket::no_key);
+    void broadcast_local(const LocalPacket& local);
+
+    // Forgets the local packets deferred with the given key, for when what the key is
+    // about is gone (i.e an object was removed and the IDs after it were shifted)
+    void forget_local(size_t key);
+
+    // Broadcasts all the packets of the outbox as a single TICK_FRAME, clients handle the
+    // actions of the frame in the same order. Each client then receives another frame
+    // with the local packets it's interested in
+    void broadcast_frame(Outbox& outbox);
+
+    // Handles the actions the clients sent since the last call, must be called by the
+    // thread running the simulation (not while a tick is being done)
+    void process_actions(void);
+
+    // When set, packets broadcasted by this thread are put here instead of being sent
+    // so they can be sent later in a deterministic order (see TickPipeline)
+    static thread_local Outbox* outbox;
+
+    // Disconnects all the clients so they join again and receive a new snapshot, used
+    // when the world is replaced (i.e a save is loaded). Must be called by the thread
+    // running the simulation
+    void disconnect_clients(void);
+
+    // Incremented each time a snapshot is sent to a joining client, the snapshot may be
+    // newer than the last replicated state so the next replication sends whole objects
+    std::atomic<uint32_t> snapshot_generation;
+
     int n_clients;
 };
 extern Server* g_server;
 
-#endif
\ No newline at end of file
+// Makes the broadcasts of this thread go to an outbox while it's alive
+class OutboxScope {
+    Outbox* prev_outbox;
+public:
+    OutboxScope(Outbox& outbox) : prev_outbox(Server::outbox) {
+        Server::outbox = &outbox;
+    };
+    ~OutboxScope() {
+        Server::outbox = prev_outbox;
+    };
+};
+
+#endif
@@ -21,6 +21,9 @@
 #include "../serializer.hpp"
 #include "../io_impl.hpp"
 #include "server_network.hpp"
+#include "tick_pipeline.hpp"
+#include "../profiler.hpp"
+#include "../delta.hpp"
 
 #if (__cplusplus < 201703L)
 namespace std {
@@ -156,7 +159,7 @@ World::World() {
         { "register", [](lua_State* L) {
             Ideology* ideology = (Ideology*)luaL_checkudata(L, 1, "Ideology");
             Ideology* new_ideology = new Ideology(*ideology);
-            g_world->ideologies.push_back(new_ideology);
+            g_world->insert(new_ideology);
             return 0;
         }},
         { "get", [](lua_State* L) {
@@ -426,7 +429,7 @@ void World::load_mod(void) {
     print_info(gettext("Calculate the edges of the province (min and max x and y coordinates)"));
     for(size_t j = 0; j < height; j++) {
         for(size_t i = 0; i < width; i++) {
-            Tile& tile = get_tile(i, j);
+            Tile& tile = get_tile_unchecked(i, j);
             if(tile.province_id == (Province::Id)-1)
                 continue;
 
@@ -586,682 +589,745 @@ void World::load_mod(void) {
         policy.industry_tax = 0.1f;
         policy.foreign_trade = true;
     }
+    publish_tiles();
     print_info(gettext("World fully intiialized"));
 }
 
 #include "../actions.hpp"
 #include "economy.hpp"
-void World::do_tick() {
-    std::lock_guard<std::recursive_mutex> lock(world_mutex);
-    std::lock_guard<std::recursive_mutex> lock2(tiles_mutex);
+// Gives a tile to the nation that conquered it, returns true if the tile changed it's owner
+static bool conquer_tile(World& world, Tile& tile, const Nation* nation) {
+    const Nation::Id nation_id = world.get_id(nation);
+    if(tile.owner_id == nation_id)
+        return false;
+    
+    tile.owner_id = nation_id;
 
-    // AI and stuff
-    // Just random shit to make the world be like more alive
-    for(const auto& nation: nations) {
-        if(nation->exists() == false)
-            continue;
-        
-        if(rand() % 1000 > 990) {
-            Province *target = provinces[rand() % provinces.size()];
-            if(target->owner == nullptr) {
-                Packet packet = Packet();
-                Archive ar = Archive();
-                ActionType action = ActionType::PROVINCE_COLONIZE;
-                ::serialize(ar, &action);
-                ::serialize(ar, &target);
-                ::serialize(ar, target);
-                packet.data(ar.get_buffer(), ar.size());
-                g_server->broadcast(packet);
+    std::lock_guard<std::recursive_mutex> lock(world.nation_changed_tiles_mutex);
+    world.nation_changed_tiles.push_back(&tile);
+    return true;
+}
 
-                nation->give_province(*this, *target);
-                print_info("Conquering %s for %s", target->name.c_str(), nation->name.c_str());
-            }
+/**
+ * State of the replication of a list of objects to the clients, the objects are sent as
+ * deltas against the last replicated state of each of them
+ */
+template<typename T>
+class Replicator {
+    DeltaEncoder<T> encoder;
+
+    // Snapshot generation of the server when this was last replicated
+    uint32_t generation = 0;
+public:
+    void replicate(World& world, const std::vector<T*>& list, ActionType action) {
+        // Clients that joined since the last replication need the whole objects
+        const uint32_t current_generation = g_server->snapshot_generation;
+        const bool full = (generation != current_generation);
+        generation = current_generation;
+
+        encoder.truncate(list.size());
+        for(const auto& obj: list) {
+            Archive& ar = get_scratch_archive();
+            ::serialize(ar, &action);
+            ::serialize(ar, &obj); // Ref
+            if(!encoder.encode(ar, world.get_id(obj), obj, full))
+                continue;
+
+            Packet packet = Packet();
+            packet.data(ar.get_buffer(), ar.size());
+            g_server->broadcast(packet);
         }
+    }
+};
+static Replicator<Nation> nation_replicator;
+static Replicator<Province> province_replicator;
+static Replicator<Product> product_replicator;
 
-        if(rand() % 100 > 98.f) {
-            Nation *target = nullptr;
-            while(target == nullptr || target->exists() == false) {
-                target = nations[rand() % nations.size()];
+/**
+ * State of the replication of the movement of units (or boats). Clients move them each
+ * tick the same way the simulation does, so only what they can't predict (a new target,
+ * being blocked, a new object) is sent, as a MOVE action. The whole objects are also sent
+ * every correction_interval ticks (a few of them each tick), for everything else that
+ * changes. Both are local packets keyed by the object, so the clients that were not
+ * interested receive the last one of each object on the summary
+ */
+template<typename T>
+class MotionReplicator {
+    LocalPacket::KeyKind kind;
+
+    // What the clients have of each object, if they predicted right
+    class Baseline {
+    public:
+        const T* obj = nullptr;
+        float x, y;
+        size_t tx, ty;
+    };
+    std::vector<Baseline> baselines;
+public:
+    static constexpr uint64_t correction_interval = 16;
+
+    MotionReplicator(LocalPacket::KeyKind _kind) : kind(_kind) {};
+
+    void replicate(World& world, const std::vector<T*>& list, ActionType move_action, ActionType update_action, bool (World::*step)(float&, float&, size_t, size_t) const) {
+        // Objects were removed, the IDs past the end are gone (the objects that were
+        // shifted to another ID do not match their baseline, so they are sent again)
+        for(size_t i = list.size(); i < baselines.size(); i++) {
+            g_server->forget_local(LocalPacket::make_key(kind, i));
+        }
+        baselines.resize(list.size());
+        for(size_t i = 0; i < list.size(); i++) {
+            T* obj = list[i];
+            Baseline& baseline = baselines[i];
+
+            bool is_predicted = (baseline.obj == obj && baseline.tx == obj->tx && baseline.ty == obj->ty);
+            if(is_predicted) {
+                (world.*step)(baseline.x, baseline.y, baseline.tx, baseline.ty);
+                is_predicted = (baseline.x == obj->x && baseline.y == obj->y);
             }
-            nation->increase_relation(*target);
-        } else if(rand() % 100 > 98.f) {
-            Nation *target = nullptr;
-            while(target == nullptr || target->exists() == false) {
-                target = nations[rand() % nations.size()];
+            baseline.obj = obj;
+            baseline.x = obj->x;
+            baseline.y = obj->y;
+            baseline.tx = obj->tx;
+            baseline.ty = obj->ty;
+
+            Packet packet = Packet();
+            Archive& ar = get_scratch_archive();
+            const size_t key = LocalPacket::make_key(kind, world.get_id(obj));
+            if(i % correction_interval == world.time % correction_interval) {
+                ::serialize(ar, &update_action);
+                ::serialize(ar, &obj); // Ref
+                ::serialize(ar, obj);
+                packet.data(ar.get_buffer(), ar.size());
+                g_server->broadcast_local(packet, (size_t)obj->x, (size_t)obj->y, obj->owner, key);
+            } else if(!is_predicted) {
+                // The position is the one at the start of the next tick
+                const uint64_t start_tick = world.time + 1;
+                ::serialize(ar, &move_action);
+                ::serialize(ar, &obj); // Ref
+                ::serialize(ar, &obj->x);
+                ::serialize(ar, &obj->y);
+                ::serialize(ar, &obj->tx);
+                ::serialize(ar, &obj->ty);
+                ::serialize(ar, &start_tick);
+                packet.data(ar.get_buffer(), ar.size());
+                g_server->broadcast_local(packet, (size_t)obj->x, (size_t)obj->y, obj->owner, key);
             }
-            nation->decrease_relation(*target);
         }
+    }
+};
+static MotionReplicator<Unit> unit_motion_replicator(LocalPacket::KeyKind::UNIT);
+static MotionReplicator<Boat> boat_motion_replicator(LocalPacket::KeyKind::BOAT);
 
-        // Rarely nations will change policies
-        if(rand() % 100 > 50) {
-            Policies new_policy = nation->current_policy;
+void World::do_tick() {
+    std::lock_guard<std::recursive_mutex> lock(world_mutex);
+    std::lock_guard<std::recursive_mutex> lock2(tiles_mutex);
+    ProfileTimer timer("World::do_tick");
 
-            if(rand() % 100 > 50.f) {
-                new_policy.import_tax += 0.1f * (rand() % 10);
-            } else if(rand() % 100 > 50.f) {
-                new_policy.import_tax -= 0.1f * (rand() % 10);
-            }
+    // Everything broadcasted during the tick is sent to the clients as a single frame
+    Outbox frame;
+    OutboxScope frame_scope(frame);
 
-            if(rand() % 100 > 50.f) {
-                new_policy.export_tax += 0.1f * (rand() % 10);
-            } else if(rand() % 100 > 50.f) {
-                new_policy.export_tax -= 0.1f * (rand() % 10);
-            }
+    // Tell clients about the tick first, they move the units (as predicted) when they
+    // receive it and then apply what the frame says about them
+    {
+        Packet packet = Packet(0);
+        Archive ar = Archive();
+        ActionType action = ActionType::WORLD_TICK;
+        ::serialize(ar, &action);
+        packet.data(ar.get_buffer(), ar.size());
+        g_server->broadcast(packet);
+    }
 
-            if(rand() % 100 > 50.f) {
-                new_policy.domestic_export_tax += 0.1f * (rand() % 10);
-            } else if(rand() % 100 > 50.f) {
-                new_policy.domestic_export_tax -= 0.1f * (rand() % 10);
+    // Changes done by the naval and land stages to other parts of the world, they are
+    // applied when the stages are committed so both stages can run at the same time
+    std::vector<std::pair<Tile*, Nation*>> naval_conquests;
+    std::vector<std::pair<Tile*, Nation*>> land_conquests;
+    std::vector<std::pair<Nation*, float>> land_payments;
+
+    TickPipeline pipeline;
+
+    TickStage ai_stage;
+    ai_stage.name = "AI decisions";
+    ai_stage.reads = TICK_RES_TERRAIN;
+    ai_stage.writes = TICK_RES_NATIONS | TICK_RES_PROVINCES | TICK_RES_TILES | TICK_RES_BUILDINGS | TICK_RES_PRODUCTS | TICK_RES_COMPANIES | TICK_RES_TREATIES | TICK_RES_RANDOM;
+    ai_stage.commits = TICK_RES_NETWORK;
+    ai_stage.execute = [this]() {
+        // AI and stuff
+        // Just random shit to make the world be like more alive
+        for(const auto& nation: nations) {
+            if(nation->exists() == false)
+                continue;
+        
+            if(rand() % 1000 > 990) {
+                Province *target = provinces[rand() % provinces.size()];
+                if(target->owner == nullptr) {
+                    Packet packet = Packet();
+                    Archive ar = Archive();
+                    ActionType action = ActionType::PROVINCE_COLONIZE;
+                    ::serialize(ar, &action);
+                    ::serialize(ar, &target);
+                    ::serialize(ar, target);
+                    packet.data(ar.get_buffer(), ar.size());
+                    g_server->broadcast(packet);
+
+                    nation->give_province(*this, *target);
+                    print_info("Conquering %s for %s", target->name.c_str(), nation->name.c_str());
+                }
             }
 
-            if(rand() % 100 > 50.f) {
-                new_policy.domestic_import_tax += 0.1f * (rand() % 10);
-            } else if(rand() % 100 > 50.f) {
-                new_policy.domestic_import_tax -= 0.1f * (rand() % 10);
+            if(rand() % 100 > 98.f) {
+                Nation *target = nullptr;
+                while(target == nullptr || target->exists() == false) {
+                    target = nations[rand() % nations.size()];
+                }
+                nation->increase_relation(*target);
+            } else if(rand() % 100 > 98.f) {
+                Nation *target = nullptr;
+                while(target == nullptr || target->exists() == false) {
+                    target = nations[rand() % nations.size()];
+                }
+                nation->decrease_relation(*target);
             }
 
-            if(rand() % 100 > 50.f) {
-                new_policy.industry_tax += 0.1f * (rand() % 10);
-            } else if(rand() % 100 > 50.f) {
-                new_policy.industry_tax -= 0.1f * (rand() % 10);
-            }
+            // Rarely nations will change policies
+            if(rand() % 100 > 50) {
+                Policies new_policy = nation->current_policy;
 
-            nation->set_policy(new_policy);
-        }
+                if(rand() % 100 > 50.f) {
+                    new_policy.import_tax += 0.1f * (rand() % 10);
+                } else if(rand() % 100 > 50.f) {
+                    new_policy.import_tax -= 0.1f * (rand() % 10);
+                }
 
-        if(nation->diplomatic_timer != 0) {
-            nation->diplomatic_timer--;
-        }
+                if(rand() % 100 > 50.f) {
+                    new_policy.export_tax += 0.1f * (rand() % 10);
+                } else if(rand() % 100 > 50.f) {
+                    new_policy.export_tax -= 0.1f * (rand() % 10);
+                }
 
-        // Accepting/rejecting treaties
-        if(std::rand() % 1000 > 10) {
-            for(auto& treaty: treaties) {
-                for(auto& part: treaty->approval_status) {
-                    if(part.first == nation) {
-                        if(part.second == TreatyApproval::ACCEPTED
-                        || part.second == TreatyApproval::DENIED) {
-                            break;
-                        }
+                if(rand() % 100 > 50.f) {
+                    new_policy.domestic_export_tax += 0.1f * (rand() % 10);
+                } else if(rand() % 100 > 50.f) {
+                    new_policy.domestic_export_tax -= 0.1f * (rand() % 10);
+                }
 
-                        if(std::rand() % 50 >= 25) {
-                            print_info("We, %s, deny the treaty of %s", treaty->name.c_str());
-                            part.second = TreatyApproval::DENIED;
-                        } else {
-                            print_info("We, %s, accept the treaty of %s", treaty->name.c_str());
-                            part.second = TreatyApproval::ACCEPTED;
-                        }
-                    }
+                if(rand() % 100 > 50.f) {
+                    new_policy.domestic_import_tax += 0.1f * (rand() % 10);
+                } else if(rand() % 100 > 50.f) {
+                    new_policy.domestic_import_tax -= 0.1f * (rand() % 10);
                 }
-            }
-        }
 
-        // Build an building randomly?
-        if(std::rand() % 1000 > 950) {
-            bool can_build = false;
-            for(const auto& province: nation->owned_provinces) {
-                if(get_id(&province->get_occupation_controller(*this)) != g_world->get_id(nation)) {
-                    can_build = true;
-                    break;
+                if(rand() % 100 > 50.f) {
+                    new_policy.industry_tax += 0.1f * (rand() % 10);
+                } else if(rand() % 100 > 50.f) {
+                    new_policy.industry_tax -= 0.1f * (rand() % 10);
                 }
-            }
 
-            if(!can_build) {
-                continue;
+                nation->set_policy(new_policy);
             }
 
-            // Select random province
-            Province *target = nullptr;
-            while(target == nullptr || get_id(&target->get_occupation_controller(*this)) != g_world->get_id(nation)) {
-                auto it = std::begin(nation->owned_provinces);
-                std::advance(it, std::rand() % nation->owned_provinces.size());
-                target = *it;
+            if(nation->diplomatic_timer != 0) {
+                nation->diplomatic_timer--;
             }
 
-            Tile *tile = nullptr;
-            int x_coord, y_coord;
-            while(tile == nullptr) {
-                x_coord = std::clamp<size_t>((std::rand() % (target->max_x - target->min_x + 1)) + target->min_x, target->min_x, target->max_x);
-                y_coord = std::clamp<size_t>((std::rand() % (target->max_y - target->min_y + 1)) + target->min_y, target->min_y, target->max_y);
-                tile = &get_tile(x_coord, y_coord);
-
-                // If tile is land AND NOT part of target province OR NOT of ownership of nation
-                if(tile->elevation > sea_level
-                && (tile->province_id != get_id(target) || tile->owner_id != get_id(nation))) {
-                    tile = nullptr;
+            // Accepting/rejecting treaties
+            if(std::rand() % 1000 > 10) {
+                for(auto& treaty: treaties) {
+                    for(auto& part: treaty->approval_status) {
+                        if(part.first == nation) {
+                            if(part.second == TreatyApproval::ACCEPTED
+                            || part.second == TreatyApproval::DENIED) {
+                                break;
+                            }
+
+                            if(std::rand() % 50 >= 25) {
+                                print_info("We, %s, deny the treaty of %s", treaty->name.c_str());
+                                part.second = TreatyApproval::DENIED;
+                            } else {
+                                print_info("We, %s, accept the treaty of %s", treaty->name.c_str());
+                                part.second = TreatyApproval::ACCEPTED;
+                            }
+                        }
+                    }
                 }
             }
 
-            // Now build the building
-            Building* building = new Building();
-            building->x = x_coord;
-            building->y = y_coord;
-            building->owner = nation;
-            building->working_unit_type = nullptr;
-            building->working_boat_type = nullptr;
-            building->req_goods_for_unit = std::vector<std::pair<Good*, size_t>>();
-            building->req_goods = std::vector<std::pair<Good*, size_t>>();
-            building->type = building_types.at(std::rand() % building_types.size());
-            if(building->type->is_factory == true) {
-                building->budget = 100.f;
-                building->corporate_owner = companies.at(std::rand() % companies.size());
-                building->create_factory(*this);
-            }
-            g_world->buildings.push_back(building);
-
-            // Broadcast the addition of the building to the clients
-            {
-                Packet packet = Packet();
-                Archive ar = Archive();
-                ActionType action = ActionType::BUILDING_ADD;
-                ::serialize(ar, &action);
-                ::serialize(ar, building);
-                packet.data(ar.get_buffer(), ar.size());
-                g_server->broadcast(packet);
-            }
-            print_info("Building of %s(%i), from %s built on %s", building->type->name.c_str(), (int)get_id(building->type), nation->name.c_str(), target->name.c_str());
-        }
-    }
+            // Build an building randomly?
+            if(std::rand() % 1000 > 950) {
+                bool can_build = false;
+                for(const auto& province: nation->owned_provinces) {
+                    if(get_id(&province->get_occupation_controller(*this)) != g_world->get_id(nation)) {
+                        can_build = true;
+                        break;
+                    }
+                }
 
-    // Each tick == 30 minutes
-    switch(time % (24 * 2)) {
-    // 3:00
-    case 6:
-        Economy::do_phase_1(*this);
-        break;
-    // 7:30
-    // Busy hour, newspapers come out and people get mad
-    case 15:
-        Economy::do_phase_2(*this);
-
-        // Calculate prestige for today (newspapers come out!)
-        for(auto& nation: this->nations) {
-            const float decay_per_cent = 5.f;
-            const float max_modifier = 10.f;
-            const float min_prestige = std::max<float>(0.5f, ((nation->naval_score + nation->military_score + nation->economy_score) / 2));
-
-            // Prestige cannot go below min prestige
-            nation->prestige = std::max<float>(nation->prestige, min_prestige);
-            nation->prestige -= (nation->prestige* (decay_per_cent / 100.f))* fmin(fmax(1, nation->prestige - min_prestige) / min_prestige, max_modifier);
-        }
-        break;
-    // 12:00
-    case 24:
-        Economy::do_phase_3(*this);
-        for(const auto& product: g_world->products) {
-            // Broadcast to clients
-            Packet packet = Packet();
-            Archive ar = Archive();
-            ActionType action = ActionType::PRODUCT_UPDATE;
-            ::serialize(ar, &action);
-            ::serialize(ar, &product); // ProductRef
-            ::serialize(ar, product); // ProductObj
-            packet.data(ar.get_buffer(), ar.size());
-            g_server->broadcast(packet);
-        }
+                if(!can_build) {
+                    continue;
+                }
 
-        for(auto& nation: this->nations) {
-            float economy_score = 0.f;
-            for(const auto& province: nation->owned_provinces) {
-                // Calculate economy score of nations
-                for(const auto& pop: province->pops) {
-                    economy_score += pop.budget;
+                // Select random province
+                Province *target = nullptr;
+                while(target == nullptr || get_id(&target->get_occupation_controller(*this)) != g_world->get_id(nation)) {
+                    auto it = std::begin(nation->owned_provinces);
+                    std::advance(it, std::rand() % nation->owned_provinces.size());
+                    target = *it;
                 }
-                
-                // Also calculates GDP
-                for(const auto& product: g_world->products) {
-                    nation->gdp += product->price* province->stockpile[g_world->get_id(product)];
+
+                Tile *tile = nullptr;
+                int x_coord, y_coord;
+                while(tile == nullptr) {
+                    x_coord = std::clamp<size_t>((std::rand() % (target->max_x - target->min_x + 1)) + target->min_x, target->min_x, target->max_x);
+                    y_coord = std::clamp<size_t>((std::rand() % (target->max_y - target->min_y + 1)) + target->min_y, target->min_y, target->max_y);
+                    tile = &get_tile(x_coord, y_coord);
+
+                    // If tile is land AND NOT part of target province OR NOT of ownership of nation
+                    if(tile->elevation > sea_level
+                    && (tile->province_id != get_id(target) || tile->owner_id != get_id(nation))) {
+                        tile = nullptr;
+                    }
                 }
-            }
-            nation->economy_score = economy_score / 100.f;
-        }
-        break;
-    // 18:00
-    case 36:
-        Economy::do_phase_4(*this);
-        break;
-    // 24:00, this is where clients are sent all information **at once**
-    case 47:
-        {
-            for(const auto& nation: g_world->nations) {
-                // Broadcast to clients
-                Packet packet = Packet();
-                Archive ar = Archive();
-                ActionType action = ActionType::NATION_UPDATE;
-                ::serialize(ar, &action);
-                ::serialize(ar, &nation); // NationRef
-                ::serialize(ar, nation); // NationObj
-                packet.data(ar.get_buffer(), ar.size());
-                g_server->broadcast(packet);
-            }
 
-            for(const auto& province: g_world->provinces) {
-                // Broadcast to clients
-                Packet packet = Packet();
-                Archive ar = Archive();
-                ActionType action = ActionType::PROVINCE_UPDATE;
-                ::serialize(ar, &action);
-                ::serialize(ar, &province); // ProvinceRef
-                ::serialize(ar, province); // ProvinceObj
-                packet.data(ar.get_buffer(), ar.size());
-                g_server->broadcast(packet);
+                // Now build the building
+                Building* building = new Building();
+                building->x = x_coord;
+                building->y = y_coord;
+                building->owner = nation;
+                building->working_unit_type = nullptr;
+                building->working_boat_type = nullptr;
+                building->req_goods_for_unit = std::vector<std::pair<Good*, size_t>>();
+                building->req_goods = std::vector<std::pair<Good*, size_t>>();
+                building->type = building_types.at(std::rand() % building_types.size());
+                if(building->type->is_factory == true) {
+                    building->budget = 100.f;
+                    building->corporate_owner = companies.at(std::rand() % companies.size());
+                    building->create_factory(*this);
+                }
+                g_world->insert(building);
+
+                // Broadcast the addition of the building to the clients
+                {
+                    Packet packet = Packet();
+                    Archive ar = Archive();
+                    ActionType action = ActionType::BUILDING_ADD;
+                    ::serialize(ar, &action);
+                    ::serialize(ar, building);
+                    packet.data(ar.get_buffer(), ar.size());
+                    g_server->broadcast(packet);
+                }
+                print_info("Building of %s(%i), from %s built on %s", building->type->name.c_str(), (int)get_id(building->type), nation->name.c_str(), target->name.c_str());
             }
         }
-        break;
-    default:
-        break;
-    }
-
-    // Evaluate boats
-    for(size_t i = 0; i < boats.size(); i++) {
-        Boat* unit = boats[i];
-        if(unit->size <= 0) {
-            g_world->boats.erase(boats.begin() + i);
+    };
+    pipeline.add_stage(ai_stage);
+
+    TickStage economy_stage;
+    economy_stage.name = "Economy";
+    economy_stage.reads = TICK_RES_TERRAIN | TICK_RES_TILES;
+    economy_stage.writes = TICK_RES_NATIONS | TICK_RES_PROVINCES | TICK_RES_BUILDINGS | TICK_RES_PRODUCTS | TICK_RES_COMPANIES | TICK_RES_UNITS | TICK_RES_BOATS | TICK_RES_RANDOM;
+    economy_stage.commits = TICK_RES_NETWORK;
+    economy_stage.execute = [this]() {
+        // Each tick == 30 minutes
+        switch(time % (24 * 2)) {
+        // 3:00
+        case 6:
+            Economy::do_phase_1(*this);
             break;
-        }
-        
-        // Count friends and foes in range (and find nearest foe)
-        size_t n_friends = 0;
-        size_t n_foes = 0;
-        Boat* nearest_foe = nullptr;
-        Boat* nearest_friend = nullptr;
-        for(size_t j = 0; j < g_world->boats.size(); j++) {
-            Boat* other_unit = g_world->boats[j];
-            if(unit->owner == other_unit->owner) {
-                // Only when very close
-                if(std::abs(unit->x - other_unit->x) >= 4.f && std::abs(unit->y - other_unit->y) >= 4.f)
-                    continue;
-                
-                n_friends++;
-                
-                if(nearest_friend == nullptr) {
-                    nearest_friend = other_unit;
-                }
-                
-                // Find nearest friend
-                if(std::abs(unit->x - other_unit->x) < std::abs(unit->x - nearest_friend->x)
-                && std::abs(unit->y - other_unit->y) < std::abs(unit->y - nearest_friend->y)) {
-                    nearest_friend = other_unit;
-                }
-            } else {
-                // Foes from many ranges counts
-                if(std::abs(unit->x - other_unit->x) >= 1.f && std::abs(unit->y - other_unit->y) >= 1.f)
-                    continue;
-                
-                n_foes++;
+        // 7:30
+        // Busy hour, newspapers come out and people get mad
+        case 15:
+            Economy::do_phase_2(*this);
+
+            // Calculate prestige for today (newspapers come out!)
+            for(auto& nation: this->nations) {
+                const float decay_per_cent = 5.f;
+                const float max_modifier = 10.f;
+                const float min_prestige = std::max<float>(0.5f, ((nation->naval_score + nation->military_score + nation->economy_score) / 2));
+
+                // Prestige cannot go below min prestige
+                nation->prestige = std::max<float>(nation->prestige, min_prestige);
+                nation->prestige -= (nation->prestige* (decay_per_cent / 100.f))* fmin(fmax(1, nation->prestige - min_prestige) / min_prestige, max_modifier);
+            }
+            break;
+        // 12:00
+        case 24:
+            Economy::do_phase_3(*this);
+
+            // Broadcast the changed products to the clients
+            product_replicator.replicate(*this, products, ActionType::PRODUCT_DELTA);
+
+            for(auto& nation: this->nations) {
+                float economy_score = 0.f;
+                for(const auto& province: nation->owned_provinces) {
+                    // Calculate economy score of nations
+                    for(const auto& pop: province->pops) {
+                        economy_score += pop.budget;
+                    }
                 
-                if(nearest_foe == nullptr) {
-                    nearest_foe = other_unit;
-                }
-
-                // Find nearest foe
-                if(std::abs(unit->x - other_unit->x) < std::abs(unit->x - nearest_foe->x)
-                && std::abs(unit->y - other_unit->y) < std::abs(unit->y - nearest_foe->y)) {
-                    nearest_foe = other_unit;
+                    // Also calculates GDP
+                    for(const auto& product: g_world->products) {
+                        nation->gdp += product->price* province->stockpile[g_world->get_id(product)];
+                    }
                 }
+                nation->economy_score = economy_score / 100.f;
             }
+            break;
+        // 18:00
+        case 36:
+            Economy::do_phase_4(*this);
+            break;
+        // 24:00, this is where clients are sent all information **at once**
+        case 47:
+            // Only the fields that changed since yesterday are sent
+            nation_replicator.replicate(*this, nations, ActionType::NATION_DELTA);
+            province_replicator.replicate(*this, provinces, ActionType::PROVINCE_DELTA);
+            break;
+        default:
+            break;
         }
-
-        // This code stops the "wiggly" movement due to floating point differences
-        if((unit->x != unit->tx || unit->y != unit->ty)
-        && (std::abs(unit->x - unit->tx) >= 0.2f || std::abs(unit->y - unit->ty) >= 0.2f)) {
-            float end_x, end_y;
-            const float speed = 0.1f;
-
-            end_x = unit->x;
-            end_y = unit->y;
-            
-            // Move towards target
-            if(unit->x > unit->tx)
-                end_x -= speed;
-            else if(unit->x < unit->tx)
-                end_x += speed;
-
-            if(unit->y > unit->ty)
-                end_y -= speed;
-            else if(unit->y < unit->ty)
-                end_y += speed;
-            
-            // Boats cannot go on land
-            if(get_tile(end_x, end_y).elevation > sea_level) {
+    };
+    pipeline.add_stage(economy_stage);
+
+    TickStage naval_stage;
+    naval_stage.name = "Naval movement and combat";
+    naval_stage.reads = TICK_RES_NATIONS | TICK_RES_TERRAIN;
+    naval_stage.writes = TICK_RES_BOATS;
+    naval_stage.commits = TICK_RES_TILES | TICK_RES_NETWORK;
+    naval_stage.execute = [this, &naval_conquests]() {
+        // Remove the boats that were destroyed
+        for(size_t i = 0; i < boats.size(); ) {
+            Boat* unit = boats[i];
+            if(unit->size > 0) {
+                i++;
                 continue;
             }
 
-            unit->x = end_x;
-            unit->y = end_y;
-        }
-        
-        // Make the unit attack automatically
-        // and we must be at war with the owner of this unit to be able to attack the unit
-        if(nearest_foe != nullptr
-        && unit->owner->relations[get_id(nearest_foe->owner)].has_war == false) {
-            unit->attack(*nearest_foe);
-        }
-
-        // North and south do not wrap
-        unit->y = std::max<float>(0.f, unit->y);
-        unit->y = std::min<float>(height, unit->y);
+            // Tell the clients to remove it before it loses it's ID
+            Packet packet = Packet();
+            Archive ar = Archive();
+            ActionType action = ActionType::BOAT_REMOVE;
+            ::serialize(ar, &action);
+            ::serialize(ar, &unit);
+            packet.data(ar.get_buffer(), ar.size());
+            g_server->broadcast(packet);
 
-        // West and east do wrap
-        if(unit->x <= 0.f) {
-            unit->x = width - 1.f;
-        } else if(unit->x >= width) {
-            unit->x = 0.f;
+            g_world->remove(unit);
+            delete unit;
         }
 
-        // Set nearby tiles as owned
-        // TODO: Make it conquer multiple tiles
-        Tile& tile = get_tile(unit->x, unit->y);
-        if(tile.owner_id != get_id(unit->owner)) {
-            tile.owner_id = get_id(unit->owner);
-
-            std::lock_guard<std::recursive_mutex> lock(nation_changed_tiles_mutex);
-            nation_changed_tiles.push_back(&get_tile(unit->x, unit->y));
-        }
-    }
-    
-    for(const auto& boat: g_world->boats) {
-        // Broadcast to clients
-        Packet packet = Packet();
-        Archive ar = Archive();
-        ActionType action = ActionType::BOAT_UPDATE;
-        ::serialize(ar, &action);
-        ::serialize(ar, &boat);
-        ::serialize(ar, boat);
-        packet.data(ar.get_buffer(), ar.size());
-        g_server->broadcast(packet);
-    }
-
-    // Evaluate units
-    for(size_t i = 0; i < units.size(); i++) {
-        Unit* unit = units[i];
-        if(unit->size <= 0) {
-            g_world->units.erase(units.begin() + i);
-            break;
-        }
-        
-        // Count friends and foes in range (and find nearest foe)
-        size_t n_friends = 0;
-        size_t n_foes = 0;
-        Unit* nearest_foe = nullptr;
-        Unit* nearest_friend = nullptr;
-        for(size_t j = 0; j < g_world->units.size(); j++) {
-            Unit* other_unit = g_world->units[j];
-            if(unit->owner == other_unit->owner) {
-                // Only when very close
-                if(std::abs(unit->x - other_unit->x) >= 4.f && std::abs(unit->y - other_unit->y) >= 4.f)
-                    continue;
-                
-                n_friends++;
-                
-                if(nearest_friend == nullptr) {
-                    nearest_friend = other_unit;
-                }
-                
-                // Find nearest friend
-                if(std::abs(unit->x - other_unit->x) < std::abs(unit->x - nearest_friend->x)
-                && std::abs(unit->y - other_unit->y) < std::abs(unit->y - nearest_friend->y)) {
-                    nearest_friend = other_unit;
-                }
-            } else {
-                // Foes from many ranges counts
-                if(std::abs(unit->x - other_unit->x) >= 1.f && std::abs(unit->y - other_unit->y) >= 1.f)
-                    continue;
-                
-                n_foes++;
-                
-                if(nearest_foe == nullptr) {
+        // Evaluate boats
+        Profiler::get_instance().count(ProfileCounter::BOATS_EVALUATED, boats.size());
+        boat_grid.build(boats, width);
+        for(size_t i = 0; i < boats.size(); i++) {
+            Boat* unit = boats[i];
+
+            // Find nearest foe, foes only count when they are very close
+            Boat* nearest_foe = nullptr;
+            float nearest_foe_dist = 0.f;
+            boat_grid.for_each_near(unit->x, unit->y, 1.f, [&unit, &nearest_foe, &nearest_foe_dist](Boat* other_unit) {
+                if(unit->owner == other_unit->owner)
+                    return;
+
+                const float dist = (unit->x - other_unit->x) * (unit->x - other_unit->x) + (unit->y - other_unit->y) * (unit->y - other_unit->y);
+                if(nearest_foe == nullptr || dist < nearest_foe_dist) {
                     nearest_foe = other_unit;
+                    nearest_foe_dist = dist;
                 }
+            });
 
-                // Find nearest foe
-                if(std::abs(unit->x - other_unit->x) < std::abs(unit->x - nearest_foe->x)
-                && std::abs(unit->y - other_unit->y) < std::abs(unit->y - nearest_foe->y)) {
-                    nearest_foe = other_unit;
-                }
+            // Move towards target (wrapping around the world), boats cannot go on land
+            if(!step_boat(unit->x, unit->y, unit->tx, unit->ty)) {
+                continue;
+            }
+        
+            // Make the unit attack automatically
+            // and we must be at war with the owner of this unit to be able to attack the unit
+            if(nearest_foe != nullptr
+            && unit->owner->relations[get_id(nearest_foe->owner)].has_war == false) {
+                unit->attack(*nearest_foe);
             }
-        }
-
-        if((unit->x != unit->tx || unit->y != unit->ty)
-        && (std::abs(unit->x - unit->tx) >= 0.2f || std::abs(unit->y - unit->ty) >= 0.2f)) {
-            float end_x, end_y;
-            const float speed = 0.1f;
-
-            end_x = unit->x;
-            end_y = unit->y;
-
-            // Move towards target
-            if(unit->x > unit->tx)
-                end_x -= speed;
-            else if(unit->x < unit->tx)
-                end_x += speed;
 
-            if(unit->y > unit->ty)
-                end_y -= speed;
-            else if(unit->y < unit->ty)
-                end_y += speed;
-            
-            // This code prevents us from stepping onto water tiles (but allows for rivers)
-            if(get_tile(end_x, end_y).elevation <= sea_level) {
+            // Set nearby tiles as owned (once the stage is committed)
+            // TODO: Make it conquer multiple tiles
+            naval_conquests.push_back(std::make_pair(&get_tile(unit->x, unit->y), unit->owner));
+        }
+    };
+    naval_stage.commit = [this, &naval_conquests]() {
+        for(const auto& conquest: naval_conquests) {
+            conquer_tile(*this, *conquest.first, conquest.second);
+        }
+    };
+    pipeline.add_stage(naval_stage);
+
+    TickStage land_stage;
+    land_stage.name = "Land movement and combat";
+    land_stage.reads = TICK_RES_NATIONS | TICK_RES_PRODUCTS | TICK_RES_TERRAIN;
+    land_stage.writes = TICK_RES_UNITS | TICK_RES_PROVINCES | TICK_RES_RANDOM;
+    land_stage.commits = TICK_RES_NATIONS | TICK_RES_TILES | TICK_RES_NETWORK;
+    land_stage.execute = [this, &land_conquests, &land_payments]() {
+        // Remove the units that were destroyed
+        for(size_t i = 0; i < units.size(); ) {
+            Unit* unit = units[i];
+            if(unit->size > 0) {
+                i++;
                 continue;
             }
 
-            unit->x = end_x;
-            unit->y = end_y;
-        }
-        
-        // Make the unit attack automatically
-        // and we must be at war with the owner of this unit to be able to attack the unit
-        if(nearest_foe != nullptr && unit->owner->is_enemy(*nearest_foe->owner)) {
-            unit->attack(*nearest_foe);
+            // Tell the clients to remove it before it loses it's ID
+            Packet packet = Packet();
+            Archive ar = Archive();
+            ActionType action = ActionType::UNIT_REMOVE;
+            ::serialize(ar, &action);
+            ::serialize(ar, &unit);
+            packet.data(ar.get_buffer(), ar.size());
+            g_server->broadcast(packet);
+
+            g_world->remove(unit);
+            delete unit;
         }
 
-        // Unit is on a non-wasteland part of the map
-        if(get_tile(unit->x, unit->y).province_id != (Province::Id)-1) {
-            Province* province = provinces[get_tile(unit->x, unit->y).province_id];
-            const Nation* nation = province->owner;
-            bool free_supplies = false;
-
-            // Unit is on domestic soil, so we have to check the domsetic policy for free military supplies
-            if(unit->owner == nation) {
-                // No-cost supplies
-                if(unit->owner->current_policy.free_supplies) {
-                    free_supplies = true;
+        // Evaluate units
+        Profiler::get_instance().count(ProfileCounter::UNITS_EVALUATED, units.size());
+        unit_grid.build(units, width);
+        for(size_t i = 0; i < units.size(); i++) {
+            Unit* unit = units[i];
+
+            // Find nearest foe, foes only count when they are very close
+            Unit* nearest_foe = nullptr;
+            float nearest_foe_dist = 0.f;
+            unit_grid.for_each_near(unit->x, unit->y, 1.f, [&unit, &nearest_foe, &nearest_foe_dist](Unit* other_unit) {
+                if(unit->owner == other_unit->owner)
+                    return;
+
+                const float dist = (unit->x - other_unit->x) * (unit->x - other_unit->x) + (unit->y - other_unit->y) * (unit->y - other_unit->y);
+                if(nearest_foe == nullptr || dist < nearest_foe_dist) {
+                    nearest_foe = other_unit;
+                    nearest_foe_dist = dist;
                 }
+            });
+
+            // Move towards target (wrapping around the world), units cannot go on water
+            if(!step_unit(unit->x, unit->y, unit->tx, unit->ty)) {
+                continue;
             }
-            // Unit is on foreign soil, we check relations to see if we can take free military supplies
-            else {
-                // No-cost supplies
-                if(unit->owner->relations[get_id(nation)].free_supplies) {
-                    free_supplies = true;
-                }
+        
+            // Make the unit attack automatically
+            // and we must be at war with the owner of this unit to be able to attack the unit
+            if(nearest_foe != nullptr && unit->owner->is_enemy(*nearest_foe->owner)) {
+                unit->attack(*nearest_foe);
             }
 
-            if(free_supplies == true) {
-                // Take anything you want, it's not needed to fucking pay at all! :)
-                for(size_t j = 0; j < province->stockpile.size(); j++) {
-                    if(!province->stockpile[j])
-                        continue;
-
-                    // We will take your food pleseantly
-                    if(products[j]->good->is_edible && unit->supply <= (unit->type->supply_consumption * 10.f)) {
-                        float bought = std::min(unit->size, province->stockpile[j]);
-                        province->stockpile[j] -= bought;
-
-                        unit->supply += bought / unit->size;
-                        unit->morale += bought / unit->size;
+            // Unit is on a non-wasteland part of the map
+            if(get_tile(unit->x, unit->y).province_id != (Province::Id)-1) {
+                Province* province = provinces[get_tile(unit->x, unit->y).province_id];
+                const Nation* nation = province->owner;
+                bool free_supplies = false;
+
+                // Unit is on domestic soil, so we have to check the domsetic policy for free military supplies
+                if(unit->owner == nation) {
+                    // No-cost supplies
+                    if(unit->owner->current_policy.free_supplies) {
+                        free_supplies = true;
                     }
-                    // Fuck you, we are also taking your luxury because it's free
-                    else {
-                        float bought = std::min((rand() + 1) % unit->size, province->stockpile[j]);
-                        province->stockpile[j] -= bought;
-
-                        // Yes, we are super happy with your voluntary gifts to the honourable
-                        // units of some nation
-                        unit->morale += bought / unit->size;
+                }
+                // Unit is on foreign soil, we check relations to see if we can take free military supplies
+                else {
+                    // No-cost supplies
+                    if(unit->owner->relations[get_id(nation)].free_supplies) {
+                        free_supplies = true;
                     }
                 }
-            } else {
-                // Buy stuff and what we are able to buy normally
-                for(size_t j = 0; j < province->stockpile.size(); j++) {
-                    // Must be edible and there must be stock
-                    if(!products[j]->good->is_edible || !province->stockpile[j])
-                        continue;
 
-                    if(products[j]->price * unit->size <= unit->budget) {
-                        size_t bought = std::min(province->stockpile[j], unit->size);
-                        province->stockpile[j] -= bought;
-                        unit->supply = bought / unit->size;
+                if(free_supplies == true) {
+                    // Take anything you want, it's not needed to fucking pay at all! :)
+                    for(size_t j = 0; j < province->stockpile.size(); j++) {
+                        if(!province->stockpile[j])
+                            continue;
+
+                        // We will take your food pleseantly
+                        if(products[j]->good->is_edible && unit->supply <= (unit->type->supply_consumption * 10.f)) {
+                            float bought = std::min(unit->size, province->stockpile[j]);
+                            province->stockpile[j] -= bought;
 
-                        // Pay (including taxes)
-                        const float paid = (products[j]->price * unit->size) * province->owner->current_policy.med_flat_tax;
-                        province->owner->budget += paid;
-                        unit->budget -= paid;
+                            unit->supply += bought / unit->size;
+                            unit->morale += bought / unit->size;
+                        }
+                        // Fuck you, we are also taking your luxury because it's free
+                        else {
+                            float bought = std::min((rand() + 1) % unit->size, province->stockpile[j]);
+                            province->stockpile[j] -= bought;
+
+                            // Yes, we are super happy with your voluntary gifts to the honourable
+                            // units of some nation
+                            unit->morale += bought / unit->size;
+                        }
                     }
+                } else {
+                    // Buy stuff and what we are able to buy normally
+                    for(size_t j = 0; j < province->stockpile.size(); j++) {
+                        // Must be edible and there must be stock
+                        if(!products[j]->good->is_edible || !province->stockpile[j])
+                            continue;
+
+                        if(products[j]->price * unit->size <= unit->budget) {
+                            size_t bought = std::min(province->stockpile[j], unit->size);
+                            province->stockpile[j] -= bought;
+                            unit->supply = bought / unit->size;
+
+                            // Pay (including taxes)
+                            const float paid = (products[j]->price * unit->size) * province->owner->current_policy.med_flat_tax;
+                            land_payments.push_back(std::make_pair(province->owner, paid));
+                            unit->budget -= paid;
+                        }
 
-                    // We will stop buying if we are satisfied
-                    if(unit->supply >= (unit->type->supply_consumption * 1.f))
-                        break;
+                        // We will stop buying if we are satisfied
+                        if(unit->supply >= (unit->type->supply_consumption * 1.f))
+                            break;
+                    }
                 }
             }
-        }
 
-        // North and south do not wrap
-        unit->y = std::max<float>(0.f, unit->y);
-        unit->y = std::min<float>(height, unit->y);
-
-        // West and east do wrap
-        if(unit->x <= 0.f) {
-            unit->x = width - 1.f;
-        } else if(unit->x >= width) {
-            unit->x = 0.f;
+            // Set nearby tiles as owned (once the stage is committed)
+            // TODO: Make it conquer multiple tiles
+            land_conquests.push_back(std::make_pair(&get_tile(unit->x, unit->y), unit->owner));
+        }
+    };
+    land_stage.commit = [this, &land_conquests, &land_payments]() {
+        // Pay (including taxes) for the supplies bought by units
+        for(const auto& payment: land_payments) {
+            payment.first->budget += payment.second;
         }
 
-        // Set nearby tiles as owned
-        // TODO: Make it conquer multiple tiles
-        Tile& tile = get_tile(unit->x, unit->y);
-        if(tile.owner_id != get_id(unit->owner)) {
-            tile.owner_id = get_id(unit->owner);
-
-            std::lock_guard<std::recursive_mutex> lock(nation_changed_tiles_mutex);
-            nation_changed_tiles.push_back(&get_tile(unit->x, unit->y));
-            {
-                std::pair<size_t, size_t> coord = std::make_pair((size_t)unit->x, (size_t)unit->y);
-                // Broadcast to clients
-                Packet packet = Packet(0);
-                Archive ar = Archive();
-                
-                ActionType action = ActionType::TILE_UPDATE;
-                ::serialize(ar, &action);
-                ::serialize(ar, &coord.first);
-                ::serialize(ar, &coord.second);
-                ::serialize(ar, &tile);
-                
-                packet.data(ar.get_buffer(), ar.size());
-                g_server->broadcast(packet);
-            }
+        for(const auto& conquest: land_conquests) {
+            Tile& tile = *conquest.first;
+            if(!conquer_tile(*this, tile, conquest.second))
+                continue;
+
+            std::pair<size_t, size_t> coord = std::make_pair(get_id(&tile) % width, get_id(&tile) / width);
+            // Broadcast to clients
+            Packet packet = Packet(0);
+            Archive& ar = get_scratch_archive();
+            
+            ActionType action = ActionType::TILE_UPDATE;
+            ::serialize(ar, &action);
+            ::serialize(ar, &coord.first);
+            ::serialize(ar, &coord.second);
+            ::serialize(ar, &tile);
+            
+            packet.data(ar.get_buffer(), ar.size());
+            g_server->broadcast_local(packet, coord.first, coord.second, conquest.second, LocalPacket::make_key(LocalPacket::KeyKind::TILE, get_id(&tile)));
         }
-    }
-    
-    for(const auto& unit: units) {
-        // Broadcast to clients
-        Packet packet = Packet();
-        Archive ar = Archive();
-        
-        ActionType action = ActionType::UNIT_UPDATE;
-        ::serialize(ar, &action);
-        ::serialize(ar, &unit);
-        ::serialize(ar, unit);
-        
-        packet.data(ar.get_buffer(), ar.size());
-        g_server->broadcast(packet);
-    }
+    };
+    pipeline.add_stage(land_stage);
+
+    TickStage treaty_stage;
+    treaty_stage.name = "Treaty enforcement";
+    treaty_stage.writes = TICK_RES_TREATIES | TICK_RES_NATIONS | TICK_RES_PROVINCES | TICK_RES_TILES;
+    treaty_stage.execute = [this]() {
+        // Do the treaties clauses
+        for(const auto& treaty: treaties) {
+            // Check that the treaty is agreed by all parties before enforcing it
+            bool on_effect = !(std::find_if(treaty->approval_status.begin(), treaty->approval_status.end(), [](auto& status) { return (status.second != TreatyApproval::ACCEPTED); }) != treaty->approval_status.end());
+            if(!on_effect)
+                continue;
 
-    // Do the treaties clauses
-    for(const auto& treaty: treaties) {
-        // Check that the treaty is agreed by all parties before enforcing it
-        bool on_effect = !(std::find_if(treaty->approval_status.begin(), treaty->approval_status.end(), [](auto& status) { return (status.second != TreatyApproval::ACCEPTED); }) != treaty->approval_status.end());
-        if(!on_effect)
-            continue;
+            // And also check that there is atleast 1 clause that is on effect
+            bool is_on_effect = false;
+            for(const auto& clause: treaty->clauses) {
+                if(clause->type == TreatyClauseType::WAR_REPARATIONS) {
+                    auto dyn_clause = dynamic_cast<TreatyClause::WarReparations*>(clause);
+                    is_on_effect = dyn_clause->in_effect();
+                } else if(clause->type == TreatyClauseType::ANEXX_PROVINCES) {
+                    auto dyn_clause = dynamic_cast<TreatyClause::AnexxProvince*>(clause);
+                    is_on_effect = dyn_clause->in_effect();
+                } else if(clause->type == TreatyClauseType::LIBERATE_NATION) {
+                    auto dyn_clause = dynamic_cast<TreatyClause::LiberateNation*>(clause);
+                    is_on_effect = dyn_clause->in_effect();
+                } else if(clause->type == TreatyClauseType::HUMILIATE) {
+                    auto dyn_clause = dynamic_cast<TreatyClause::Humiliate*>(clause);
+                    is_on_effect = dyn_clause->in_effect();
+                } else if(clause->type == TreatyClauseType::IMPOSE_POLICIES) {
+                    auto dyn_clause = dynamic_cast<TreatyClause::ImposePolicies*>(clause);
+                    is_on_effect = dyn_clause->in_effect();
+                } else if(clause->type == TreatyClauseType::CEASEFIRE) {
+                    auto dyn_clause = dynamic_cast<TreatyClause::Ceasefire*>(clause);
+                    is_on_effect = dyn_clause->in_effect();
+                }
 
-        // And also check that there is atleast 1 clause that is on effect
-        bool is_on_effect = false;
-        for(const auto& clause: treaty->clauses) {
-            if(clause->type == TreatyClauseType::WAR_REPARATIONS) {
-                auto dyn_clause = dynamic_cast<TreatyClause::WarReparations*>(clause);
-                is_on_effect = dyn_clause->in_effect();
-            } else if(clause->type == TreatyClauseType::ANEXX_PROVINCES) {
-                auto dyn_clause = dynamic_cast<TreatyClause::AnexxProvince*>(clause);
-                is_on_effect = dyn_clause->in_effect();
-            } else if(clause->type == TreatyClauseType::LIBERATE_NATION) {
-                auto dyn_clause = dynamic_cast<TreatyClause::LiberateNation*>(clause);
-                is_on_effect = dyn_clause->in_effect();
-            } else if(clause->type == TreatyClauseType::HUMILIATE) {
-                auto dyn_clause = dynamic_cast<TreatyClause::Humiliate*>(clause);
-                is_on_effect = dyn_clause->in_effect();
-            } else if(clause->type == TreatyClauseType::IMPOSE_POLICIES) {
-                auto dyn_clause = dynamic_cast<TreatyClause::ImposePolicies*>(clause);
-                is_on_effect = dyn_clause->in_effect();
-            } else if(clause->type == TreatyClauseType::CEASEFIRE) {
-                auto dyn_clause = dynamic_cast<TreatyClause::Ceasefire*>(clause);
-                is_on_effect = dyn_clause->in_effect();
+                if(is_on_effect)
+                    break;
             }
-
-            if(is_on_effect)
-                break;
-        }
-        if(!is_on_effect)
-            continue;
+            if(!is_on_effect)
+                continue;
         
-        // Treaties clauses now will be enforced
-        print_info("Enforcing treaty %s", treaty->name.c_str());
-        for(auto& clause: treaty->clauses) {
-            if(clause->type == TreatyClauseType::WAR_REPARATIONS) {
-                auto dyn_clause = dynamic_cast<TreatyClause::WarReparations*>(clause);
-                if(!dyn_clause->in_effect())
-                    goto next_iter;
-                dyn_clause->enforce();
-            } else if(clause->type == TreatyClauseType::ANEXX_PROVINCES) {
-                auto dyn_clause = dynamic_cast<TreatyClause::AnexxProvince*>(clause);
-                if(!dyn_clause->in_effect())
-                    goto next_iter;
-                dyn_clause->enforce();
-            } else if(clause->type == TreatyClauseType::LIBERATE_NATION) {
-                auto dyn_clause = dynamic_cast<TreatyClause::LiberateNation*>(clause);
-                if(!dyn_clause->in_effect())
-                    goto next_iter;
-                dyn_clause->enforce();
-            } else if(clause->type == TreatyClauseType::HUMILIATE) {
-                auto dyn_clause = dynamic_cast<TreatyClause::Humiliate*>(clause);
-                if(!dyn_clause->in_effect())
-                    goto next_iter;
-                dyn_clause->enforce();
-            } else if(clause->type == TreatyClauseType::IMPOSE_POLICIES) {
-                auto dyn_clause = dynamic_cast<TreatyClause::ImposePolicies*>(clause);
-                if(!dyn_clause->in_effect())
-                    goto next_iter;
-                dyn_clause->enforce();
-            } else if(clause->type == TreatyClauseType::CEASEFIRE) {
-                auto dyn_clause = dynamic_cast<TreatyClause::Ceasefire*>(clause);
-                if(!dyn_clause->in_effect())
-                    goto next_iter;
-                dyn_clause->enforce();
-            }
+            // Treaties clauses now will be enforced
+            print_info("Enforcing treaty %s", treaty->name.c_str());
+            for(auto& clause: treaty->clauses) {
+                if(clause->type == TreatyClauseType::WAR_REPARATIONS) {
+                    auto dyn_clause = dynamic_cast<TreatyClause::WarReparations*>(clause);
+                    if(!dyn_clause->in_effect())
+                        goto next_iter;
+                    dyn_clause->enforce();
+                } else if(clause->type == TreatyClauseType::ANEXX_PROVINCES) {
+                    auto dyn_clause = dynamic_cast<TreatyClause::AnexxProvince*>(clause);
+                    if(!dyn_clause->in_effect())
+                        goto next_iter;
+                    dyn_clause->enforce();
+                } else if(clause->type == TreatyClauseType::LIBERATE_NATION) {
+                    auto dyn_clause = dynamic_cast<TreatyClause::LiberateNation*>(clause);
+                    if(!dyn_clause->in_effect())
+                        goto next_iter;
+                    dyn_clause->enforce();
+                } else if(clause->type == TreatyClauseType::HUMILIATE) {
+                    auto dyn_clause = dynamic_cast<TreatyClause::Humiliate*>(clause);
+                    if(!dyn_clause->in_effect())
+                        goto next_iter;
+                    dyn_clause->enforce();
+                } else if(clause->type == TreatyClauseType::IMPOSE_POLICIES) {
+                    auto dyn_clause = dynamic_cast<TreatyClause::ImposePolicies*>(clause);
+                    if(!dyn_clause->in_effect())
+                        goto next_iter;
+                    dyn_clause->enforce();
+                } else if(clause->type == TreatyClauseType::CEASEFIRE) {
+                    auto dyn_clause = dynamic_cast<TreatyClause::Ceasefire*>(clause);
+                    if(!dyn_clause->in_effect())
+                        goto next_iter;
+                    dyn_clause->enforce();
+                }
         
-        next_iter:
-            ;
+            next_iter:
+                ;
+            }
         }
-    }
+    };
+    pipeline.add_stage(treaty_stage);
+
+    // Events run lua code, which can do anything to the world
+    TickStage event_stage;
+    event_stage.name = "Events";
+    event_stage.writes = TICK_RES_ALL;
+    event_stage.execute = [this]() {
+        LuaAPI::check_events(lua);
+    };
+    pipeline.add_stage(event_stage);
+
+    TickStage replication_stage;
+    replication_stage.name = "Replication";
+    replication_stage.reads = TICK_RES_UNITS | TICK_RES_BOATS | TICK_RES_TERRAIN;
+    replication_stage.commits = TICK_RES_NETWORK;
+    replication_stage.execute = [this]() {
+        boat_motion_replicator.replicate(*this, boats, ActionType::BOAT_MOVE, ActionType::BOAT_UPDATE, &World::step_boat);
+        unit_motion_replicator.replicate(*this, units, ActionType::UNIT_MOVE, ActionType::UNIT_UPDATE, &World::step_unit);
+    };
+    pipeline.add_stage(replication_stage);
 
-    LuaAPI::check_events(lua);
+    pipeline.run();
 
     //print_info("Tick %zu done", (size_t)time);
     time++;
+
+    // Readers of the tiles (i.e snapshots sent to clients) see the tiles of this tick now
+    publish_tiles();
     
-    // Tell clients that this tick has been done
-    Packet packet = Packet(0);
-    Archive ar = Archive();
-    ActionType action = ActionType::WORLD_TICK;
-    ::serialize(ar, &action);
-    packet.data(ar.get_buffer(), ar.size());
-    g_server->broadcast(packet);
+    g_server->broadcast_frame(frame);
 }
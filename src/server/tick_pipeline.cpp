@@ -0,0 +1,92 @@
+#include "tick_pipeline.hpp"
+#include "server_network.hpp"
+#include "../thread_pool.hpp"
+#include "../profiler.hpp"
+
+void TickPipeline::add_stage(TickStage stage) {
+    stages.push_back(stage);
+}
+
+/**
+ * Groups the stages in waves, for a stage "before" that was added before a stage "after":
+ * - If one writes something the other accesses on execute, or "after" accesses something
+ *   "before" commits, then "after" must go on a later wave than "before"
+ * - If "before" accesses something "after" commits then "after" can't go on an earlier
+ *   wave, but it can go on the same (commits are done after the whole wave executes)
+ */
+std::vector<std::vector<size_t>> TickPipeline::get_waves(void) const {
+    std::vector<size_t> stage_wave(stages.size(), 0);
+    size_t n_waves = 0;
+    for(size_t i = 0; i < stages.size(); i++) {
+        const TickStage& after = stages[i];
+        const uint32_t after_access = after.reads | after.writes;
+
+        size_t wave = 0;
+        for(size_t j = 0; j < i; j++) {
+            const TickStage& before = stages[j];
+            const uint32_t before_access = before.reads | before.writes;
+
+            if((before.writes & after_access) || (before.reads & after.writes) || (before.commits & after_access)) {
+                wave = std::max(wave, stage_wave[j] + 1);
+            } else if(before_access & after.commits) {
+                wave = std::max(wave, stage_wave[j]);
+            }
+        }
+        stage_wave[i] = wave;
+        n_waves = std::max(n_waves, wave + 1);
+    }
+
+    std::vector<std::vector<size_t>> waves(n_waves);
+    for(size_t i = 0; i < stages.size(); i++) {
+        waves[stage_wave[i]].push_back(i);
+    }
+    return waves;
+}
+
+/**
+ * Runs all the stages, each stage has an outbox for it's broadcasts which is sent when
+ * the stage is committed, so clients receive packets in the order of the stages
+ */
+void TickPipeline::run(void) {
+    for(const auto& wave: get_waves()) {
+        std::vector<Outbox> outboxes(wave.size());
+
+        if(wave.size() == 1) {
+            OutboxScope scope(outboxes[0]);
+            ProfileTimer timer(stages[wave[0]].name.c_str());
+            stages[wave[0]].execute();
+        } else {
+            TaskGroup group;
+            for(size_t i = 1; i < wave.size(); i++) {
+                group.run([this, i, &wave, &outboxes]() {
+                    OutboxScope scope(outboxes[i]);
+                    ProfileTimer timer(stages[wave[i]].name.c_str());
+                    stages[wave[i]].execute();
+                });
+            }
+
+            // Our thread takes the first stage
+            {
+                OutboxScope scope(outboxes[0]);
+                ProfileTimer timer(stages[wave[0]].name.c_str());
+                stages[wave[0]].execute();
+            }
+            group.wait();
+        }
+
+        for(size_t i = 0; i < wave.size(); i++) {
+            const TickStage& stage = stages[wave[i]];
+            if(stage.commit) {
+                OutboxScope scope(outboxes[i]);
+                stage.commit();
+            }
+
+            for(auto& packet: outboxes[i].packets) {
+                g_server->broadcast(packet);
+            }
+            for(const auto& local: outboxes[i].local_packets) {
+                g_server->broadcast_local(local);
+            }
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef TICK_PIPELINE_HPP
+#define TICK_PIPELINE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+
+// Parts of the world a stage of the tick accesses, these are used to know which stages
+// can run at the same time
+enum TickResource : uint32_t {
+    TICK_RES_NATIONS = 1 << 0,
+    TICK_RES_PROVINCES = 1 << 1,
+    // Ownership of the tiles (the terrain does not change after the world is loaded)
+    TICK_RES_TILES = 1 << 2,
+    TICK_RES_TERRAIN = 1 << 3,
+    TICK_RES_BUILDINGS = 1 << 4,
+    TICK_RES_PRODUCTS = 1 << 5,
+    TICK_RES_COMPANIES = 1 << 6,
+    TICK_RES_UNITS = 1 << 7,
+    TICK_RES_BOATS = 1 << 8,
+    TICK_RES_TREATIES = 1 << 9,
+    // The global state of std::rand
+    TICK_RES_RANDOM = 1 << 10,
+    // Packets sent to the clients
+    TICK_RES_NETWORK = 1 << 11,
+    TICK_RES_LUA = 1 << 12,
+    TICK_RES_ALL = 0xffffffff,
+};
+
+// A stage of the tick, execute() may run concurrently with other stages that do not
+// access the same resources - commit() is always run on the thread that runs the
+// pipeline, after all the stages of it's wave are executed and in the order the stages
+// were added. Broadcasts done by a stage are sent when it's committed
+class TickStage {
+public:
+    std::string name;
+
+    // Resources read and written by execute()
+    uint32_t reads = 0;
+    uint32_t writes = 0;
+
+    // Resources written by commit()
+    uint32_t commits = 0;
+
+    std::function<void()> execute;
+    std::function<void()> commit;
+};
+
+// Runs the stages of a tick, stages are grouped in waves: a stage goes on the wave
+// after the last stage (added before it) it conflicts with, the stages of a wave run
+// concurrently on the thread pool. The result is the same as running the stages one
+// after another in the order they were added
+class TickPipeline {
+    std::vector<TickStage> stages;
+
+    std::vector<std::vector<size_t>> get_waves(void) const;
+public:
+    void add_stage(TickStage stage);
+    void run(void);
+};
+
+#endif
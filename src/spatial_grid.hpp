@@ -0,0 +1,88 @@
+#ifndef SPATIAL_GRID_HPP
+#define SPATIAL_GRID_HPP
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+/**
+ * Uniform grid over the tiles of the map, used to find the elements (units, boats) near
+ * a position without checking every element of the world. Elements are sorted by the
+ * cell they are on, so a row of cells is a contiguous span of the grid and finding it
+ * is a binary search - the grid takes memory proportional to the number of elements and
+ * not to the size of the map
+ */
+template<typename T>
+class SpatialGrid {
+    class Entry {
+    public:
+        uint64_t cell;
+        T* elem;
+    };
+    std::vector<Entry> entries;
+
+    // Size of a cell (in tiles)
+    size_t cell_size;
+
+    // Number of columns of cells, for obtaining the index of a cell
+    size_t n_cols;
+
+    inline uint64_t get_col(float x) const {
+        return (x <= 0.f) ? 0 : std::min<uint64_t>(n_cols - 1, (uint64_t)x / cell_size);
+    }
+
+    inline uint64_t get_row(float y) const {
+        return (y <= 0.f) ? 0 : (uint64_t)y / cell_size;
+    }
+public:
+    // Elements move after the grid is built (i.e while the tick is being evaluated), so
+    // queries look this many tiles further than asked to not miss them
+    static constexpr float margin = 1.f;
+
+    SpatialGrid(size_t _cell_size = 4) : cell_size(_cell_size), n_cols(1) {};
+
+    // Places all the elements of the list on the grid, discarding the previous contents
+    void build(const std::vector<T*>& list, size_t width) {
+        n_cols = width / cell_size + 1;
+
+        entries.resize(list.size());
+        for(size_t i = 0; i < list.size(); i++) {
+            entries[i].cell = get_row(list[i]->y) * n_cols + get_col(list[i]->x);
+            entries[i].elem = list[i];
+        }
+
+        // Stable so elements of a cell are visited in the order of the list, which keeps
+        // the results deterministic
+        std::stable_sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) {
+            return lhs.cell < rhs.cell;
+        });
+    }
+
+    // Calls func for every element that is closer than radius to (x, y) on both axis
+    template<typename F>
+    void for_each_near(float x, float y, float radius, F func) const {
+        const uint64_t min_col = get_col(x - radius - margin);
+        const uint64_t max_col = get_col(x + radius + margin);
+        const uint64_t min_row = get_row(y - radius - margin);
+        const uint64_t max_row = get_row(y + radius + margin);
+
+        for(uint64_t row = min_row; row <= max_row; row++) {
+            const uint64_t first_cell = row * n_cols + min_col;
+            const uint64_t last_cell = row * n_cols + max_col;
+
+            auto it = std::lower_bound(entries.begin(), entries.end(), first_cell, [](const Entry& entry, uint64_t cell) {
+                return entry.cell < cell;
+            });
+            for(; it != entries.end() && it->cell <= last_cell; it++) {
+                T* elem = it->elem;
+                if(std::abs(elem->x - x) >= radius || std::abs(elem->y - y) >= radius)
+                    continue;
+
+                func(elem);
+            }
+        }
+    }
+};
+
+#endif
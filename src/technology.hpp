@@ -1,5 +1,6 @@
 #ifndef TECHNOLOGY_H
 #define TECHNOLOGY_H
+#include "entity.hpp"
 #include <string>
 #include "nation.hpp"
 
@@ -12,10 +13,8 @@ enum TechnologyType {
     POLITICS,
 };
 
-class Invention {
+class Invention : public IdEntity<uint8_t> {
 public:
-    using Id = uint8_t;
-
     std::string ref_name;
     std::string name;
     std::string description;
@@ -23,10 +22,8 @@ public:
     NationModifier* mod;
 };
 
-class Technology {
+class Technology : public IdEntity<uint16_t> {
 public:
-    using Id = uint16_t;
-    
     std::string ref_name;
     std::string name;
     std::string description;
@@ -1,19 +1,31 @@
 #include "thread_pool.hpp"
 #include <algorithm>
 
-/**
- * Constructs the thread pool, this initializes threads for the pool
- */
-ThreadPool::ThreadPool() {
+// Index of the worker the current thread is (only valid when the pool matches)
+static thread_local ThreadPool* current_pool = nullptr;
+static thread_local size_t current_worker = 0;
+
+static size_t get_default_n_threads(size_t n_threads) {
     // It's a good idea to use as many threads as the hardware implementation
     // supports. Otherwise we can run into performance hits.
-    const size_t n_threads = (size_t)std::thread::hardware_concurrency();
+    if(!n_threads)
+        n_threads = (size_t)std::thread::hardware_concurrency();
+    return std::max<size_t>(1, n_threads);
+}
 
+/**
+ * Constructs the thread pool, this initializes threads for the pool
+ */
+ThreadPool::ThreadPool(size_t n_threads)
+    : workers(get_default_n_threads(n_threads)),
+    n_pending(0),
+    n_sleeping(0),
+    next_worker(0)
+{
     this->running = true;
 
-    //this->threads = std::vector<std::thread>(n_threads, th);
-    for(size_t i = 0; i < n_threads; i++) {
-        this->threads.push_back(std::thread(&ThreadPool::thread_loop, this));
+    for(size_t i = 0; i < this->workers.size(); i++) {
+        this->threads.push_back(std::thread(&ThreadPool::thread_loop, this, i));
     }
 
     // This vector is not going to expand anymore
@@ -27,7 +39,11 @@ ThreadPool::ThreadPool() {
  */
 ThreadPool::~ThreadPool() {
     // We are going to signal all threads to shutdown
-    this->running = false;
+    {
+        std::unique_lock<std::mutex> lock(this->sleep_mutex);
+        this->running = false;
+    }
+    this->sleep_cv.notify_all();
 
     // After that we will start joining all threads - if a thread is executing
     // by a prolonged time, it will block the entire process
@@ -37,40 +53,166 @@ ThreadPool::~ThreadPool() {
 }
 
 /**
- * Adds a job to the list of pending jobs
+ * Obtains the process-wide thread pool, created on first use
+ */
+ThreadPool& ThreadPool::get_instance(void) {
+    static ThreadPool pool;
+    return pool;
+}
+
+/**
+ * Adds a job to the list of pending jobs, jobs spawned from a worker go to the
+ * worker's own deque, otherwise they are distributed in a round-robin fashion
  */
 void ThreadPool::add_job(std::function<void()> job) {
-    std::unique_lock<std::mutex> lock(this->job_mutex);
-    this->jobs.push(job);
+    size_t id;
+    if(current_pool == this) {
+        id = current_worker;
+    } else {
+        id = this->next_worker++ % this->workers.size();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(this->workers[id].jobs_mutex);
+        this->workers[id].jobs.push_back(std::move(job));
+    }
+    this->n_pending++;
+
+    // Only wake someone up when there is someone sleeping, the lock is taken so a
+    // thread that is about to sleep does not miss this notification
+    if(this->n_sleeping) {
+        std::unique_lock<std::mutex> lock(this->sleep_mutex);
+        this->sleep_cv.notify_one();
+    }
+}
+
+/**
+ * Takes a job for the worker id, first from it's own deque (newest job first) and
+ * then by stealing the oldest job of the other workers
+ */
+bool ThreadPool::take_job(size_t id, std::function<void()>& fn) {
+    if(!this->n_pending)
+        return false;
+
+    {
+        Worker& worker = this->workers[id];
+        std::unique_lock<std::mutex> lock(worker.jobs_mutex);
+        if(!worker.jobs.empty()) {
+            fn = std::move(worker.jobs.back());
+            worker.jobs.pop_back();
+            this->n_pending--;
+            return true;
+        }
+    }
+
+    for(size_t i = 1; i < this->workers.size(); i++) {
+        Worker& victim = this->workers[(id + i) % this->workers.size()];
+
+        // Do not block on a busy victim, just try the next one
+        std::unique_lock<std::mutex> lock(victim.jobs_mutex, std::try_to_lock);
+        if(!lock.owns_lock() || victim.jobs.empty())
+            continue;
+
+        fn = std::move(victim.jobs.front());
+        victim.jobs.pop_front();
+        this->n_pending--;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Executes a single pending job on the calling thread (if any), this is used
+ * by threads waiting for jobs to finish so they do useful work meanwhile
+ */
+bool ThreadPool::run_pending_job(void) {
+    const size_t id = (current_pool == this) ? current_worker : (this->next_worker % this->workers.size());
+
+    std::function<void()> fn;
+    if(!this->take_job(id, fn))
+        return false;
+
+    fn();
+    return true;
 }
 
 /**
  * This loop is executed on each thread on the thread list, what this basically does
- * is to check in the list of available jobs for jobs we can take
+ * is to check in the list of available jobs for jobs we can take, and when there are
+ * none we park the thread until a job is added
  */
-void ThreadPool::thread_loop(void) {
+void ThreadPool::thread_loop(size_t id) {
+    current_pool = this;
+    current_worker = id;
+
     while(this->running) {
         std::function<void()> fn;
 
-        // We need to make it be like this so locking lasts until the end of the
-        // scope. We can't keep jobs queue locked while we execute a job... that
-        // would be extremely dumb
-        {
-            std::unique_lock<std::mutex> lock(this->job_mutex);
-
-            // If there are no available jobs for us to take, we will continue our loop
-            if(this->jobs.empty())
-                continue;
-                
-            // Otherwise we execute said job
-            fn = this->jobs.back();
-            this->jobs.pop();
+        // We can't keep the deques locked while we execute a job... that would be
+        // extremely dumb
+        if(this->take_job(id, fn)) {
+            fn();
+            continue;
+        }
+
+        // There are no available jobs for us to take, so sleep until there are
+        std::unique_lock<std::mutex> lock(this->sleep_mutex);
+        this->n_sleeping++;
+        this->sleep_cv.wait(lock, [this] {
+            return this->n_pending || !this->running;
+        });
+        this->n_sleeping--;
+    }
+}
+
+TaskGroup::~TaskGroup() {
+    // Jobs reference this group, so they must be done before it goes away, the
+    // lock is always taken so the last job has released it before we destroy it
+    std::unique_lock<std::mutex> lock(this->done_mutex);
+    this->done_cv.wait(lock, [this] {
+        return !this->n_running;
+    });
+}
+
+/**
+ * Adds a job to the group, exceptions thrown by the job are kept until wait() is called
+ */
+void TaskGroup::run(std::function<void()> job) {
+    this->n_running++;
+    this->pool.add_job([this, job = std::move(job)]() {
+        try {
+            job();
+        } catch(...) {
+            std::unique_lock<std::mutex> lock(this->done_mutex);
+            if(!this->error)
+                this->error = std::current_exception();
         }
 
-        // We are now going to call this function and hope it dosen't blocks infinitely
-        fn();
+        std::unique_lock<std::mutex> lock(this->done_mutex);
+        if(!--this->n_running)
+            this->done_cv.notify_all();
+    });
+}
 
-        // Now yield back to the system
-        std::this_thread::yield();
+/**
+ * Waits for all the jobs of the group to complete, helping with pending jobs of
+ * the pool meanwhile
+ */
+void TaskGroup::wait(void) {
+    while(this->n_running) {
+        if(this->pool.run_pending_job())
+            continue;
+
+        // Nothing left to help with - the remaining jobs are being run by others
+        std::unique_lock<std::mutex> lock(this->done_mutex);
+        this->done_cv.wait(lock, [this] {
+            return !this->n_running;
+        });
     }
-}
\ No newline at end of file
+
+    if(this->error) {
+        std::exception_ptr e = this->error;
+        this->error = nullptr;
+        std::rethrow_exception(e);
+    }
+}
@@ -4,10 +4,27 @@
 #include <functional>
 #include <thread>
 #include <atomic>
-#include <queue>
+#include <deque>
+#include <vector>
 #include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <iterator>
+#include <algorithm>
 
+/**
+ * Work-stealing thread pool, each worker owns a deque of jobs; the owner takes jobs
+ * from the back (so recently spawned - and cache-hot - work is done first) while idle
+ * workers steal from the front of other workers' deques. Workers with nothing to do
+ * park on a condition variable instead of spinning
+ */
 class ThreadPool {
+    class Worker {
+    public:
+        std::deque<std::function<void()>> jobs;
+        std::mutex jobs_mutex;
+    };
+
     // An atomic all idling threads use
     std::atomic<bool> running;
 
@@ -15,31 +32,119 @@ class ThreadPool {
     // allows for movable elements instead. keep this in mind when a bug happens
     std::vector<std::thread> threads;
 
-    // Queues are better suited for the job here, since first-requested-jobs
-    // should have higher priority than the last one, this allows sequential
-    // completion of tasks
-    std::queue<std::function<void()>> jobs;
+    // One deque per thread, the size of this vector never changes after construction
+    // since workers are not movable (they hold a mutex)
+    std::vector<Worker> workers;
+
+    // Number of jobs queued (on any worker) that have not been taken yet
+    std::atomic<size_t> n_pending;
+
+    // Number of threads currently parked, used to skip notifying when everyone is busy
+    std::atomic<size_t> n_sleeping;
+
+    // Used to distribute jobs submitted from threads outside of the pool
+    std::atomic<size_t> next_worker;
 
-    // Our mutex for preventing race conditions on the queue above
-    std::mutex job_mutex;
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_cv;
+
+    bool take_job(size_t id, std::function<void()>& fn);
 public:
-    ThreadPool();
+    ThreadPool(size_t n_threads = 0);
     ~ThreadPool();
+    static ThreadPool& get_instance(void);
+
     void add_job(std::function<void()> job);
-    void thread_loop(void);
+    bool run_pending_job(void);
+    void thread_loop(size_t id);
+
+    inline size_t get_n_threads(void) const {
+        return threads.size();
+    }
+
+    // Runs func(i) for every i in [begin, end), the range is split in chunks of at
+    // least grain iterations which are spread across the pool, the calling thread
+    // also works on the chunks while waiting
+    template<typename F>
+    void parallel_for(size_t begin, size_t end, F func, size_t grain = 0);
 
     template<typename I, typename F>
-    static void for_each(I first, I last, F func) {
-        const size_t n_threads = (size_t)std::thread::hardware_concurrency();
-        if(!std::distance<I>(first, last))
-            return;
-
-        const size_t iterators_per_thread = std::distance<I>(first, last) / n_threads;
-        
-        for(; first != last; first++) {
-            func(*first);
+    static void for_each(I first, I last, F func);
+};
+
+/**
+ * A group of jobs that can be waited on, the waiting thread helps executing pending
+ * jobs of the pool so nested groups (a job that waits for other jobs) do not deadlock.
+ * The first exception thrown by any job of the group is rethrown on wait()
+ */
+class TaskGroup {
+    ThreadPool& pool;
+    std::atomic<size_t> n_running;
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    std::exception_ptr error;
+public:
+    TaskGroup(ThreadPool& _pool = ThreadPool::get_instance()) : pool(_pool), n_running(0) {};
+    ~TaskGroup();
+
+    void run(std::function<void()> job);
+    void wait(void);
+};
+
+template<typename F>
+void ThreadPool::parallel_for(size_t begin, size_t end, F func, size_t grain) {
+    if(begin >= end)
+        return;
+
+    const size_t n_iterations = end - begin;
+
+    // Give each thread a few chunks so faster threads can steal the remaining ones
+    if(!grain)
+        grain = std::max<size_t>(1, n_iterations / (get_n_threads() * 4));
+
+    if(n_iterations <= grain) {
+        for(size_t i = begin; i < end; i++) {
+            func(i);
         }
+        return;
     }
-};
 
-#endif
\ No newline at end of file
+    TaskGroup group(*this);
+    for(size_t chunk = begin; chunk < end; chunk += grain) {
+        const size_t chunk_end = std::min(end, chunk + grain);
+        group.run([chunk, chunk_end, &func]() {
+            for(size_t i = chunk; i < chunk_end; i++) {
+                func(i);
+            }
+        });
+    }
+    group.wait();
+}
+
+template<typename I, typename F>
+void ThreadPool::for_each(I first, I last, F func) {
+    const size_t n_elems = std::distance<I>(first, last);
+    if(!n_elems)
+        return;
+
+    ThreadPool& pool = ThreadPool::get_instance();
+    const size_t iterators_per_thread = std::max<size_t>(1, n_elems / (pool.get_n_threads() * 4));
+
+    // Obtain the starting iterator of each chunk beforehand, so non-random access
+    // containers (i.e std::set) do not walk from the start on every chunk
+    std::vector<I> starts;
+    starts.reserve(n_elems / iterators_per_thread + 1);
+    for(size_t i = 0; i < n_elems; i += iterators_per_thread) {
+        starts.push_back(first);
+        std::advance(first, std::min(iterators_per_thread, n_elems - i));
+    }
+
+    pool.parallel_for(0, starts.size(), [&starts, &func, &last, iterators_per_thread](size_t i) {
+        I it = starts[i];
+        for(size_t j = 0; j < iterators_per_thread && it != last; j++, it++) {
+            func(*it);
+        }
+    }, 1);
+}
+
+#endif
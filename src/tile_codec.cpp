@@ -0,0 +1,149 @@
+#include <cstring>
+#include <cstdint>
+
+#include "tile_codec.hpp"
+#include "world.hpp"
+
+// How a plane is stored
+enum class PlaneMode : uint8_t {
+    // The value of each tile, one after another
+    RAW,
+    // Runs of tiles with the same value, each run is it's length (as a varint) and the value
+    RLE,
+};
+
+static inline size_t varint_size(uint64_t value) {
+    size_t size = 1;
+    while(value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+// Length of the run of tiles with the same value as the first one
+template<typename V>
+static inline size_t get_run_length(const Tile* tiles, size_t n_tiles, V Tile::* field) {
+    const V value = tiles[0].*field;
+    size_t len = 1;
+    while(len < n_tiles && tiles[len].*field == value)
+        len++;
+    return len;
+}
+
+template<typename V>
+static size_t rle_size(const Tile* tiles, size_t n_tiles, V Tile::* field) {
+    size_t size = 0;
+    for(size_t i = 0; i < n_tiles; ) {
+        const size_t len = get_run_length(&tiles[i], n_tiles - i, field);
+        size += varint_size(len) + sizeof(V);
+        i += len;
+    }
+    return size;
+}
+
+template<typename V>
+static size_t plane_size(const Tile* tiles, size_t n_tiles, V Tile::* field, PlaneMode* mode) {
+    const size_t raw = n_tiles * sizeof(V);
+    const size_t rle = rle_size(tiles, n_tiles, field);
+    *mode = (rle < raw) ? PlaneMode::RLE : PlaneMode::RAW;
+    return sizeof(PlaneMode) + ((rle < raw) ? rle : raw);
+}
+
+template<typename V>
+static void encode_plane(Archive& ar, const Tile* tiles, size_t n_tiles, V Tile::* field) {
+    PlaneMode mode;
+    const size_t size = plane_size(tiles, n_tiles, field, &mode) - sizeof(PlaneMode);
+    ar.write(&mode, sizeof(mode));
+
+    // The plane is written directly on the buffer
+    const size_t start = ar.ptr;
+    ar.expand(size);
+    uint8_t* out = ar.buffer.data() + start;
+    if(mode == PlaneMode::RAW) {
+        for(size_t i = 0; i < n_tiles; i++) {
+            std::memcpy(&out[i * sizeof(V)], &(tiles[i].*field), sizeof(V));
+        }
+    } else {
+        for(size_t i = 0; i < n_tiles; ) {
+            uint64_t len = get_run_length(&tiles[i], n_tiles - i, field);
+            i += len;
+            while(len >= 0x80) {
+                *(out++) = (uint8_t)(len | 0x80);
+                len >>= 7;
+            }
+            *(out++) = (uint8_t)len;
+            std::memcpy(out, &(tiles[i - 1].*field), sizeof(V));
+            out += sizeof(V);
+        }
+    }
+    ar.ptr = start + size;
+}
+
+template<typename V>
+static void decode_plane(Archive& ar, Tile* tiles, size_t n_tiles, V Tile::* field) {
+    PlaneMode mode;
+    ar.copy_to(&mode, sizeof(mode));
+
+    const uint8_t* in = ar.data() + ar.ptr;
+    const uint8_t* end = ar.data() + ar.size();
+    if(mode == PlaneMode::RAW) {
+        if(n_tiles > (size_t)(end - in) / sizeof(V))
+            throw SerializerException("Buffer too small for tiles");
+
+        for(size_t i = 0; i < n_tiles; i++) {
+            std::memcpy(&(tiles[i].*field), &in[i * sizeof(V)], sizeof(V));
+        }
+        in += n_tiles * sizeof(V);
+    } else if(mode == PlaneMode::RLE) {
+        for(size_t i = 0; i < n_tiles; ) {
+            uint64_t len = 0;
+            for(size_t shift = 0; ; shift += 7) {
+                if(in == end || shift >= 64)
+                    throw SerializerException("Corrupted run of tiles");
+                const uint8_t byte = *(in++);
+                len |= (uint64_t)(byte & 0x7F) << shift;
+                if(!(byte & 0x80))
+                    break;
+            }
+            if(len == 0 || len > n_tiles - i || (size_t)(end - in) < sizeof(V))
+                throw SerializerException("Corrupted run of tiles");
+
+            V value;
+            std::memcpy(&value, in, sizeof(V));
+            in += sizeof(V);
+
+            // A simple loop the compiler can vectorize
+            Tile* run = &tiles[i];
+            for(size_t j = 0; j < len; j++) {
+                run[j].*field = value;
+            }
+            i += len;
+        }
+    } else {
+        throw SerializerException("Unknown mode of tile plane");
+    }
+    ar.ptr = in - ar.data();
+}
+
+void TileCodec::encode(Archive& ar, const Tile* tiles, size_t n_tiles) {
+    encode_plane(ar, tiles, n_tiles, &Tile::owner_id);
+    encode_plane(ar, tiles, n_tiles, &Tile::province_id);
+    encode_plane(ar, tiles, n_tiles, &Tile::elevation);
+    encode_plane(ar, tiles, n_tiles, &Tile::infra_level);
+}
+
+void TileCodec::decode(Archive& ar, Tile* tiles, size_t n_tiles) {
+    decode_plane(ar, tiles, n_tiles, &Tile::owner_id);
+    decode_plane(ar, tiles, n_tiles, &Tile::province_id);
+    decode_plane(ar, tiles, n_tiles, &Tile::elevation);
+    decode_plane(ar, tiles, n_tiles, &Tile::infra_level);
+}
+
+size_t TileCodec::encoded_size(const Tile* tiles, size_t n_tiles) {
+    PlaneMode mode;
+    return plane_size(tiles, n_tiles, &Tile::owner_id, &mode)
+        + plane_size(tiles, n_tiles, &Tile::province_id, &mode)
+        + plane_size(tiles, n_tiles, &Tile::elevation, &mode)
+        + plane_size(tiles, n_tiles, &Tile::infra_level, &mode);
+}
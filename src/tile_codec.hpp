@@ -0,0 +1,24 @@
+#ifndef TILE_CODEC_HPP
+#define TILE_CODEC_HPP
+
+#include <cstddef>
+#include "serializer.hpp"
+
+class Tile;
+
+/**
+ * Bulk codec for the tiles of the map, used by the snapshot of the world instead of
+ * serializing each tile. The tiles are split in planes (owner, province, elevation and
+ * infrastructure) and each plane is run-length encoded, since ownership and provinces
+ * come in long horizontal runs. A plane that would be bigger encoded (i.e a noisy
+ * elevation) is written as it is, which still compresses better than whole tiles
+ */
+namespace TileCodec {
+    void encode(Archive& ar, const Tile* tiles, size_t n_tiles);
+    void decode(Archive& ar, Tile* tiles, size_t n_tiles);
+
+    // Size of what encode writes, for reserving the archive
+    size_t encoded_size(const Tile* tiles, size_t n_tiles);
+};
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef UNIT_H
 #define UNIT_H
 
+#include "entity.hpp"
 #include <string>
 #include <vector>
 #include <cstdint>
@@ -11,9 +12,8 @@
 * Defines a type of unit, it can be a tank, garrison, infantry, etc
 * this is moddable via a lua script and new unit types can be added
  */
-class UnitType {
+class UnitType : public IdEntity<uint16_t> {
 public:
-    using Id = uint16_t;
     std::string name;
     std::string ref_name;
     
@@ -41,9 +41,8 @@ public:
 /**
 * Defines the type of a naval unit
  */
-class BoatType {
+class BoatType : public IdEntity<uint16_t> {
 public:
-    using Id = uint16_t;
     std::string name;
     std::string ref_name;
     
@@ -64,10 +63,8 @@ public:
 
 /** A trait for an unit; given randomly per each recruited unit
  */
-class UnitTrait {
+class UnitTrait : public IdEntity<uint16_t> {
 public:
-    using Id = uint16_t;
-    
     std::string ref_name;
     
     float supply_consumption_mod;
@@ -82,10 +79,8 @@ public:
 /**
 * Roughly a batallion, consisting of approximately 500 soldiers each
  */
-class Unit {
+class Unit : public IdEntity<uint32_t> {
 public:
-    using Id = uint32_t;
-
     void attack(Unit& enemy) {
         // Calculate the attack of our unit
         float attack_mod = 0.f;
@@ -163,10 +158,8 @@ public:
 /**
  * A ship
  */
-class Boat {
+class Boat : public IdEntity<uint32_t> {
 public:
-    using Id = uint32_t;
-
     void attack(Boat& enemy) {
         // Calculate the attack of our unit
         float attack_mod = 0.f;
@@ -3,6 +3,7 @@
 #include <cstring>
 #include <cmath>
 #include <set>
+#include <algorithm>
 #ifndef _MSC_VER
 #	include <sys/cdefs.h>
 #endif
@@ -23,16 +24,114 @@ World& World::get_instance(void) {
 }
 
 // Obtains a tile from the world safely, and makes sure that it is in bounds
+// the tiles_mutex is not taken since it would only protect obtaining the reference
+// and not the accesses done thru it
 Tile& World::get_tile(size_t x, size_t y) const {
-    std::lock_guard<std::recursive_mutex> lock(tiles_mutex);
     if(x >= width || y >= height)
         throw std::runtime_error("Tile out of bounds");
     return tiles[x + y * width];
 }
 
 Tile& World::get_tile(size_t idx) const {
-    std::lock_guard<std::recursive_mutex> lock(tiles_mutex);
     if(idx >= width * height)
         throw std::runtime_error("Tile index exceeds boundaries");
     return tiles[idx];
 }
+
+// Where something at x, y goes on the next tick towards tx, ty, each axis moves on it's
+// own. Returns false if it's already there
+static bool step_towards(float x, float y, size_t tx, size_t ty, float& end_x, float& end_y) {
+    // This stops the "wiggly" movement due to floating point differences
+    if((x == tx && y == ty) || (std::abs(x - tx) < 0.2f && std::abs(y - ty) < 0.2f))
+        return false;
+
+    end_x = x;
+    end_y = y;
+    if(x > tx)
+        end_x -= World::unit_speed;
+    else if(x < tx)
+        end_x += World::unit_speed;
+
+    if(y > ty)
+        end_y -= World::unit_speed;
+    else if(y < ty)
+        end_y += World::unit_speed;
+    return true;
+}
+
+static void wrap_position(float& x, float& y, size_t width, size_t height) {
+    // North and south do not wrap
+    y = std::max<float>(0.f, y);
+    y = std::min<float>(height, y);
+
+    // West and east do wrap
+    if(x <= 0.f) {
+        x = width - 1.f;
+    } else if(x >= width) {
+        x = 0.f;
+    }
+}
+
+bool World::step_unit(float& x, float& y, size_t tx, size_t ty) const {
+    float end_x, end_y;
+    if(step_towards(x, y, tx, ty, end_x, end_y)) {
+        // This code prevents us from stepping onto water tiles (but allows for rivers)
+        if(get_tile(end_x, end_y).elevation <= sea_level)
+            return false;
+
+        x = end_x;
+        y = end_y;
+    }
+    wrap_position(x, y, width, height);
+    return true;
+}
+
+bool World::step_boat(float& x, float& y, size_t tx, size_t ty) const {
+    float end_x, end_y;
+    if(step_towards(x, y, tx, ty, end_x, end_y)) {
+        // Boats cannot go on land
+        if(get_tile(end_x, end_y).elevation > sea_level)
+            return false;
+
+        x = end_x;
+        y = end_y;
+    }
+    wrap_position(x, y, width, height);
+    return true;
+}
+
+void World::publish_tiles(void) {
+    std::lock_guard<std::recursive_mutex> lock(nation_changed_tiles_mutex);
+    const size_t n_tiles = width * height;
+
+    std::vector<size_t> dirty_tiles;
+    dirty_tiles.reserve(nation_changed_tiles.size());
+    for(const auto& tile: nation_changed_tiles) {
+        dirty_tiles.push_back(get_id(tile));
+    }
+    nation_changed_tiles.clear();
+
+    // The back plane can only be reused if no reader is holding it anymore, otherwise
+    // we make a new one from scratch
+    if(back_tiles == nullptr || back_tiles.use_count() > 1 || back_tiles->size() != n_tiles) {
+        back_tiles = std::make_shared<std::vector<Tile>>(tiles, tiles + n_tiles);
+    } else {
+        // Bring the back plane up to date, it's missing the changes of the last
+        // publication and the ones of this one
+        for(const auto& idx: back_dirty_tiles) {
+            (*back_tiles)[idx] = tiles[idx];
+        }
+        for(const auto& idx: dirty_tiles) {
+            (*back_tiles)[idx] = tiles[idx];
+        }
+    }
+    back_dirty_tiles = std::move(dirty_tiles);
+
+    std::shared_ptr<std::vector<Tile>> old_front = std::atomic_load(&front_tiles);
+    std::atomic_store(&front_tiles, back_tiles);
+    back_tiles = old_front;
+}
+
+std::shared_ptr<const std::vector<Tile>> World::get_tiles_snapshot(void) const {
+    return std::atomic_load(&front_tiles);
+}
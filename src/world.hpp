@@ -111,8 +111,10 @@ public:
 
 #include <algorithm>
 #include <mutex>
+#include <memory>
 #include "event.hpp"
 #include "diplomacy.hpp"
+#include "spatial_grid.hpp"
 
 /**
 * Contains the main world class object, containing all the data relevant for the simulation
@@ -122,13 +124,25 @@ class World {
     // @tparam T type of the element to lookup
     // @tparam C STL-compatible container where the pointer *should* be located in
     template<typename T, typename C>
-    inline typename T::Id get_id_from_pvector(const T* ptr, C table) const {
-        typename C::iterator it = std::find(table.begin(), table.end(), ptr);
+    inline typename T::Id get_id_from_pvector(const T* ptr, const C& table) const {
+        if(ptr == nullptr) {
+            return (typename T::Id)-1;
+        }
+
+        // Fast path, the element remembers where it is on the list
+        if((size_t)ptr->cached_id < table.size() && table[ptr->cached_id] == ptr) {
+            return ptr->cached_id;
+        }
+
+        // The element was added (or moved) without going thru insert/remove, look it
+        // up and remember the result for the next time
+        typename C::const_iterator it = std::find(table.begin(), table.end(), ptr);
         if(it == table.end()) {
             // -1 is used as an invalid index
             return (typename T::Id)-1;
         }
-        return (typename T::Id)std::distance(table.begin(), it);
+        ptr->cached_id = (typename T::Id)std::distance(table.begin(), it);
+        return ptr->cached_id;
     }
 public:
     World();
@@ -141,6 +155,15 @@ public:
     void do_tick(void);
     void load_mod(void);
 
+    // Distance units and boats move towards their target on each tick
+    static constexpr float unit_speed = 0.1f;
+
+    // Moves a unit (or boat) at x, y one tick towards it's target. Returns false if it
+    // could not move because the next position is water (or land for boats). Used by the
+    // simulation, and by the clients to predict the movement between updates
+    bool step_unit(float& x, float& y, size_t tx, size_t ty) const;
+    bool step_boat(float& x, float& y, size_t tx, size_t ty) const;
+
     inline const std::vector<Nation*>& get_list(const Nation* ptr) const {
         return nations;
     };
@@ -288,8 +311,8 @@ public:
         return nation_modifiers;
     };
     
+    // The tile array is never reallocated, so no lock is needed for this
     inline size_t get_id(const Tile* ptr) const {
-        std::lock_guard<std::recursive_mutex> lock(tiles_mutex);
         return ((ptrdiff_t)ptr - (ptrdiff_t)tiles) / sizeof(Tile);
     };
 
@@ -297,11 +320,55 @@ public:
     inline typename T::Id get_id(const T* ptr) const {
         return get_id_from_pvector<T>(ptr, get_list(ptr));
     };
+
+    // Adds an element to it's list on the world, the element gets the ID it has on
+    // the list so get_id() does not need to search for it
+    template<typename T>
+    inline void insert(T* ptr) {
+        auto& list = get_list(ptr);
+        ptr->cached_id = (typename T::Id)list.size();
+        list.push_back(ptr);
+    };
+
+    // Removes an element from it's list on the world, elements after it are shifted
+    // by one so their IDs are updated accordingly. The element is not deleted
+    template<typename T>
+    inline void remove(T* ptr) {
+        auto& list = get_list(ptr);
+        const typename T::Id id = get_id(ptr);
+        if(id == (typename T::Id)-1) {
+            return;
+        }
+
+        list.erase(list.begin() + id);
+        for(size_t i = id; i < list.size(); i++) {
+            list[i]->cached_id = (typename T::Id)i;
+        }
+        ptr->cached_id = (typename T::Id)-1;
+    };
     
     // Obtains a tile from the world safely, and makes sure that it is in bounds
     Tile& get_tile(size_t x, size_t y) const;
     Tile& get_tile(size_t idx) const;
 
+    // Obtains a tile without checking bounds, for hot loops that already know their
+    // coordinates are valid (and hold the world lock, or work on a frozen world)
+    inline Tile& get_tile_unchecked(size_t x, size_t y) const {
+        return tiles[x + y * width];
+    };
+    inline Tile& get_tile_unchecked(size_t idx) const {
+        return tiles[idx];
+    };
+
+    // Publishes the current state of the tiles into a read-only plane, only the tiles on
+    // nation_changed_tiles are copied (unless a full copy is needed). Must be called by
+    // the writer of the tiles (i.e at the end of a tick)
+    void publish_tiles(void);
+
+    // Obtains the last published plane of tiles, readers can keep it as long as they want
+    // without blocking the writer (nullptr when nothing has been published yet)
+    std::shared_ptr<const std::vector<Tile>> get_tiles_snapshot(void) const;
+
     // Lua state - for lua scripts, this is only used by the server and should not be
     // accesible to the client
     lua_State* lua;
@@ -310,6 +377,14 @@ public:
     Tile* tiles;
     mutable std::recursive_mutex tiles_mutex;
 
+    // Double buffered planes of tiles for readers, the front plane is the published one
+    // and the back plane is updated and swapped with it on the next publication
+    std::shared_ptr<std::vector<Tile>> front_tiles;
+    std::shared_ptr<std::vector<Tile>> back_tiles;
+
+    // Tiles changed on the last publication, which the back plane does not have yet
+    std::vector<size_t> back_dirty_tiles;
+
     // Level at which sea dissapears, all sea is capped to sea_level - 1, and rivers are at sea_level.
     // Anything above is considered land
     size_t sea_level;
@@ -369,6 +444,14 @@ public:
     std::vector<Building*> buildings;
     std::vector<Treaty*> treaties;
     std::vector<Ideology*> ideologies;
+
+    // Grids of the units and boats, rebuilt each tick for finding nearby units when
+    // evaluating combat
+    SpatialGrid<Unit> unit_grid;
+    SpatialGrid<Boat> boat_grid;
+
+    // Which transport companies connect provinces, updated by Company::operate_on
+    TransportNetwork transport_network;
 };
 
 extern World* g_world;